@@ -0,0 +1,459 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Throughput benchmark of the physics step (simulation_step) for every solver over a range of particle counts,
+              results are printed and written as csv and json
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "particle_system.h"
+#include "simulation.h"
+#include "gravity.h"
+#include "timer.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#define MAX_SIZES 32
+#define DEFAULT_SEED 1
+//time spent measuring each case (after one warm up step)
+#define DEFAULT_CASE_TIME 2.0
+//the direct sum above this count takes minutes per step
+#define DEFAULT_MAX_DIRECT 65536
+//the initial conditions keep the density of 1024 particles in the 1280x720 window
+#define BASE_COUNT 1024
+#define BASE_HALF_WIDTH 640
+#define BASE_HALF_HEIGHT 360
+
+//Result of one case (one solver, one particle count)
+typedef struct BenchmarkResult_s {
+	Solver_t solver;
+	Integrator_t integrator;
+	size_t count;
+	int reorderInterval; //steps between two Morton sorts of the particles (0 : never)
+	unsigned long long steps;
+	double seconds;
+	double interactions; //pair interactions per step
+	double stepsPerSecond;
+	double interactionsPerSecond;
+	double nsPerInteraction;
+	double peakRssMb;
+	double maxError; //relative error of the mixed precision accelerations against the double precision ones (direct solver, 0 otherwise)
+	double rmsError;
+} BenchmarkResult_t;
+
+static void print_usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-sizes <n1,n2,...>] [-solvers <direct,barnes-hut,particle-mesh>] [-time <seconds per case>] [-max-direct <count>]\n"
+					"          [-theta <opening angle>] [-grid <cells per side>] [-threads <count>] [-kernel scalar|avx2|avx512]\n"
+					"          [-precision double|mixed] [-integrator verlet|leapfrog|yoshida] [-csv <file>] [-json <file>]\n"
+					"          [-tiles auto|<source block>,<target block>[,<pair block>] of the direct sums>] [-reorder <steps between two Morton sorts, 0 : never>]\n",
+			name);
+}
+
+/*
+ * Start measuring the peak resident set size of a case from the current size (linux only : elsewhere the peak of the process only grows,
+ * so it is the peak over every case run so far).
+ */
+static void reset_peak_rss(void)
+{
+#ifdef __linux__
+	//5 : reset the peak resident set size of the process (VmHWM) to its current one
+	FILE *file = fopen("/proc/self/clear_refs", "w");
+
+	if (file != NULL)
+	{
+		fputs("5", file);
+		fclose(file);
+	}
+#endif
+}
+
+/*
+ * Peak resident set size in megabytes since reset_peak_rss.
+ */
+static double peak_rss_mb(void)
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+	}
+	return 0;
+#else
+	struct rusage usage;
+#ifdef __linux__
+	FILE *file = fopen("/proc/self/status", "r");
+	char line[256];
+	double kilobytes = -1;
+
+	while (file != NULL && fgets(line, sizeof(line), file) != NULL)
+	{
+		if (sscanf(line, "VmHWM: %lf kB", &kilobytes) == 1)
+		{
+			break;
+		}
+	}
+	if (file != NULL)
+	{
+		fclose(file);
+	}
+	if (kilobytes >= 0)
+	{
+		return kilobytes / 1024.0;
+	}
+#endif
+
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+#ifdef __APPLE__
+		return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+		return usage.ru_maxrss / 1024.0;
+#endif
+	}
+	return 0;
+#endif
+}
+
+/*
+ * Parse a comma separated list of particle counts.
+ */
+static int parse_sizes(const char *list, size_t *sizes)
+{
+	int count = 0;
+	const char *cursor = list;
+
+	while (*cursor != '\0' && count < MAX_SIZES)
+	{
+		char *end;
+		sizes[count++] = strtoull(cursor, &end, 10);
+		cursor = *end == ',' ? end + 1 : end;
+		if (end == cursor && *end != '\0')
+		{
+			return 0;
+		}
+	}
+
+	return count;
+}
+
+static BenchmarkResult_t run_case(Solver_t solver, Integrator_t integrator, size_t count, double theta, int meshSize, int reorderInterval, int threads, double caseTime)
+{
+	BenchmarkResult_t result;
+	Simulation_t *simulation;
+	double scale = sqrt(fmax(1, (double)count / BASE_COUNT));
+	//force evaluations per step
+	double evaluations = integrator == INTEGRATOR_YOSHIDA ? 3 : 1;
+	double start;
+
+	//the memory of this case only, not the peak of the larger cases run before
+	reset_peak_rss();
+	simulation = simulation_initializer(threads);
+	simulation->solver = solver;
+	simulation->integrator = integrator;
+	simulation->theta = theta;
+	simulation->meshSize = meshSize;
+	simulation->reorderInterval = reorderInterval;
+	simulation_populate(simulation, count, (int)(BASE_HALF_WIDTH * scale), (int)(BASE_HALF_HEIGHT * scale), DEFAULT_SEED);
+
+	//warm up (first touch of the memory, quadtree growth)
+	simulation_step(simulation);
+
+	result.maxError = 0;
+	result.rmsError = 0;
+	if (solver == SOLVER_DIRECT && gravity_get_precision() == GRAVITY_PRECISION_MIXED)
+	{
+		particle_system_precision_error(simulation->particles, simulation->pool, &result.maxError, &result.rmsError);
+	}
+
+	result.steps = 0;
+	result.interactions = 0;
+	start = timer_now();
+	do
+	{
+		simulation_step(simulation);
+		result.steps++;
+		//the particle-mesh solver has no pair interactions (reported as 0)
+		if (solver == SOLVER_BARNES_HUT)
+		{
+			//interactions of the last evaluation of the step
+			result.interactions += (double)simulation->quadtree->interactions * evaluations;
+		}
+		else if (solver == SOLVER_DIRECT)
+		{
+			//one acceleration term per ordered pair, comparable with Barnes-Hut (the double precision sum computes each unordered pair once for both)
+			result.interactions += (double)count * (count - 1) * evaluations;
+		}
+		result.seconds = timer_now() - start;
+	} while (result.seconds < caseTime);
+
+	result.solver = solver;
+	result.integrator = integrator;
+	result.count = count;
+	result.reorderInterval = reorderInterval;
+	result.interactions /= result.steps;
+	result.stepsPerSecond = result.steps / result.seconds;
+	result.interactionsPerSecond = result.interactions * result.stepsPerSecond;
+	result.nsPerInteraction = result.interactionsPerSecond > 0 ? 1e9 / result.interactionsPerSecond : 0;
+	result.peakRssMb = peak_rss_mb();
+
+	simulation_destroy(simulation);
+
+	return result;
+}
+
+static bool write_csv(const char *path, BenchmarkResult_t *results, int count, int threads)
+{
+	FILE *file = fopen(path, "w");
+
+	if (file == NULL)
+	{
+		fprintf(stderr, "error: could not open %s\n", path);
+		return false;
+	}
+
+	fprintf(file, "solver,integrator,kernel,precision,threads,reorder_interval,particles,steps,seconds,steps_per_second,interactions_per_step,interactions_per_second,ns_per_interaction,peak_rss_mb,max_error,rms_error\n");
+	for (int i = 0; i < count; i++)
+	{
+		BenchmarkResult_t *r = &results[i];
+		fprintf(file, "%s,%s,%s,%s,%d,%d,%zu,%llu,%.6f,%.6g,%.6g,%.6g,%.6g,%.1f,%.3g,%.3g\n",
+				simulation_solver_name(r->solver), simulation_integrator_name(r->integrator), gravity_kernel_name(gravity_get_kernel()), gravity_precision_name(gravity_get_precision()),
+				threads, r->reorderInterval, r->count, r->steps, r->seconds, r->stepsPerSecond, r->interactions, r->interactionsPerSecond, r->nsPerInteraction,
+				r->peakRssMb, r->maxError, r->rmsError);
+	}
+
+	fclose(file);
+	return true;
+}
+
+static bool write_json(const char *path, BenchmarkResult_t *results, int count, int threads)
+{
+	FILE *file = fopen(path, "w");
+
+	if (file == NULL)
+	{
+		fprintf(stderr, "error: could not open %s\n", path);
+		return false;
+	}
+
+	fprintf(file, "{\n  \"kernel\": \"%s\",\n  \"precision\": \"%s\",\n  \"source_block\": %zu,\n  \"target_block\": %zu,\n  \"pair_block\": %zu,\n  \"threads\": %d,\n  \"results\": [\n",
+			gravity_kernel_name(gravity_get_kernel()), gravity_precision_name(gravity_get_precision()), gravity_get_tiles(gravity_get_precision()).sourceBlock,
+			gravity_get_tiles(gravity_get_precision()).targetBlock, gravity_get_pair_block(), threads);
+	for (int i = 0; i < count; i++)
+	{
+		BenchmarkResult_t *r = &results[i];
+		fprintf(file, "    {\"solver\": \"%s\", \"integrator\": \"%s\", \"reorder_interval\": %d, \"particles\": %zu, \"steps\": %llu, \"seconds\": %.6f, \"steps_per_second\": %.6g, "
+					  "\"interactions_per_step\": %.6g, \"interactions_per_second\": %.6g, \"ns_per_interaction\": %.6g, \"peak_rss_mb\": %.1f, "
+					  "\"max_error\": %.3g, \"rms_error\": %.3g}%s\n",
+				simulation_solver_name(r->solver), simulation_integrator_name(r->integrator), r->reorderInterval, r->count, r->steps, r->seconds, r->stepsPerSecond,
+				r->interactions, r->interactionsPerSecond, r->nsPerInteraction, r->peakRssMb, r->maxError, r->rmsError, i + 1 < count ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+
+	fclose(file);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t sizes[MAX_SIZES] = {256, 1024, 4096, 16384, 65536, 262144, 1048576};
+	int sizeCount = 7;
+	bool solvers[SOLVER_COUNT] = {true, true, true};
+	double caseTime = DEFAULT_CASE_TIME;
+	size_t maxDirect = DEFAULT_MAX_DIRECT;
+	double theta = QUADTREE_DEFAULT_THETA;
+	int meshSize = PARTICLE_MESH_DEFAULT_SIZE;
+	Integrator_t integrator = INTEGRATOR_VERLET;
+	int reorderInterval = SIMULATION_DEFAULT_REORDER_INTERVAL;
+	int threads = 0;
+	const char *csvPath = "benchmark.csv";
+	const char *jsonPath = "benchmark.json";
+	const char *tiles = "auto";
+	BenchmarkResult_t results[MAX_SIZES * SOLVER_COUNT];
+	int resultCount = 0;
+	ThreadPool_t *probe;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (i + 1 >= argc)
+		{
+			print_usage(argv[0]);
+			return 1;
+		}
+
+		if (strcmp(argv[i], "-sizes") == 0)
+		{
+			sizeCount = parse_sizes(argv[++i], sizes);
+			if (sizeCount == 0)
+			{
+				fprintf(stderr, "error: invalid list of sizes %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-solvers") == 0)
+		{
+			char list[256];
+			char *name;
+
+			memset(solvers, 0, sizeof(solvers));
+			snprintf(list, sizeof(list), "%s", argv[++i]);
+			for (name = strtok(list, ","); name != NULL; name = strtok(NULL, ","))
+			{
+				Solver_t solver;
+				if (!simulation_solver_from_name(name, &solver))
+				{
+					fprintf(stderr, "error: unknown solver %s\n", name);
+					return 1;
+				}
+				solvers[solver] = true;
+			}
+		}
+		else if (strcmp(argv[i], "-time") == 0)
+		{
+			caseTime = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-max-direct") == 0)
+		{
+			maxDirect = strtoull(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "-theta") == 0)
+		{
+			theta = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-grid") == 0)
+		{
+			meshSize = atoi(argv[++i]);
+			if (!particle_mesh_valid_size(meshSize))
+			{
+				fprintf(stderr, "error: the grid size must be a power of 2 between %d and %d\n", PARTICLE_MESH_MIN_SIZE, PARTICLE_MESH_MAX_SIZE);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-threads") == 0)
+		{
+			threads = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-kernel") == 0)
+		{
+			GravityKernel_t kernel;
+
+			i++;
+			if (!gravity_kernel_from_name(argv[i], &kernel) || !gravity_set_kernel(kernel))
+			{
+				fprintf(stderr, "error: kernel %s unknown or not supported by this processor\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-precision") == 0)
+		{
+			GravityPrecision_t precision;
+
+			if (!gravity_precision_from_name(argv[++i], &precision))
+			{
+				fprintf(stderr, "error: unknown precision %s\n", argv[i]);
+				return 1;
+			}
+			gravity_set_precision(precision);
+		}
+		else if (strcmp(argv[i], "-integrator") == 0)
+		{
+			if (!simulation_integrator_from_name(argv[++i], &integrator))
+			{
+				fprintf(stderr, "error: unknown integrator %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-csv") == 0)
+		{
+			csvPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "-json") == 0)
+		{
+			jsonPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "-tiles") == 0)
+		{
+			tiles = argv[++i];
+		}
+		else if (strcmp(argv[i], "-reorder") == 0)
+		{
+			reorderInterval = atoi(argv[++i]);
+			if (reorderInterval < 0)
+			{
+				fprintf(stderr, "error: the steps between two sorts must be 0 or more\n");
+				return 1;
+			}
+		}
+		else
+		{
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	//tiles of the direct sums tuned for this processor unless they are given (once the kernel and the precision are known)
+	if (strcmp(tiles, "auto") == 0)
+	{
+		gravity_autotune();
+	}
+	else
+	{
+		GravityTiles_t given;
+		size_t pairBlock = GRAVITY_DEFAULT_PAIR_BLOCK;
+		int fields = sscanf(tiles, "%zu,%zu,%zu", &given.sourceBlock, &given.targetBlock, &pairBlock);
+
+		if (fields < 2)
+		{
+			fprintf(stderr, "error: tiles %s are not auto or <source block>,<target block>[,<pair block>]\n", tiles);
+			return 1;
+		}
+		gravity_set_tiles(gravity_get_precision(), given);
+		gravity_set_pair_block(pairBlock);
+	}
+
+	//resolve the number of threads (0 : one per processor) so that it is reported
+	probe = thread_pool_initializer(threads);
+	threads = thread_pool_thread_count(probe);
+	thread_pool_destroy(probe);
+
+	//-reorder 0 against the default shows what the memory locality of the particles is worth to every solver
+	printf("%s kernel, %s precision, tiles of %zu sources x %zu targets, pair blocks of %zu, %s integrator, %d threads, sorted every %d steps, %.1f s per case\n",
+		   gravity_kernel_name(gravity_get_kernel()), gravity_precision_name(gravity_get_precision()), gravity_get_tiles(gravity_get_precision()).sourceBlock,
+		   gravity_get_tiles(gravity_get_precision()).targetBlock, gravity_get_pair_block(), simulation_integrator_name(integrator), threads, reorderInterval, caseTime);
+	printf("%-13s %10s %8s %12s %14s %12s %10s %10s\n", "solver", "particles", "steps", "steps/s", "interactions/s", "ns/interact", "rss (MB)", "max error");
+
+	for (int s = 0; s < SOLVER_COUNT; s++)
+	{
+		for (int i = 0; i < sizeCount; i++)
+		{
+			BenchmarkResult_t *r;
+
+			if (!solvers[s] || (s == SOLVER_DIRECT && sizes[i] > maxDirect))
+			{
+				continue;
+			}
+
+			r = &results[resultCount++];
+			*r = run_case((Solver_t)s, integrator, sizes[i], theta, meshSize, reorderInterval, threads, caseTime);
+			printf("%-13s %10zu %8llu %12.4g %14.4g %12.4g %10.1f %10.3g\n", simulation_solver_name(r->solver), r->count, r->steps,
+				   r->stepsPerSecond, r->interactionsPerSecond, r->nsPerInteraction, r->peakRssMb, r->maxError);
+			fflush(stdout);
+		}
+	}
+
+	if (!write_csv(csvPath, results, resultCount, threads) || !write_json(jsonPath, results, resultCount, threads))
+	{
+		return 1;
+	}
+	printf("Results written to %s and %s\n", csvPath, jsonPath);
+
+	return 0;
+}
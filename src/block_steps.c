@@ -0,0 +1,374 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Hierarchical block time steps, the particles close to the black hole move with small steps while the far ones take
+              the full time step, and only the particles moving at a tick get their acceleration computed
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "particle.h"
+#include "particle_system.h"
+#include "quadtree.h"
+#include "particle_mesh.h"
+#include "gravity.h"
+#include "simulation.h"
+#include "block_steps.h"
+
+BlockSteps_t *block_steps_initializer(void)
+{
+	return (BlockSteps_t *)calloc(1, sizeof(BlockSteps_t));
+}
+
+/*
+ * Grow the arrays so that they hold count particles, the new ones are unknown.
+ */
+static void block_steps_reserve(BlockSteps_t *blocks, size_t count)
+{
+	size_t old = blocks->capacity;
+
+	if (count <= old)
+	{
+		return;
+	}
+
+	blocks->capacity = count > 2 * old ? count : 2 * old;
+	blocks->level = (unsigned char *)realloc(blocks->level, blocks->capacity * sizeof(unsigned char));
+	blocks->next = (unsigned int *)realloc(blocks->next, blocks->capacity * sizeof(unsigned int));
+	blocks->lastAx = (double *)realloc(blocks->lastAx, blocks->capacity * sizeof(double));
+	blocks->lastAy = (double *)realloc(blocks->lastAy, blocks->capacity * sizeof(double));
+	blocks->predictedX = (double *)realloc(blocks->predictedX, blocks->capacity * sizeof(double));
+	blocks->predictedY = (double *)realloc(blocks->predictedY, blocks->capacity * sizeof(double));
+	blocks->fullAx = (double *)realloc(blocks->fullAx, blocks->capacity * sizeof(double));
+	blocks->fullAy = (double *)realloc(blocks->fullAy, blocks->capacity * sizeof(double));
+	blocks->active = (size_t *)realloc(blocks->active, blocks->capacity * sizeof(size_t));
+	blocks->activeX = (double *)realloc(blocks->activeX, blocks->capacity * sizeof(double));
+	blocks->activeY = (double *)realloc(blocks->activeY, blocks->capacity * sizeof(double));
+	blocks->activeAx = (double *)realloc(blocks->activeAx, blocks->capacity * sizeof(double));
+	blocks->activeAy = (double *)realloc(blocks->activeAy, blocks->capacity * sizeof(double));
+
+	for (size_t i = old; i < blocks->capacity; i++)
+	{
+		block_steps_forget(blocks, i);
+	}
+}
+
+void block_steps_forget(BlockSteps_t *blocks, size_t index)
+{
+	if (index < blocks->capacity)
+	{
+		blocks->level[index] = 0;
+		blocks->lastAx[index] = NAN;
+		blocks->lastAy[index] = NAN;
+	}
+}
+
+void block_steps_forget_all(BlockSteps_t *blocks)
+{
+	for (size_t i = 0; i < blocks->capacity; i++)
+	{
+		block_steps_forget(blocks, i);
+	}
+}
+
+void block_steps_permute(BlockSteps_t *blocks, const size_t *order, size_t count)
+{
+	double *swap;
+
+	block_steps_reserve(blocks, count);
+	//next, predictedX and predictedY are only used during a step
+	for (size_t i = 0; i < count; i++)
+	{
+		blocks->next[i] = blocks->level[order[i]];
+		blocks->predictedX[i] = blocks->lastAx[order[i]];
+		blocks->predictedY[i] = blocks->lastAy[order[i]];
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		blocks->level[i] = (unsigned char)blocks->next[i];
+	}
+	swap = blocks->lastAx;
+	blocks->lastAx = blocks->predictedX;
+	blocks->predictedX = swap;
+	swap = blocks->lastAy;
+	blocks->lastAy = blocks->predictedY;
+	blocks->predictedY = swap;
+	for (size_t i = count; i < blocks->capacity; i++)
+	{
+		block_steps_forget(blocks, i);
+	}
+}
+
+//arguments of the tasks
+typedef struct BlockStepsContext_s {
+	BlockSteps_t *blocks;
+	Simulation_t *simulation;
+	unsigned int tick;
+	unsigned int ticks; //ticks per step of the simulation
+	double tickTime;
+} BlockStepsContext_t;
+
+/*
+ * Positions of the particles [begin, end) at the current tick, interpolated between their last position and the due one.
+ */
+static void block_steps_predict_task(void *context, int thread, size_t begin, size_t end)
+{
+	BlockStepsContext_t *arguments = (BlockStepsContext_t *)context;
+	BlockSteps_t *blocks = arguments->blocks;
+	ParticleSystem_t *particles = arguments->simulation->particles;
+
+	(void)thread;
+	for (size_t i = begin; i < end; i++)
+	{
+		double remaining = (double)(blocks->next[i] - arguments->tick) / (arguments->ticks >> blocks->level[i]);
+
+		blocks->predictedX[i] = particles->x[i] - (particles->x[i] - particles->lastX[i]) * remaining;
+		blocks->predictedY[i] = particles->y[i] - (particles->y[i] - particles->lastY[i]) * remaining;
+	}
+}
+
+/*
+ * Accelerations of the particles due [begin, end) caused by every other particle (direct sum) and by the black hole.
+ */
+static void block_steps_direct_task(void *context, int thread, size_t begin, size_t end)
+{
+	BlockSteps_t *blocks = ((BlockStepsContext_t *)context)->blocks;
+	ParticleSystem_t *particles = ((BlockStepsContext_t *)context)->simulation->particles;
+
+	(void)thread;
+	gravity_direct(blocks->predictedX, blocks->predictedY, particles->mass, particles->count,
+				   &blocks->activeX[begin], &blocks->activeY[begin], &blocks->activeAx[begin], &blocks->activeAy[begin], end - begin);
+}
+
+static void block_steps_quadtree_task(void *context, int thread, size_t begin, size_t end)
+{
+	BlockSteps_t *blocks = ((BlockStepsContext_t *)context)->blocks;
+	Simulation_t *simulation = ((BlockStepsContext_t *)context)->simulation;
+	unsigned long long interactions = 0;
+
+	(void)thread;
+	for (size_t a = begin; a < end; a++)
+	{
+		interactions += quadtree_acceleration(simulation->quadtree, blocks->activeX[a], blocks->activeY[a], simulation->theta,
+											  &blocks->activeAx[a], &blocks->activeAy[a]);
+	}
+	__atomic_fetch_add(&simulation->quadtree->interactions, interactions, __ATOMIC_RELAXED);
+}
+
+/*
+ * Move the particles due [begin, end) : pick their new level, then variable step Verlet
+ * x(t + dt) = x(t) + (x(t) - x(t - dtLast)) * dt / dtLast + a(t) * dt * (dt + dtLast) / 2
+ */
+static void block_steps_move_task(void *context, int thread, size_t begin, size_t end)
+{
+	BlockStepsContext_t *arguments = (BlockStepsContext_t *)context;
+	BlockSteps_t *blocks = arguments->blocks;
+	Simulation_t *simulation = arguments->simulation;
+	ParticleSystem_t *particles = simulation->particles;
+	Particle_t *blackHole = simulation->blackHole;
+	const double gm = G * blackHole->mass;
+	int levels = simulation->blockLevels;
+
+	(void)thread;
+	for (size_t a = begin; a < end; a++)
+	{
+		size_t i = blocks->active[a];
+		double dx = blackHole->pos.x - blocks->activeX[a];
+		double dy = blackHole->pos.y - blocks->activeY[a];
+		double distanceSquared = dx * dx + dy * dy;
+		double inv = gm / (distanceSquared * sqrt(distanceSquared));
+		double ax = blocks->activeAx[a] + dx * inv;
+		double ay = blocks->activeAy[a] + dy * inv;
+		double lastStep = (arguments->ticks >> blocks->level[i]) * arguments->tickTime;
+		int level = blocks->level[i];
+		double timeScale, wanted, step, ratio, x, y;
+
+		//step from the time scale |a| / |jerk|, the jerk is estimated from the acceleration of the previous move.
+		//Without a previous move (new particle) |v| / |a| is used instead (the same for a circular orbit)
+		if (!isnan(blocks->lastAx[i]))
+		{
+			timeScale = hypot(ax, ay) / (hypot(ax - blocks->lastAx[i], ay - blocks->lastAy[i]) / lastStep);
+		}
+		else
+		{
+			timeScale = hypot(particles->x[i] - particles->lastX[i], particles->y[i] - particles->lastY[i]) / lastStep / hypot(ax, ay);
+		}
+		wanted = simulation->blockEta * timeScale;
+		level = !(wanted < simulation->timeStep) ? 0 : wanted > 0 ? (int)ceil(log2(simulation->timeStep / wanted)) : levels;
+		level = level > levels ? levels : level;
+		//a particle can only move to a longer step at a tick which is a multiple of it
+		while (arguments->tick % (arguments->ticks >> level) != 0)
+		{
+			level++;
+		}
+
+		step = (arguments->ticks >> level) * arguments->tickTime;
+		ratio = step / lastStep;
+		x = particles->x[i] + (particles->x[i] - particles->lastX[i]) * ratio + ax * step * (step + lastStep) / 2;
+		y = particles->y[i] + (particles->y[i] - particles->lastY[i]) * ratio + ay * step * (step + lastStep) / 2;
+
+		particles->lastX[i] = particles->x[i];
+		particles->lastY[i] = particles->y[i];
+		particles->x[i] = x;
+		particles->y[i] = y;
+		particles->ax[i] = ax;
+		particles->ay[i] = ay;
+		blocks->lastAx[i] = ax;
+		blocks->lastAy[i] = ay;
+		blocks->level[i] = (unsigned char)level;
+		blocks->next[i] = arguments->tick + (arguments->ticks >> level);
+	}
+}
+
+/*
+ * Accelerations (without the black hole) of the particles due at the current tick, with the solver of the simulation.
+ */
+static void block_steps_accelerations(BlockSteps_t *blocks, BlockStepsContext_t *context)
+{
+	Simulation_t *simulation = context->simulation;
+	ParticleSystem_t *particles = simulation->particles;
+	//the particles at their positions of the current tick, for the solvers working on a whole system
+	ParticleSystem_t predicted = {0};
+
+	predicted.count = particles->count;
+	predicted.capacity = particles->count;
+	predicted.x = blocks->predictedX;
+	predicted.y = blocks->predictedY;
+	predicted.mass = particles->mass;
+	predicted.ax = blocks->fullAx;
+	predicted.ay = blocks->fullAy;
+
+	if (simulation->solver == SOLVER_BARNES_HUT)
+	{
+		quadtree_build(simulation->quadtree, &predicted);
+		thread_pool_parallel_for(simulation->pool, blocks->activeCount, block_steps_quadtree_task, context);
+	}
+	else if (simulation->solver == SOLVER_PARTICLE_MESH)
+	{
+		//the grid gives every acceleration at once
+		particle_mesh_accelerations(simulation_mesh(simulation), &predicted, simulation->pool);
+		for (size_t a = 0; a < blocks->activeCount; a++)
+		{
+			blocks->activeAx[a] = blocks->fullAx[blocks->active[a]];
+			blocks->activeAy[a] = blocks->fullAy[blocks->active[a]];
+		}
+	}
+	else
+	{
+		thread_pool_parallel_for(simulation->pool, blocks->activeCount, block_steps_direct_task, context);
+	}
+}
+
+void block_steps_advance(BlockSteps_t *blocks, Simulation_t *simulation)
+{
+	ParticleSystem_t *particles = simulation->particles;
+	int levels = simulation->blockLevels < BLOCK_STEPS_MAX_LEVEL ? simulation->blockLevels : BLOCK_STEPS_MAX_LEVEL;
+	BlockStepsContext_t context = {blocks, simulation, 0, 1u << levels, simulation->timeStep / (1u << levels)};
+
+	block_steps_reserve(blocks, particles->count);
+	blocks->evaluations = 0;
+	blocks->ticks = 0;
+	simulation->quadtree->interactions = 0;
+	memset(blocks->levelCounts, 0, sizeof(blocks->levelCounts));
+
+	//lastX/lastY are one time step T of the simulation before : bring them to the step f * T of the level of every particle.
+	//A plain rescale (x - lastX) * f would keep the mean velocity of the last T, which is the velocity at -T / 2, so the
+	//acceleration of the last move corrects it : lastX' = x - f * (x - lastX) - a * T^2 * f * (1 - f) / 2 (exact for a constant a).
+	//Everything is due at tick 0
+	for (size_t i = 0; i < particles->count; i++)
+	{
+		double f, correction;
+
+		if (blocks->level[i] > levels)
+		{
+			//fewer levels than during the last step
+			blocks->level[i] = (unsigned char)levels;
+		}
+		f = 1.0 / (1u << blocks->level[i]);
+		correction = simulation->timeStep * simulation->timeStep * f * (1 - f) / 2;
+		particles->lastX[i] = particles->x[i] - (particles->x[i] - particles->lastX[i]) * f;
+		particles->lastY[i] = particles->y[i] - (particles->y[i] - particles->lastY[i]) * f;
+		if (!isnan(blocks->lastAx[i]))
+		{
+			particles->lastX[i] -= blocks->lastAx[i] * correction;
+			particles->lastY[i] -= blocks->lastAy[i] * correction;
+		}
+		blocks->next[i] = 0;
+	}
+
+	while (context.tick < context.ticks)
+	{
+		unsigned int nextTick = context.ticks;
+
+		blocks->activeCount = 0;
+		for (size_t i = 0; i < particles->count; i++)
+		{
+			if (particles->mass[i] != 0 && blocks->next[i] == context.tick)
+			{
+				blocks->active[blocks->activeCount++] = i;
+			}
+		}
+
+		if (blocks->activeCount > 0)
+		{
+			thread_pool_parallel_for(simulation->pool, particles->count, block_steps_predict_task, &context);
+			for (size_t a = 0; a < blocks->activeCount; a++)
+			{
+				blocks->activeX[a] = blocks->predictedX[blocks->active[a]];
+				blocks->activeY[a] = blocks->predictedY[blocks->active[a]];
+			}
+
+			block_steps_accelerations(blocks, &context);
+			thread_pool_parallel_for(simulation->pool, blocks->activeCount, block_steps_move_task, &context);
+			blocks->evaluations += blocks->activeCount;
+			blocks->ticks++;
+		}
+
+		for (size_t i = 0; i < particles->count; i++)
+		{
+			if (particles->mass[i] != 0 && blocks->next[i] < nextTick)
+			{
+				nextTick = blocks->next[i];
+			}
+		}
+		context.tick = nextTick;
+	}
+
+	//back to lastX/lastY one time step of the simulation before, the exact inverse of the conversion at the beginning
+	for (size_t i = 0; i < particles->count; i++)
+	{
+		double f = 1.0 / (1u << blocks->level[i]);
+		double correction = simulation->timeStep * simulation->timeStep * (1 - f) / 2;
+
+		particles->lastX[i] = particles->x[i] - (particles->x[i] - particles->lastX[i]) / f;
+		particles->lastY[i] = particles->y[i] - (particles->y[i] - particles->lastY[i]) / f;
+		if (!isnan(blocks->lastAx[i]))
+		{
+			particles->lastX[i] += blocks->lastAx[i] * correction;
+			particles->lastY[i] += blocks->lastAy[i] * correction;
+		}
+		if (particles->mass[i] != 0)
+		{
+			blocks->levelCounts[blocks->level[i]]++;
+		}
+	}
+}
+
+void block_steps_destroy(BlockSteps_t *blocks)
+{
+	free(blocks->level);
+	free(blocks->next);
+	free(blocks->lastAx);
+	free(blocks->lastAy);
+	free(blocks->predictedX);
+	free(blocks->predictedY);
+	free(blocks->fullAx);
+	free(blocks->fullAy);
+	free(blocks->active);
+	free(blocks->activeX);
+	free(blocks->activeY);
+	free(blocks->activeAx);
+	free(blocks->activeAy);
+	free(blocks);
+}
@@ -0,0 +1,83 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Hierarchical block time steps, every particle moves with its own power of 2 fraction of the time step of the simulation
+*/
+#include <stddef.h>
+#include <stdbool.h>
+#include "particle_system.h"
+
+#pragma once
+
+//deepest level allowed (time step / 2^16)
+#define BLOCK_STEPS_MAX_LEVEL 16
+//default accuracy parameter : the step of a particle is eta * |acceleration| / |jerk|
+#define BLOCK_STEPS_DEFAULT_ETA 0.02
+
+struct Simulation_s;
+
+//Block time steps
+//A step of the simulation is divided in 2^levels ticks. A particle of level k moves by 2^(levels - k) ticks at once and only the particles
+//whose position is due at a tick get their acceleration computed, from the positions of every other particle interpolated at that tick.
+//Every particle is back in sync at the end of the step of the simulation, so the positions and lastX/lastY keep their usual meaning
+//between two steps (lastX/lastY one full time step before).
+typedef struct BlockSteps_s {
+	size_t capacity;
+	unsigned char *level;  //level of the last move of every particle
+	unsigned int *next;	   //tick at which the position of every particle is due
+	double *lastAx;		   //acceleration of the previous move (NAN : unknown, the level is kept), the jerk comes from the difference
+	double *lastAy;
+	double *predictedX;	   //positions of every particle at the current tick
+	double *predictedY;
+	double *fullAx;		   //accelerations of every particle (particle-mesh solver only)
+	double *fullAy;
+	size_t *active;		   //particles due at the current tick
+	size_t activeCount;
+	double *activeX;
+	double *activeY;
+	double *activeAx;
+	double *activeAy;
+	//statistics of the last step
+	unsigned long long evaluations;					//accelerations computed
+	unsigned int ticks;								//ticks with at least one particle due
+	size_t levelCounts[BLOCK_STEPS_MAX_LEVEL + 1]; //particles of every level at the end of the step
+} BlockSteps_t;
+
+/**
+ * @brief Initializes a new BlockSteps_t without any particle (every particle starts at level 0).
+ * @return BlockSteps_t*
+ */
+BlockSteps_t *block_steps_initializer(void);
+
+/**
+ * @brief Forget what is known of the particle in a slot (new particle), it starts again at level 0.
+ * @return void
+ */
+void block_steps_forget(BlockSteps_t *blocks, size_t index);
+
+/**
+ * @brief Forget every particle (ex: the particles were moved by a compaction).
+ * @return void
+ */
+void block_steps_forget_all(BlockSteps_t *blocks);
+
+/**
+ * @brief Move what is known of the particles along with them after they were sorted : the particle in slot i was in slot order[i].
+ * @return void
+ */
+void block_steps_permute(BlockSteps_t *blocks, const size_t *order, size_t count);
+
+/**
+ * @brief Move every particle of the simulation by one time step of the simulation with the block time steps of its blockLevels and blockEta,
+ * using its solver for the accelerations (and the black hole). Does not change the step counter of the simulation.
+ * The direct sum only computes the accelerations of the particles due at a tick, the Barnes-Hut solver builds its tree at every tick
+ * and the particle-mesh solver computes its whole grid at every tick, so it only pays off with the direct sum or a few levels.
+ * @return void
+ */
+void block_steps_advance(BlockSteps_t *blocks, struct Simulation_s *simulation);
+
+/**
+ * @brief Free the arrays and the BlockSteps_t.
+ * @return void
+ */
+void block_steps_destroy(BlockSteps_t *blocks);
@@ -0,0 +1,461 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Binary checkpoints of a simulation (versioned little-endian format with a checksum), restored by mapping the file in memory
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "particle.h"
+#include "particle_system.h"
+#include "particle_mesh.h"
+#include "simulation.h"
+#include "mapped_file.h"
+#include "checkpoint.h"
+#include "tests.h"
+
+#define CHECKPOINT_MAGIC "GLXCKPT"
+#define CHECKPOINT_CHECKSUM_OFFSET 96
+#define CHECKPOINT_ARRAY_COUNT 7
+//arrays of the version 1 files (no velocities)
+#define CHECKPOINT_V1_ARRAY_COUNT 5
+//arrays are padded to a multiple of this size in the file
+#define CHECKPOINT_ALIGNMENT 64
+//doubles converted and hashed at once while saving
+#define CHECKPOINT_CHUNK 1024
+
+/*
+ * Little-endian encoding whatever the byte order of the processor (compiled to a plain load/store on little-endian ones).
+ */
+static void write_u64(unsigned char *bytes, uint64_t value)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		bytes[i] = (unsigned char)(value >> (8 * i));
+	}
+}
+
+static uint64_t read_u64(const unsigned char *bytes)
+{
+	uint64_t value = 0;
+
+	for (int i = 0; i < 8; i++)
+	{
+		value |= (uint64_t)bytes[i] << (8 * i);
+	}
+	return value;
+}
+
+static void write_u32(unsigned char *bytes, uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		bytes[i] = (unsigned char)(value >> (8 * i));
+	}
+}
+
+static uint32_t read_u32(const unsigned char *bytes)
+{
+	return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static void write_double(unsigned char *bytes, double value)
+{
+	uint64_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	write_u64(bytes, bits);
+}
+
+static double read_double(const unsigned char *bytes)
+{
+	uint64_t bits = read_u64(bytes);
+	double value;
+
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static bool host_is_little_endian(void)
+{
+	const uint16_t one = 1;
+
+	return *(const unsigned char *)&one == 1;
+}
+
+/*
+ * Hash of 64 bit little-endian words (size is a multiple of 8), continued from hash.
+ */
+static uint64_t checkpoint_hash(uint64_t hash, const unsigned char *bytes, size_t size)
+{
+	for (size_t i = 0; i < size; i += 8)
+	{
+		hash = (hash ^ read_u64(&bytes[i])) * 0x100000001b3ULL;
+		hash ^= hash >> 29;
+	}
+	return hash;
+}
+
+#define CHECKPOINT_HASH_SEED 0xcbf29ce484222325ULL
+
+static size_t padded_array_size(size_t count)
+{
+	return (count * sizeof(double) + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT * CHECKPOINT_ALIGNMENT;
+}
+
+/*
+ * Write the values of one array for the particles alive (free slots skipped) followed by the padding, and hash them.
+ */
+static bool checkpoint_write_array(FILE *file, ParticleSystem_t *system, double *array, size_t alive, uint64_t *hash)
+{
+	unsigned char bytes[CHECKPOINT_CHUNK * sizeof(double)];
+	size_t used = 0;
+	size_t padding = padded_array_size(alive) - alive * sizeof(double);
+
+	//in the order of the ids, the restored particles keep their ids (minus the free ones)
+	for (size_t id = 0; id < system->count; id++)
+	{
+		size_t i = system->slots[id];
+
+		if (system->mass[i] == 0)
+		{
+			continue;
+		}
+		write_double(&bytes[used], array[i]);
+		used += sizeof(double);
+		if (used == sizeof(bytes))
+		{
+			*hash = checkpoint_hash(*hash, bytes, used);
+			if (fwrite(bytes, 1, used, file) != used)
+			{
+				return false;
+			}
+			used = 0;
+		}
+	}
+
+	//padding (zeros) : the flushes above always leave room for it since it is smaller than a chunk
+	if (used + padding > sizeof(bytes))
+	{
+		*hash = checkpoint_hash(*hash, bytes, used);
+		if (fwrite(bytes, 1, used, file) != used)
+		{
+			return false;
+		}
+		used = 0;
+	}
+	memset(&bytes[used], 0, padding);
+	used += padding;
+	*hash = checkpoint_hash(*hash, bytes, used);
+
+	return fwrite(bytes, 1, used, file) == used;
+}
+
+bool checkpoint_save(Simulation_t *simulation, const char *path)
+{
+	ParticleSystem_t *system = simulation->particles;
+	unsigned char header[CHECKPOINT_HEADER_SIZE];
+	size_t alive = system->count - system->freeCount;
+	double *arrays[CHECKPOINT_ARRAY_COUNT] = {system->x, system->y, system->lastX, system->lastY, system->mass, system->vx, system->vy};
+	uint64_t hash;
+	char temporary[1024];
+	FILE *file;
+	bool ok = true;
+
+	memset(header, 0, sizeof(header));
+	memcpy(header, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+	write_u32(&header[8], CHECKPOINT_VERSION);
+	write_u32(&header[12], CHECKPOINT_HEADER_SIZE);
+	write_u64(&header[16], alive);
+	write_u64(&header[24], simulation->step);
+	write_double(&header[32], simulation->timeStep);
+	write_double(&header[40], simulation->theta);
+	write_u32(&header[48], (uint32_t)simulation->solver);
+	write_u32(&header[52], (uint32_t)simulation->meshSize);
+	write_double(&header[56], simulation->blackHole->pos.x);
+	write_double(&header[64], simulation->blackHole->pos.y);
+	write_double(&header[72], simulation->blackHole->lastPos.x);
+	write_double(&header[80], simulation->blackHole->lastPos.y);
+	write_double(&header[88], simulation->blackHole->mass);
+	write_u32(&header[104], (uint32_t)simulation->blockLevels);
+	write_u32(&header[108], (uint32_t)simulation->integrator);
+	write_double(&header[112], simulation->blockEta);
+	//a leapfrog run goes on with its velocities instead of estimating them again from the positions
+	write_u32(&header[120], simulation->velocitiesReady ? CHECKPOINT_VELOCITIES : 0);
+
+	snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+	file = fopen(temporary, "wb");
+	if (file == NULL)
+	{
+		fprintf(stderr, "error: could not open %s\n", temporary);
+		return false;
+	}
+
+	//the header is written twice : once with a checksum of 0 to reserve its place, once the checksum of the arrays is known
+	hash = checkpoint_hash(CHECKPOINT_HASH_SEED, header, sizeof(header));
+	ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+	for (int i = 0; ok && i < CHECKPOINT_ARRAY_COUNT; i++)
+	{
+		ok = checkpoint_write_array(file, system, arrays[i], alive, &hash);
+	}
+	if (ok)
+	{
+		write_u64(&header[CHECKPOINT_CHECKSUM_OFFSET], hash);
+		ok = fseek(file, 0, SEEK_SET) == 0 && fwrite(header, 1, sizeof(header), file) == sizeof(header);
+	}
+	ok = fclose(file) == 0 && ok;
+
+	if (ok)
+	{
+#ifdef _WIN32
+		//rename does not replace an existing file on windows
+		remove(path);
+#endif
+		ok = rename(temporary, path) == 0;
+	}
+	if (!ok)
+	{
+		fprintf(stderr, "error: could not write the checkpoint %s\n", path);
+		remove(temporary);
+	}
+
+	return ok;
+}
+
+Simulation_t *checkpoint_load(const char *path, int threadCount)
+{
+	MappedFile_t *file = mapped_file_open(path);
+	unsigned char *bytes;
+	unsigned char zero[8] = {0};
+	uint64_t count, hash;
+	uint32_t version;
+	size_t arraySize;
+	int arrayCount;
+	double *arrays[CHECKPOINT_ARRAY_COUNT];
+	Simulation_t *simulation;
+
+	if (file == NULL)
+	{
+		fprintf(stderr, "error: could not open the checkpoint %s\n", path);
+		return NULL;
+	}
+	bytes = (unsigned char *)file->data;
+
+	if (file->size < CHECKPOINT_HEADER_SIZE || memcmp(bytes, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0)
+	{
+		fprintf(stderr, "error: %s is not a checkpoint\n", path);
+		mapped_file_close(file);
+		return NULL;
+	}
+	version = read_u32(&bytes[8]);
+	if (version < 1 || version > CHECKPOINT_VERSION || read_u32(&bytes[12]) != CHECKPOINT_HEADER_SIZE)
+	{
+		fprintf(stderr, "error: checkpoint %s has version %u, only versions 1 to %d are supported\n", path, version, CHECKPOINT_VERSION);
+		mapped_file_close(file);
+		return NULL;
+	}
+	arrayCount = version == 1 ? CHECKPOINT_V1_ARRAY_COUNT : CHECKPOINT_ARRAY_COUNT;
+	count = read_u64(&bytes[16]);
+	arraySize = padded_array_size((size_t)count);
+	if (count > (file->size - CHECKPOINT_HEADER_SIZE) / sizeof(double) || file->size != CHECKPOINT_HEADER_SIZE + arrayCount * arraySize)
+	{
+		fprintf(stderr, "error: checkpoint %s is truncated\n", path);
+		mapped_file_close(file);
+		return NULL;
+	}
+
+	//checksum of the whole file, with the checksum field counted as 0
+	hash = checkpoint_hash(CHECKPOINT_HASH_SEED, bytes, CHECKPOINT_CHECKSUM_OFFSET);
+	hash = checkpoint_hash(hash, zero, sizeof(zero));
+	hash = checkpoint_hash(hash, &bytes[CHECKPOINT_CHECKSUM_OFFSET + 8], file->size - CHECKPOINT_CHECKSUM_OFFSET - 8);
+	if (hash != read_u64(&bytes[CHECKPOINT_CHECKSUM_OFFSET]))
+	{
+		fprintf(stderr, "error: checkpoint %s is corrupted (wrong checksum)\n", path);
+		mapped_file_close(file);
+		return NULL;
+	}
+
+	simulation = simulation_initializer(threadCount);
+	simulation->step = read_u64(&bytes[24]);
+	simulation->timeStep = read_double(&bytes[32]);
+	simulation->theta = read_double(&bytes[40]);
+	simulation->solver = read_u32(&bytes[48]) < SOLVER_COUNT ? (Solver_t)read_u32(&bytes[48]) : SOLVER_DIRECT;
+	//0 in the files saved before the particle-mesh solver
+	if (particle_mesh_valid_size((int)read_u32(&bytes[52])))
+	{
+		simulation->meshSize = (int)read_u32(&bytes[52]);
+	}
+	simulation->blackHole->pos = vector2(read_double(&bytes[56]), read_double(&bytes[64]));
+	simulation->blackHole->lastPos = vector2(read_double(&bytes[72]), read_double(&bytes[80]));
+	simulation->blackHole->mass = read_double(&bytes[88]);
+	//0 in the files saved before the block time steps
+	simulation->blockLevels = read_u32(&bytes[104]) <= BLOCK_STEPS_MAX_LEVEL ? (int)read_u32(&bytes[104]) : 0;
+	//0 (Verlet) in the files saved before the leapfrog integrators, the velocities are computed again by the first step
+	simulation->integrator = read_u32(&bytes[108]) < INTEGRATOR_COUNT ? (Integrator_t)read_u32(&bytes[108]) : INTEGRATOR_VERLET;
+	if (read_double(&bytes[112]) > 0)
+	{
+		simulation->blockEta = read_double(&bytes[112]);
+	}
+
+	for (int i = 0; i < arrayCount; i++)
+	{
+		arrays[i] = (double *)&bytes[CHECKPOINT_HEADER_SIZE + i * arraySize];
+		if (!host_is_little_endian())
+		{
+			//big-endian processor : the values are swapped in place (in the private copy of the pages)
+			for (size_t j = 0; j < count; j++)
+			{
+				arrays[i][j] = read_double((unsigned char *)&arrays[i][j]);
+			}
+		}
+	}
+
+	//the particles use the mapped arrays in place, the mapping is closed with the particle system
+	particle_system_destroy(simulation->particles);
+	simulation->particles = particle_system_from_arrays((size_t)count, arrays[0], arrays[1], arrays[2], arrays[3], arrays[4], mapped_file_close, file);
+	//the velocities are copied (the system owns them), the accelerations are computed again by the next step
+	if (version > 1 && (read_u32(&bytes[120]) & CHECKPOINT_VELOCITIES) != 0)
+	{
+		memcpy(simulation->particles->vx, arrays[5], (size_t)count * sizeof(double));
+		memcpy(simulation->particles->vy, arrays[6], (size_t)count * sizeof(double));
+		simulation->velocitiesReady = true;
+	}
+
+	return simulation;
+}
+
+//Build test : (mingw32-)gcc -o test.exe checkpoint.c mapped_file.c simulation.c block_steps.c particle_system.c particle.c quadtree.c particle_mesh.c thread_pool.c gravity.c profiler.c timer.c -lpthread -DUNIT_TESTS_CK
+#ifdef UNIT_TESTS_CK
+#define TEST_PATH "test_checkpoint.bin"
+
+/* Start the overall test suite */
+START_TESTS()
+START_TEST("Save and restore")
+Simulation_t *simulation = simulation_initializer(2);
+Simulation_t *restored;
+bool same = true;
+
+simulation->solver = SOLVER_BARNES_HUT;
+simulation->meshSize = 512;
+simulation->blockLevels = 3;
+simulation->integrator = INTEGRATOR_YOSHIDA;
+simulation->blockEta = 0.05;
+simulation->theta = 0.7;
+simulation_populate(simulation, 1000, 640, 360, 3);
+for (int step = 0; step < 5; step++)
+{
+	simulation_step(simulation);
+}
+//free slots are not saved
+particle_system_remove(simulation->particles, 10);
+particle_system_compact(simulation->particles);
+
+ASSERT(checkpoint_save(simulation, TEST_PATH));
+restored = checkpoint_load(TEST_PATH, 2);
+ASSERT(restored != NULL);
+
+ASSERT(restored->particles->count == 999);
+ASSERT(restored->step == 5);
+ASSERT(restored->solver == SOLVER_BARNES_HUT);
+ASSERT(restored->meshSize == 512);
+ASSERT(restored->blockLevels == 3 && restored->blockEta == 0.05);
+ASSERT(restored->integrator == INTEGRATOR_YOSHIDA);
+ASSERT(restored->theta == 0.7);
+ASSERT(restored->timeStep == simulation->timeStep);
+ASSERT(restored->blackHole->mass == SIMULATION_BLACK_HOLE_MASS);
+ASSERT((size_t)restored->particles->x % PARTICLE_SYSTEM_ALIGNMENT == 0);
+//saved in the order of the ids (the particles were sorted by the first step)
+for (size_t i = 0; i < restored->particles->count; i++)
+{
+	size_t slot = simulation->particles->slots[i];
+
+	same = same && restored->particles->ids[i] == i && restored->particles->x[i] == simulation->particles->x[slot] &&
+		   restored->particles->lastY[i] == simulation->particles->lastY[slot] && restored->particles->mass[i] == simulation->particles->mass[slot];
+}
+ASSERT(same);
+
+//both go on the same way, the restored one in the mapped arrays (sorted in place)
+simulation_step(simulation);
+simulation_step(restored);
+ASSERT(restored->particles->x[500] == simulation->particles->x[simulation->particles->slots[500]]);
+particle_system_sort_morton(restored->particles, restored->pool);
+ASSERT(restored->particles->release != NULL);
+ASSERT(restored->particles->x[restored->particles->slots[500]] == simulation->particles->x[simulation->particles->slots[500]]);
+
+//growing moves the particles out of the mapping
+for (int i = 0; i < 100; i++)
+{
+	simulation_spawn(restored, 100 + i, 100, 1);
+}
+ASSERT(restored->particles->release == NULL);
+ASSERT(restored->particles->count == 1099);
+ASSERT(restored->particles->y[restored->particles->slots[998]] == simulation->particles->y[simulation->particles->slots[998]]);
+
+simulation_destroy(restored);
+simulation_destroy(simulation);
+END_TEST()
+
+START_TEST("Restored Yoshida run goes on like the uninterrupted one")
+Simulation_t *simulation = simulation_initializer(2);
+Simulation_t *restored;
+bool same = true;
+
+simulation->integrator = INTEGRATOR_YOSHIDA;
+simulation->reorderInterval = 0;
+simulation_populate(simulation, 500, 640, 360, 4);
+for (int step = 0; step < 5; step++)
+{
+	simulation_step(simulation);
+}
+ASSERT(checkpoint_save(simulation, TEST_PATH));
+restored = checkpoint_load(TEST_PATH, 2);
+ASSERT(restored != NULL);
+restored->reorderInterval = 0;
+ASSERT(restored->velocitiesReady && !restored->accelerationsReady);
+
+//the saved velocities and the accelerations of the same positions : not a single bit apart
+simulation_step(simulation);
+simulation_step(restored);
+for (size_t i = 0; i < 500; i++)
+{
+	same = same && restored->particles->x[i] == simulation->particles->x[i] && restored->particles->y[i] == simulation->particles->y[i] &&
+		   restored->particles->vx[i] == simulation->particles->vx[i] && restored->particles->vy[i] == simulation->particles->vy[i];
+}
+ASSERT(same);
+
+remove(TEST_PATH);
+simulation_destroy(restored);
+simulation_destroy(simulation);
+END_TEST()
+
+START_TEST("Corrupted and missing files are refused")
+Simulation_t *simulation = simulation_initializer(1);
+FILE *file;
+
+simulation_populate(simulation, 10, 640, 360, 3);
+ASSERT(checkpoint_save(simulation, TEST_PATH));
+
+//one bit flipped in the positions
+file = fopen(TEST_PATH, "r+b");
+fseek(file, CHECKPOINT_HEADER_SIZE + 3, SEEK_SET);
+fputc(0x10, file);
+fclose(file);
+ASSERT(checkpoint_load(TEST_PATH, 1) == NULL);
+
+//newer version
+ASSERT(checkpoint_save(simulation, TEST_PATH));
+file = fopen(TEST_PATH, "r+b");
+fseek(file, 8, SEEK_SET);
+fputc(CHECKPOINT_VERSION + 1, file);
+fclose(file);
+ASSERT(checkpoint_load(TEST_PATH, 1) == NULL);
+
+remove(TEST_PATH);
+ASSERT(checkpoint_load(TEST_PATH, 1) == NULL);
+
+simulation_destroy(simulation);
+END_TEST()
+/* End the overall test suite */
+END_TESTS()
+#endif
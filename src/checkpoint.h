@@ -0,0 +1,55 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Binary checkpoints of a simulation (versioned little-endian format with a checksum), restored by mapping the file in memory
+*/
+#include <stdbool.h>
+#include "simulation.h"
+
+#pragma once
+
+/*
+ * File layout (every value little-endian, doubles in IEEE 754 binary64) :
+ *
+ *   offset  size  content
+ *        0     8  magic "GLXCKPT\0"
+ *        8     4  version (CHECKPOINT_VERSION)
+ *       12     4  header size (CHECKPOINT_HEADER_SIZE)
+ *       16     8  number of particles N
+ *       24     8  number of steps done
+ *       32     8  time step
+ *       40     8  theta
+ *       48     4  solver
+ *       52     4  cells per side of the particle-mesh grid (0 : default)
+ *       56    40  black hole : x, y, lastX, lastY, mass
+ *       96     8  checksum of the whole file, computed with this field set to 0
+ *      104     4  levels of the block time steps (0 : off)
+ *      108     4  integrator
+ *      112     8  accuracy parameter of the block time steps (0 : default)
+ *      120     4  flags : CHECKPOINT_VELOCITIES when vx and vy are the velocities of the leapfrog integrators
+ *      124     4  reserved (0)
+ *      128        x, y, lastX, lastY, mass, vx and vy arrays of the N particles, each padded with zeros to a multiple of 64 bytes
+ *
+ * The arrays are aligned on 64 bytes in the file, so once mapped the positions and masses are used in place by the particle system.
+ * Version 1 files have no flags nor vx and vy arrays, the velocities are computed again by the first leapfrog step.
+ */
+#define CHECKPOINT_VERSION 2
+#define CHECKPOINT_HEADER_SIZE 128
+//flags of the header
+#define CHECKPOINT_VELOCITIES 1
+
+/**
+ * @brief Write the state of the simulation (particles alive in the order of their ids with their velocities, black hole, step, time step,
+ * solver settings) to a checkpoint file.
+ * The file is written next to the destination then renamed, so a crash while saving never leaves a truncated checkpoint.
+ * @return bool false on error (a message is printed on stderr)
+ */
+bool checkpoint_save(Simulation_t *simulation, const char *path);
+
+/**
+ * @brief Restore a simulation from a checkpoint file with a pool of threadCount threads (0 : one per processor).
+ * The file is mapped in memory and its arrays are used in place (copy on write, the file is never modified), nothing is copied
+ * before the particles are touched. The version, size and checksum are checked first.
+ * @return Simulation_t* NULL on error (a message is printed on stderr)
+ */
+Simulation_t *checkpoint_load(const char *path, int threadCount);
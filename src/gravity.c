@@ -0,0 +1,1117 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Direct summation gravity kernels (scalar, AVX2 and AVX-512), the best one supported by the processor is picked at runtime
+              The simd kernels are compiled with per function target attributes, so the rest of the program keeps running on any x86 processor.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include "particle.h"
+#include "gravity.h"
+#include "timer.h"
+#include "tests.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define GRAVITY_X86
+#include <immintrin.h>
+#endif
+
+static const char *s_kernelNames[GRAVITY_KERNEL_COUNT] = {"scalar", "avx2", "avx512"};
+static const char *s_precisionNames[GRAVITY_PRECISION_COUNT] = {"double", "mixed"};
+static atomic_int s_kernel = -1; //-1 : not selected yet, detected on first use (by any of the threads of the pool)
+static GravityPrecision_t s_precision = GRAVITY_PRECISION_DOUBLE;
+static GravityTiles_t s_tiles[GRAVITY_PRECISION_COUNT] = {{GRAVITY_DEFAULT_SOURCE_BLOCK, GRAVITY_DEFAULT_TARGET_BLOCK},
+														  {GRAVITY_DEFAULT_SOURCE_BLOCK, GRAVITY_DEFAULT_TARGET_BLOCK}};
+static size_t s_pairBlock = GRAVITY_DEFAULT_PAIR_BLOCK;
+
+/*
+ * The kernels add the acceleration of every target from every source to ax/ay, the tiled sums call them for every block.
+ */
+
+static void gravity_direct_scalar(const double *sourceX, const double *sourceY, const double *sourceMass, size_t sourceCount,
+								  const double *targetX, const double *targetY, double *ax, double *ay, size_t targetCount)
+{
+	for (size_t i = 0; i < targetCount; i++)
+	{
+		double sumX = 0, sumY = 0;
+
+		for (size_t j = 0; j < sourceCount; j++)
+		{
+			double dx = sourceX[j] - targetX[i];
+			double dy = sourceY[j] - targetY[i];
+			double distanceSquared = dx * dx + dy * dy;
+
+			if (distanceSquared > 0)
+			{
+				double inv = sourceMass[j] / (distanceSquared * sqrt(distanceSquared));
+				sumX += dx * inv;
+				sumY += dy * inv;
+			}
+		}
+
+		ax[i] += G * sumX;
+		ay[i] += G * sumY;
+	}
+}
+
+static void gravity_pairs_scalar(const double *x, const double *y, const double *mass, size_t row, size_t columnBegin, size_t columnEnd,
+								 double *ax, double *ay)
+{
+	double rowMass = G * mass[row];
+	double sumX = 0, sumY = 0;
+
+	for (size_t j = columnBegin; j < columnEnd; j++)
+	{
+		double dx = x[j] - x[row];
+		double dy = y[j] - y[row];
+		double distanceSquared = dx * dx + dy * dy;
+
+		if (distanceSquared > 0)
+		{
+			double inv = 1 / (distanceSquared * sqrt(distanceSquared));
+			//equal and opposite : the row is pulled toward j, j toward the row
+			sumX += dx * inv * mass[j];
+			sumY += dy * inv * mass[j];
+			ax[j] -= dx * inv * rowMass;
+			ay[j] -= dy * inv * rowMass;
+		}
+	}
+
+	ax[row] += G * sumX;
+	ay[row] += G * sumY;
+}
+
+static void gravity_direct_mixed_scalar(const float *sourceX, const float *sourceY, const float *sourceMass, size_t sourceCount,
+										const float *targetX, const float *targetY, double *ax, double *ay, size_t targetCount)
+{
+	for (size_t i = 0; i < targetCount; i++)
+	{
+		double sumX = 0, sumY = 0;
+
+		for (size_t j = 0; j < sourceCount; j++)
+		{
+			float dx = sourceX[j] - targetX[i];
+			float dy = sourceY[j] - targetY[i];
+			float distanceSquared = dx * dx + dy * dy;
+
+			if (distanceSquared > 0)
+			{
+				float inv = sourceMass[j] / (distanceSquared * sqrtf(distanceSquared));
+				sumX += dx * inv;
+				sumY += dy * inv;
+			}
+		}
+
+		ax[i] += G * sumX;
+		ay[i] += G * sumY;
+	}
+}
+
+#ifdef GRAVITY_X86
+/*
+ * 1/sqrt(r2) from the single precision estimate (12 bits) refined by two Newton-Raphson iterations (~46 bits).
+ * Distances have to stay in the float range (1e-19 to 1e19), far outside of anything the simulation produces.
+ */
+__attribute__((target("avx2,fma"))) static inline __m256d gravity_rsqrt_avx2(__m256d r2)
+{
+	const __m256d threeHalves = _mm256_set1_pd(1.5);
+	__m256d half = _mm256_mul_pd(r2, _mm256_set1_pd(0.5));
+	__m256d y = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(r2)));
+
+	y = _mm256_mul_pd(y, _mm256_fnmadd_pd(_mm256_mul_pd(half, y), y, threeHalves));
+	y = _mm256_mul_pd(y, _mm256_fnmadd_pd(_mm256_mul_pd(half, y), y, threeHalves));
+
+	return y;
+}
+
+__attribute__((target("avx2,fma"))) static void gravity_direct_avx2(const double *sourceX, const double *sourceY, const double *sourceMass, size_t sourceCount,
+																	 const double *targetX, const double *targetY, double *ax, double *ay, size_t targetCount)
+{
+	const __m256d zero = _mm256_setzero_pd();
+	size_t vectorCount = sourceCount & ~(size_t)3;
+
+	for (size_t i = 0; i < targetCount; i++)
+	{
+		__m256d x = _mm256_set1_pd(targetX[i]);
+		__m256d y = _mm256_set1_pd(targetY[i]);
+		__m256d sumX = zero, sumY = zero;
+		double lanes[4];
+		double totalX, totalY;
+
+		for (size_t j = 0; j < vectorCount; j += 4)
+		{
+			__m256d dx = _mm256_sub_pd(_mm256_loadu_pd(&sourceX[j]), x);
+			__m256d dy = _mm256_sub_pd(_mm256_loadu_pd(&sourceY[j]), y);
+			__m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_mul_pd(dy, dy));
+			//the target itself (r2 == 0) gets a null contribution instead of inf * 0
+			__m256d inv = _mm256_and_pd(gravity_rsqrt_avx2(r2), _mm256_cmp_pd(r2, zero, _CMP_GT_OQ));
+			__m256d s = _mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(&sourceMass[j]), inv), _mm256_mul_pd(inv, inv));
+
+			sumX = _mm256_fmadd_pd(dx, s, sumX);
+			sumY = _mm256_fmadd_pd(dy, s, sumY);
+		}
+
+		_mm256_storeu_pd(lanes, sumX);
+		totalX = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+		_mm256_storeu_pd(lanes, sumY);
+		totalY = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+		//last sources that do not fill a whole register
+		for (size_t j = vectorCount; j < sourceCount; j++)
+		{
+			double dx = sourceX[j] - targetX[i];
+			double dy = sourceY[j] - targetY[i];
+			double distanceSquared = dx * dx + dy * dy;
+
+			if (distanceSquared > 0)
+			{
+				double inv = sourceMass[j] / (distanceSquared * sqrt(distanceSquared));
+				totalX += dx * inv;
+				totalY += dy * inv;
+			}
+		}
+
+		ax[i] += G * totalX;
+		ay[i] += G * totalY;
+	}
+}
+
+/*
+ * 1/sqrt(r2) from the 14 bits estimate refined by two Newton-Raphson iterations (full double precision).
+ */
+__attribute__((target("avx512f"))) static inline __m512d gravity_rsqrt_avx512(__m512d r2)
+{
+	const __m512d threeHalves = _mm512_set1_pd(1.5);
+	__m512d half = _mm512_mul_pd(r2, _mm512_set1_pd(0.5));
+	__m512d y = _mm512_rsqrt14_pd(r2);
+
+	y = _mm512_mul_pd(y, _mm512_fnmadd_pd(_mm512_mul_pd(half, y), y, threeHalves));
+	y = _mm512_mul_pd(y, _mm512_fnmadd_pd(_mm512_mul_pd(half, y), y, threeHalves));
+
+	return y;
+}
+
+__attribute__((target("avx512f"))) static void gravity_direct_avx512(const double *sourceX, const double *sourceY, const double *sourceMass, size_t sourceCount,
+																	  const double *targetX, const double *targetY, double *ax, double *ay, size_t targetCount)
+{
+	const __m512d zero = _mm512_setzero_pd();
+
+	for (size_t i = 0; i < targetCount; i++)
+	{
+		__m512d x = _mm512_set1_pd(targetX[i]);
+		__m512d y = _mm512_set1_pd(targetY[i]);
+		__m512d sumX = zero, sumY = zero;
+
+		for (size_t j = 0; j < sourceCount; j += 8)
+		{
+			//the last sources are loaded with a mask instead of a scalar loop
+			__mmask8 load = sourceCount - j >= 8 ? 0xFF : (__mmask8)((1u << (sourceCount - j)) - 1);
+			__m512d dx = _mm512_sub_pd(_mm512_maskz_loadu_pd(load, &sourceX[j]), x);
+			__m512d dy = _mm512_sub_pd(_mm512_maskz_loadu_pd(load, &sourceY[j]), y);
+			__m512d r2 = _mm512_fmadd_pd(dx, dx, _mm512_mul_pd(dy, dy));
+			//skip the target itself (r2 == 0) and the lanes past the end
+			__mmask8 valid = _mm512_mask_cmp_pd_mask(load, r2, zero, _CMP_GT_OQ);
+			__m512d inv = gravity_rsqrt_avx512(_mm512_mask_blend_pd(valid, _mm512_set1_pd(1), r2));
+			__m512d s = _mm512_maskz_mul_pd(valid, _mm512_mul_pd(_mm512_maskz_loadu_pd(load, &sourceMass[j]), inv), _mm512_mul_pd(inv, inv));
+
+			sumX = _mm512_fmadd_pd(dx, s, sumX);
+			sumY = _mm512_fmadd_pd(dy, s, sumY);
+		}
+
+		ax[i] += G * _mm512_reduce_add_pd(sumX);
+		ay[i] += G * _mm512_reduce_add_pd(sumY);
+	}
+}
+
+__attribute__((target("avx2,fma"))) static void gravity_pairs_avx2(const double *x, const double *y, const double *mass, size_t row, size_t columnBegin,
+																	size_t columnEnd, double *ax, double *ay)
+{
+	const __m256d zero = _mm256_setzero_pd();
+	__m256d rowX = _mm256_set1_pd(x[row]);
+	__m256d rowY = _mm256_set1_pd(y[row]);
+	__m256d rowMass = _mm256_set1_pd(G * mass[row]);
+	__m256d sumX = zero, sumY = zero;
+	double lanes[4];
+	double totalX, totalY;
+	size_t j = columnBegin;
+
+	for (; j + 4 <= columnEnd; j += 4)
+	{
+		__m256d dx = _mm256_sub_pd(_mm256_loadu_pd(&x[j]), rowX);
+		__m256d dy = _mm256_sub_pd(_mm256_loadu_pd(&y[j]), rowY);
+		__m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_mul_pd(dy, dy));
+		__m256d inv = _mm256_and_pd(gravity_rsqrt_avx2(r2), _mm256_cmp_pd(r2, zero, _CMP_GT_OQ));
+		__m256d s = _mm256_mul_pd(inv, _mm256_mul_pd(inv, inv));
+		__m256d toRow = _mm256_mul_pd(s, _mm256_loadu_pd(&mass[j]));
+		__m256d toJ = _mm256_mul_pd(s, rowMass);
+
+		sumX = _mm256_fmadd_pd(dx, toRow, sumX);
+		sumY = _mm256_fmadd_pd(dy, toRow, sumY);
+		_mm256_storeu_pd(&ax[j], _mm256_fnmadd_pd(dx, toJ, _mm256_loadu_pd(&ax[j])));
+		_mm256_storeu_pd(&ay[j], _mm256_fnmadd_pd(dy, toJ, _mm256_loadu_pd(&ay[j])));
+	}
+
+	_mm256_storeu_pd(lanes, sumX);
+	totalX = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	_mm256_storeu_pd(lanes, sumY);
+	totalY = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+	//last pairs that do not fill a whole register
+	for (; j < columnEnd; j++)
+	{
+		double dx = x[j] - x[row];
+		double dy = y[j] - y[row];
+		double distanceSquared = dx * dx + dy * dy;
+
+		if (distanceSquared > 0)
+		{
+			double inv = 1 / (distanceSquared * sqrt(distanceSquared));
+			totalX += dx * inv * mass[j];
+			totalY += dy * inv * mass[j];
+			ax[j] -= dx * inv * G * mass[row];
+			ay[j] -= dy * inv * G * mass[row];
+		}
+	}
+
+	ax[row] += G * totalX;
+	ay[row] += G * totalY;
+}
+
+__attribute__((target("avx512f"))) static void gravity_pairs_avx512(const double *x, const double *y, const double *mass, size_t row, size_t columnBegin,
+																	 size_t columnEnd, double *ax, double *ay)
+{
+	const __m512d zero = _mm512_setzero_pd();
+	__m512d rowX = _mm512_set1_pd(x[row]);
+	__m512d rowY = _mm512_set1_pd(y[row]);
+	__m512d rowMass = _mm512_set1_pd(G * mass[row]);
+	__m512d sumX = zero, sumY = zero;
+
+	for (size_t j = columnBegin; j < columnEnd; j += 8)
+	{
+		//the last pairs are loaded and stored with a mask instead of a scalar loop
+		__mmask8 load = columnEnd - j >= 8 ? 0xFF : (__mmask8)((1u << (columnEnd - j)) - 1);
+		__m512d dx = _mm512_sub_pd(_mm512_maskz_loadu_pd(load, &x[j]), rowX);
+		__m512d dy = _mm512_sub_pd(_mm512_maskz_loadu_pd(load, &y[j]), rowY);
+		__m512d r2 = _mm512_fmadd_pd(dx, dx, _mm512_mul_pd(dy, dy));
+		__mmask8 valid = _mm512_mask_cmp_pd_mask(load, r2, zero, _CMP_GT_OQ);
+		__m512d inv = gravity_rsqrt_avx512(_mm512_mask_blend_pd(valid, _mm512_set1_pd(1), r2));
+		__m512d s = _mm512_maskz_mul_pd(valid, inv, _mm512_mul_pd(inv, inv));
+		__m512d toRow = _mm512_mul_pd(s, _mm512_maskz_loadu_pd(load, &mass[j]));
+		__m512d toJ = _mm512_mul_pd(s, rowMass);
+
+		sumX = _mm512_fmadd_pd(dx, toRow, sumX);
+		sumY = _mm512_fmadd_pd(dy, toRow, sumY);
+		_mm512_mask_storeu_pd(&ax[j], load, _mm512_fnmadd_pd(dx, toJ, _mm512_maskz_loadu_pd(load, &ax[j])));
+		_mm512_mask_storeu_pd(&ay[j], load, _mm512_fnmadd_pd(dy, toJ, _mm512_maskz_loadu_pd(load, &ay[j])));
+	}
+
+	ax[row] += G * _mm512_reduce_add_pd(sumX);
+	ay[row] += G * _mm512_reduce_add_pd(sumY);
+}
+
+/*
+ * Float 1/sqrt(r2) from the 12 bits estimate refined by one Newton-Raphson iteration (~23 bits, the float precision).
+ */
+__attribute__((target("avx2,fma"))) static inline __m256 gravity_rsqrt_mixed_avx2(__m256 r2)
+{
+	__m256 half = _mm256_mul_ps(r2, _mm256_set1_ps(0.5f));
+	__m256 y = _mm256_rsqrt_ps(r2);
+
+	return _mm256_mul_ps(y, _mm256_fnmadd_ps(_mm256_mul_ps(half, y), y, _mm256_set1_ps(1.5f)));
+}
+
+__attribute__((target("avx2,fma"))) static void gravity_direct_mixed_avx2(const float *sourceX, const float *sourceY, const float *sourceMass, size_t sourceCount,
+																		   const float *targetX, const float *targetY, double *ax, double *ay, size_t targetCount)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	size_t vectorCount = sourceCount & ~(size_t)7;
+
+	for (size_t i = 0; i < targetCount; i++)
+	{
+		__m256 x = _mm256_set1_ps(targetX[i]);
+		__m256 y = _mm256_set1_ps(targetY[i]);
+		__m256d totalX = _mm256_setzero_pd(), totalY = _mm256_setzero_pd();
+		double lanes[4];
+		double sumX, sumY;
+
+		for (size_t block = 0; block < vectorCount; block += GRAVITY_MIXED_BLOCK)
+		{
+			size_t blockEnd = vectorCount - block > GRAVITY_MIXED_BLOCK ? block + GRAVITY_MIXED_BLOCK : vectorCount;
+			__m256 blockX = zero, blockY = zero;
+
+			for (size_t j = block; j < blockEnd; j += 8)
+			{
+				__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&sourceX[j]), x);
+				__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&sourceY[j]), y);
+				__m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_mul_ps(dy, dy));
+				//the target itself (r2 == 0, nan after the refinement) gets a null contribution
+				__m256 inv = _mm256_and_ps(gravity_rsqrt_mixed_avx2(r2), _mm256_cmp_ps(r2, zero, _CMP_GT_OQ));
+				__m256 s = _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(&sourceMass[j]), inv), _mm256_mul_ps(inv, inv));
+
+				blockX = _mm256_fmadd_ps(dx, s, blockX);
+				blockY = _mm256_fmadd_ps(dy, s, blockY);
+			}
+
+			//the 8 float lanes of the block are added to the 4 double lanes
+			totalX = _mm256_add_pd(totalX, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(blockX)), _mm256_cvtps_pd(_mm256_extractf128_ps(blockX, 1))));
+			totalY = _mm256_add_pd(totalY, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(blockY)), _mm256_cvtps_pd(_mm256_extractf128_ps(blockY, 1))));
+		}
+
+		_mm256_storeu_pd(lanes, totalX);
+		sumX = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+		_mm256_storeu_pd(lanes, totalY);
+		sumY = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+		//last sources that do not fill a whole register
+		for (size_t j = vectorCount; j < sourceCount; j++)
+		{
+			float dx = sourceX[j] - targetX[i];
+			float dy = sourceY[j] - targetY[i];
+			float distanceSquared = dx * dx + dy * dy;
+
+			if (distanceSquared > 0)
+			{
+				float inv = sourceMass[j] / (distanceSquared * sqrtf(distanceSquared));
+				sumX += dx * inv;
+				sumY += dy * inv;
+			}
+		}
+
+		ax[i] += G * sumX;
+		ay[i] += G * sumY;
+	}
+}
+
+/*
+ * Float 1/sqrt(r2) from the 14 bits estimate refined by one Newton-Raphson iteration (full float precision).
+ */
+__attribute__((target("avx512f"))) static inline __m512 gravity_rsqrt_mixed_avx512(__m512 r2)
+{
+	__m512 half = _mm512_mul_ps(r2, _mm512_set1_ps(0.5f));
+	__m512 y = _mm512_rsqrt14_ps(r2);
+
+	return _mm512_mul_ps(y, _mm512_fnmadd_ps(_mm512_mul_ps(half, y), y, _mm512_set1_ps(1.5f)));
+}
+
+/*
+ * The 16 float lanes of a register widened to 8 double lanes.
+ */
+__attribute__((target("avx512f"))) static inline __m512d gravity_widen_avx512(__m512 sum)
+{
+	__m256 low = _mm512_castps512_ps256(sum);
+	__m256 high = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(sum), 1));
+
+	return _mm512_add_pd(_mm512_cvtps_pd(low), _mm512_cvtps_pd(high));
+}
+
+__attribute__((target("avx512f"))) static void gravity_direct_mixed_avx512(const float *sourceX, const float *sourceY, const float *sourceMass, size_t sourceCount,
+																			const float *targetX, const float *targetY, double *ax, double *ay, size_t targetCount)
+{
+	const __m512 zero = _mm512_setzero_ps();
+
+	for (size_t i = 0; i < targetCount; i++)
+	{
+		__m512 x = _mm512_set1_ps(targetX[i]);
+		__m512 y = _mm512_set1_ps(targetY[i]);
+		__m512d totalX = _mm512_setzero_pd(), totalY = _mm512_setzero_pd();
+
+		for (size_t block = 0; block < sourceCount; block += GRAVITY_MIXED_BLOCK)
+		{
+			size_t blockEnd = sourceCount - block > GRAVITY_MIXED_BLOCK ? block + GRAVITY_MIXED_BLOCK : sourceCount;
+			__m512 blockX = zero, blockY = zero;
+
+			for (size_t j = block; j < blockEnd; j += 16)
+			{
+				//the last sources are loaded with a mask instead of a scalar loop
+				__mmask16 load = blockEnd - j >= 16 ? 0xFFFF : (__mmask16)((1u << (blockEnd - j)) - 1);
+				__m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(load, &sourceX[j]), x);
+				__m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(load, &sourceY[j]), y);
+				__m512 r2 = _mm512_fmadd_ps(dx, dx, _mm512_mul_ps(dy, dy));
+				//skip the target itself (r2 == 0) and the lanes past the end
+				__mmask16 valid = _mm512_mask_cmp_ps_mask(load, r2, zero, _CMP_GT_OQ);
+				__m512 inv = gravity_rsqrt_mixed_avx512(_mm512_mask_blend_ps(valid, _mm512_set1_ps(1), r2));
+				__m512 s = _mm512_maskz_mul_ps(valid, _mm512_mul_ps(_mm512_maskz_loadu_ps(load, &sourceMass[j]), inv), _mm512_mul_ps(inv, inv));
+
+				blockX = _mm512_fmadd_ps(dx, s, blockX);
+				blockY = _mm512_fmadd_ps(dy, s, blockY);
+			}
+
+			totalX = _mm512_add_pd(totalX, gravity_widen_avx512(blockX));
+			totalY = _mm512_add_pd(totalY, gravity_widen_avx512(blockY));
+		}
+
+		ax[i] += G * _mm512_reduce_add_pd(totalX);
+		ay[i] += G * _mm512_reduce_add_pd(totalY);
+	}
+}
+#endif
+
+bool gravity_kernel_supported(GravityKernel_t kernel)
+{
+	switch (kernel)
+	{
+	case GRAVITY_KERNEL_SCALAR:
+		return true;
+#ifdef GRAVITY_X86
+	case GRAVITY_KERNEL_AVX2:
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	case GRAVITY_KERNEL_AVX512:
+		return __builtin_cpu_supports("avx512f");
+#endif
+	default:
+		return false;
+	}
+}
+
+GravityKernel_t gravity_detect_kernel(void)
+{
+	if (gravity_kernel_supported(GRAVITY_KERNEL_AVX512))
+	{
+		return GRAVITY_KERNEL_AVX512;
+	}
+	if (gravity_kernel_supported(GRAVITY_KERNEL_AVX2))
+	{
+		return GRAVITY_KERNEL_AVX2;
+	}
+	return GRAVITY_KERNEL_SCALAR;
+}
+
+bool gravity_set_kernel(GravityKernel_t kernel)
+{
+	if (!gravity_kernel_supported(kernel))
+	{
+		return false;
+	}
+	atomic_store(&s_kernel, kernel);
+	return true;
+}
+
+GravityKernel_t gravity_get_kernel(void)
+{
+	int kernel = atomic_load_explicit(&s_kernel, memory_order_relaxed);
+
+	if (kernel < 0)
+	{
+		int expected = -1;
+
+		//threads racing on the first use detect the same kernel, one selected meanwhile by gravity_set_kernel is kept
+		kernel = gravity_detect_kernel();
+		if (!atomic_compare_exchange_strong(&s_kernel, &expected, kernel))
+		{
+			kernel = expected;
+		}
+	}
+	return (GravityKernel_t)kernel;
+}
+
+const char *gravity_kernel_name(GravityKernel_t kernel)
+{
+	return kernel >= 0 && kernel < GRAVITY_KERNEL_COUNT ? s_kernelNames[kernel] : "unknown";
+}
+
+bool gravity_kernel_from_name(const char *name, GravityKernel_t *kernel)
+{
+	for (int i = 0; i < GRAVITY_KERNEL_COUNT; i++)
+	{
+		if (strcmp(name, s_kernelNames[i]) == 0)
+		{
+			*kernel = (GravityKernel_t)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void gravity_direct_block(const double *sourceX, const double *sourceY, const double *sourceMass, size_t sourceCount,
+								 const double *targetX, const double *targetY, double *ax, double *ay, size_t targetCount)
+{
+	switch (gravity_get_kernel())
+	{
+#ifdef GRAVITY_X86
+	case GRAVITY_KERNEL_AVX512:
+		gravity_direct_avx512(sourceX, sourceY, sourceMass, sourceCount, targetX, targetY, ax, ay, targetCount);
+		break;
+	case GRAVITY_KERNEL_AVX2:
+		gravity_direct_avx2(sourceX, sourceY, sourceMass, sourceCount, targetX, targetY, ax, ay, targetCount);
+		break;
+#endif
+	default:
+		gravity_direct_scalar(sourceX, sourceY, sourceMass, sourceCount, targetX, targetY, ax, ay, targetCount);
+		break;
+	}
+}
+
+void gravity_pairs(const double *x, const double *y, const double *mass, size_t rowBegin, size_t rowEnd, size_t columnBegin, size_t columnEnd,
+				   double *ax, double *ay)
+{
+	GravityKernel_t kernel = gravity_get_kernel();
+	const size_t block = s_pairBlock;
+
+	//the rows sweep one block of columns at a time (the columns are written too)
+	for (size_t blockBegin = columnBegin; blockBegin < columnEnd; blockBegin += block)
+	{
+		size_t blockEnd = columnEnd - blockBegin < block ? columnEnd : blockBegin + block;
+
+		for (size_t row = rowBegin; row < rowEnd; row++)
+		{
+			//only the columns after the row, a pair is never computed twice when the ranges overlap
+			size_t first = blockBegin > row + 1 ? blockBegin : row + 1;
+
+			if (first >= blockEnd)
+			{
+				continue;
+			}
+			switch (kernel)
+			{
+#ifdef GRAVITY_X86
+			case GRAVITY_KERNEL_AVX512:
+				gravity_pairs_avx512(x, y, mass, row, first, blockEnd, ax, ay);
+				break;
+			case GRAVITY_KERNEL_AVX2:
+				gravity_pairs_avx2(x, y, mass, row, first, blockEnd, ax, ay);
+				break;
+#endif
+			default:
+				gravity_pairs_scalar(x, y, mass, row, first, blockEnd, ax, ay);
+				break;
+			}
+		}
+	}
+}
+
+static void gravity_direct_mixed_block(const float *sourceX, const float *sourceY, const float *sourceMass, size_t sourceCount,
+									   const float *targetX, const float *targetY, double *ax, double *ay, size_t targetCount)
+{
+	switch (gravity_get_kernel())
+	{
+#ifdef GRAVITY_X86
+	case GRAVITY_KERNEL_AVX512:
+		gravity_direct_mixed_avx512(sourceX, sourceY, sourceMass, sourceCount, targetX, targetY, ax, ay, targetCount);
+		break;
+	case GRAVITY_KERNEL_AVX2:
+		gravity_direct_mixed_avx2(sourceX, sourceY, sourceMass, sourceCount, targetX, targetY, ax, ay, targetCount);
+		break;
+#endif
+	default:
+		gravity_direct_mixed_scalar(sourceX, sourceY, sourceMass, sourceCount, targetX, targetY, ax, ay, targetCount);
+		break;
+	}
+}
+
+void gravity_direct(const double *sourceX, const double *sourceY, const double *sourceMass, size_t sourceCount,
+					const double *targetX, const double *targetY, double *ax, double *ay, size_t targetCount)
+{
+	const GravityTiles_t tiles = s_tiles[GRAVITY_PRECISION_DOUBLE];
+
+	memset(ax, 0, targetCount * sizeof(double));
+	memset(ay, 0, targetCount * sizeof(double));
+	if (sourceCount <= tiles.sourceBlock)
+	{
+		gravity_direct_block(sourceX, sourceY, sourceMass, sourceCount, targetX, targetY, ax, ay, targetCount);
+		return;
+	}
+
+	//the sources are already contiguous aligned arrays : a block of them stays in the cache while a block of targets sweeps it
+	for (size_t target = 0; target < targetCount; target += tiles.targetBlock)
+	{
+		size_t targets = targetCount - target < tiles.targetBlock ? targetCount - target : tiles.targetBlock;
+
+		for (size_t source = 0; source < sourceCount; source += tiles.sourceBlock)
+		{
+			size_t sources = sourceCount - source < tiles.sourceBlock ? sourceCount - source : tiles.sourceBlock;
+
+			gravity_direct_block(&sourceX[source], &sourceY[source], &sourceMass[source], sources,
+								 &targetX[target], &targetY[target], &ax[target], &ay[target], targets);
+		}
+	}
+}
+
+void gravity_direct_mixed(const float *sourceX, const float *sourceY, const float *sourceMass, size_t sourceCount,
+						  const float *targetX, const float *targetY, double *ax, double *ay, size_t targetCount)
+{
+	const GravityTiles_t tiles = s_tiles[GRAVITY_PRECISION_MIXED];
+
+	memset(ax, 0, targetCount * sizeof(double));
+	memset(ay, 0, targetCount * sizeof(double));
+	if (sourceCount <= tiles.sourceBlock)
+	{
+		gravity_direct_mixed_block(sourceX, sourceY, sourceMass, sourceCount, targetX, targetY, ax, ay, targetCount);
+		return;
+	}
+
+	for (size_t target = 0; target < targetCount; target += tiles.targetBlock)
+	{
+		size_t targets = targetCount - target < tiles.targetBlock ? targetCount - target : tiles.targetBlock;
+
+		for (size_t source = 0; source < sourceCount; source += tiles.sourceBlock)
+		{
+			size_t sources = sourceCount - source < tiles.sourceBlock ? sourceCount - source : tiles.sourceBlock;
+
+			gravity_direct_mixed_block(&sourceX[source], &sourceY[source], &sourceMass[source], sources,
+									   &targetX[target], &targetY[target], &ax[target], &ay[target], targets);
+		}
+	}
+}
+
+void gravity_set_tiles(GravityPrecision_t precision, GravityTiles_t tiles)
+{
+	tiles.sourceBlock = tiles.sourceBlock < 1 ? 1 : tiles.sourceBlock > GRAVITY_MAX_SOURCE_BLOCK ? GRAVITY_MAX_SOURCE_BLOCK : tiles.sourceBlock;
+	tiles.targetBlock = tiles.targetBlock < 1 ? 1 : tiles.targetBlock;
+	s_tiles[precision] = tiles;
+}
+
+GravityTiles_t gravity_get_tiles(GravityPrecision_t precision)
+{
+	return s_tiles[precision];
+}
+
+void gravity_set_pair_block(size_t block)
+{
+	s_pairBlock = block < 1 ? 1 : block > GRAVITY_MAX_SOURCE_BLOCK ? GRAVITY_MAX_SOURCE_BLOCK : block;
+}
+
+size_t gravity_get_pair_block(void)
+{
+	return s_pairBlock;
+}
+
+//sums timed by gravity_autotune
+typedef struct GravityAutotune_s {
+	double *x, *y, *mass;
+	float *singleX, *singleY, *singleMass;
+	double *ax, *ay;
+} GravityAutotune_t;
+
+/*
+ * Best of GRAVITY_AUTOTUNE_REPEATS timings of the sum of a precision with the current tiles (pairs : gravity_pairs with the current
+ * pair block), the GRAVITY_AUTOTUNE_TARGETS first sources against all of them.
+ */
+static double gravity_autotune_time(GravityAutotune_t *sums, int precision, bool pairs)
+{
+	double best = INFINITY;
+
+	for (int repeat = 0; repeat < GRAVITY_AUTOTUNE_REPEATS; repeat++)
+	{
+		double time = timer_now();
+
+		if (pairs)
+		{
+			gravity_pairs(sums->x, sums->y, sums->mass, 0, GRAVITY_AUTOTUNE_TARGETS, 0, GRAVITY_AUTOTUNE_SOURCES, sums->ax, sums->ay);
+		}
+		else if (precision == GRAVITY_PRECISION_MIXED)
+		{
+			gravity_direct_mixed(sums->singleX, sums->singleY, sums->singleMass, GRAVITY_AUTOTUNE_SOURCES, sums->singleX, sums->singleY,
+								 sums->ax, sums->ay, GRAVITY_AUTOTUNE_TARGETS);
+		}
+		else
+		{
+			gravity_direct(sums->x, sums->y, sums->mass, GRAVITY_AUTOTUNE_SOURCES, sums->x, sums->y, sums->ax, sums->ay, GRAVITY_AUTOTUNE_TARGETS);
+		}
+		best = fmin(best, timer_now() - time);
+	}
+	return best;
+}
+
+void gravity_autotune(void)
+{
+	static const size_t sourceBlocks[] = {512, 1024, 2048, 4096};
+	//up to the whole targets : a thread of a real run has N / threads of them
+	static const size_t targetBlocks[] = {64, 128, 256, 512};
+	GravityAutotune_t sums;
+	double bestTime;
+	size_t bestPairBlock = s_pairBlock;
+	unsigned int seed = 1;
+
+	sums.x = (double *)malloc(GRAVITY_AUTOTUNE_SOURCES * sizeof(double));
+	sums.y = (double *)malloc(GRAVITY_AUTOTUNE_SOURCES * sizeof(double));
+	sums.mass = (double *)malloc(GRAVITY_AUTOTUNE_SOURCES * sizeof(double));
+	sums.singleX = (float *)malloc(GRAVITY_AUTOTUNE_SOURCES * sizeof(float));
+	sums.singleY = (float *)malloc(GRAVITY_AUTOTUNE_SOURCES * sizeof(float));
+	sums.singleMass = (float *)malloc(GRAVITY_AUTOTUNE_SOURCES * sizeof(float));
+	//gravity_pairs also writes the columns
+	sums.ax = (double *)calloc(GRAVITY_AUTOTUNE_SOURCES, sizeof(double));
+	sums.ay = (double *)calloc(GRAVITY_AUTOTUNE_SOURCES, sizeof(double));
+
+	//sources spread over a square larger than the caches of most processors, the targets are the first sources
+	for (size_t i = 0; i < GRAVITY_AUTOTUNE_SOURCES; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		sums.x[i] = (double)(seed >> 8 & 0xFFFF) - 32768;
+		seed = seed * 1103515245 + 12345;
+		sums.y[i] = (double)(seed >> 8 & 0xFFFF) - 32768;
+		sums.mass[i] = 1;
+		sums.singleX[i] = (float)sums.x[i];
+		sums.singleY[i] = (float)sums.y[i];
+		sums.singleMass[i] = 1;
+	}
+
+	for (int precision = 0; precision < GRAVITY_PRECISION_COUNT; precision++)
+	{
+		GravityTiles_t best = s_tiles[precision];
+
+		//warm-up : the pages of the arrays, the caches and the clock of the processor
+		gravity_autotune_time(&sums, precision, false);
+		//the source block with the largest target block, then the target block with the best source block (7 sums instead of 16)
+		bestTime = INFINITY;
+		best.targetBlock = targetBlocks[sizeof(targetBlocks) / sizeof(targetBlocks[0]) - 1];
+		for (size_t s = 0; s < sizeof(sourceBlocks) / sizeof(sourceBlocks[0]); s++)
+		{
+			GravityTiles_t tiles = {sourceBlocks[s], best.targetBlock};
+			double time;
+
+			s_tiles[precision] = tiles;
+			time = gravity_autotune_time(&sums, precision, false);
+			if (time < bestTime)
+			{
+				bestTime = time;
+				best = tiles;
+			}
+		}
+		for (size_t t = 0; t + 1 < sizeof(targetBlocks) / sizeof(targetBlocks[0]); t++)
+		{
+			GravityTiles_t tiles = {best.sourceBlock, targetBlocks[t]};
+			double time;
+
+			s_tiles[precision] = tiles;
+			time = gravity_autotune_time(&sums, precision, false);
+			if (time < bestTime)
+			{
+				bestTime = time;
+				best = tiles;
+			}
+		}
+		s_tiles[precision] = best;
+	}
+
+	//the double precision sum of the particle system : a block of rows against every column
+	bestTime = INFINITY;
+	for (size_t s = 0; s < sizeof(sourceBlocks) / sizeof(sourceBlocks[0]); s++)
+	{
+		double time;
+
+		s_pairBlock = sourceBlocks[s];
+		time = gravity_autotune_time(&sums, GRAVITY_PRECISION_DOUBLE, true);
+		if (time < bestTime)
+		{
+			bestTime = time;
+			bestPairBlock = sourceBlocks[s];
+		}
+	}
+	s_pairBlock = bestPairBlock;
+
+	free(sums.x);
+	free(sums.y);
+	free(sums.mass);
+	free(sums.singleX);
+	free(sums.singleY);
+	free(sums.singleMass);
+	free(sums.ax);
+	free(sums.ay);
+}
+
+void gravity_set_precision(GravityPrecision_t precision)
+{
+	s_precision = precision;
+}
+
+GravityPrecision_t gravity_get_precision(void)
+{
+	return s_precision;
+}
+
+const char *gravity_precision_name(GravityPrecision_t precision)
+{
+	return precision >= 0 && precision < GRAVITY_PRECISION_COUNT ? s_precisionNames[precision] : "unknown";
+}
+
+bool gravity_precision_from_name(const char *name, GravityPrecision_t *precision)
+{
+	for (int i = 0; i < GRAVITY_PRECISION_COUNT; i++)
+	{
+		if (strcmp(name, s_precisionNames[i]) == 0)
+		{
+			*precision = (GravityPrecision_t)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+//Build test : (mingw32-)gcc -o test.exe gravity.c timer.c -DUNIT_TESTS_G
+#ifdef UNIT_TESTS_G
+/* Start the overall test suite */
+START_TESTS()
+START_TEST("Simd kernels match the scalar one")
+//odd count so that the kernels have to deal with a partial register
+const size_t count = 1003;
+double *x = (double *)malloc(count * sizeof(double));
+double *y = (double *)malloc(count * sizeof(double));
+double *mass = (double *)malloc(count * sizeof(double));
+double *referenceX = (double *)malloc(count * sizeof(double));
+double *referenceY = (double *)malloc(count * sizeof(double));
+double *ax = (double *)malloc(count * sizeof(double));
+double *ay = (double *)malloc(count * sizeof(double));
+
+srand(7);
+for (size_t i = 0; i < count; i++)
+{
+	x[i] = rand() % 2000 - 1000 + rand() / (double)RAND_MAX;
+	y[i] = rand() % 2000 - 1000 + rand() / (double)RAND_MAX;
+	mass[i] = rand() % 10 + 1;
+}
+//two particles at the same position only skip each other
+x[5] = x[4];
+y[5] = y[4];
+
+gravity_set_kernel(GRAVITY_KERNEL_SCALAR);
+ASSERT(gravity_get_kernel() == GRAVITY_KERNEL_SCALAR);
+gravity_direct(x, y, mass, count, x, y, referenceX, referenceY, count);
+
+for (int kernel = GRAVITY_KERNEL_AVX2; kernel < GRAVITY_KERNEL_COUNT; kernel++)
+{
+	double maxError = 0;
+
+	if (!gravity_set_kernel((GravityKernel_t)kernel))
+	{
+		printf("%s not supported, skipped\n", gravity_kernel_name((GravityKernel_t)kernel));
+		continue;
+	}
+	gravity_direct(x, y, mass, count, x, y, ax, ay, count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		double error = hypot(ax[i] - referenceX[i], ay[i] - referenceY[i]) / hypot(referenceX[i], referenceY[i]);
+		maxError = fmax(maxError, isfinite(ax[i]) && isfinite(ay[i]) ? error : INFINITY);
+	}
+	printf("%s max relative error : %g\n", gravity_kernel_name((GravityKernel_t)kernel), maxError);
+	ASSERT_LESSTHAN(maxError * 1e12, 1);
+}
+
+ASSERT(gravity_kernel_from_name("avx2", &(GravityKernel_t){GRAVITY_KERNEL_SCALAR}));
+ASSERT(!gravity_kernel_from_name("sse", &(GravityKernel_t){GRAVITY_KERNEL_SCALAR}));
+
+free(x);
+free(y);
+free(mass);
+free(referenceX);
+free(referenceY);
+free(ax);
+free(ay);
+END_TEST()
+
+START_TEST("Mixed precision kernels stay close to the double precision sum")
+//odd count so that the kernels have to deal with a partial register and a partial block
+const size_t count = 1003;
+double *x = (double *)malloc(count * sizeof(double));
+double *y = (double *)malloc(count * sizeof(double));
+double *mass = (double *)malloc(count * sizeof(double));
+float *singleX = (float *)malloc(count * sizeof(float));
+float *singleY = (float *)malloc(count * sizeof(float));
+float *singleMass = (float *)malloc(count * sizeof(float));
+double *referenceX = (double *)malloc(count * sizeof(double));
+double *referenceY = (double *)malloc(count * sizeof(double));
+double *ax = (double *)malloc(count * sizeof(double));
+double *ay = (double *)malloc(count * sizeof(double));
+GravityPrecision_t precision;
+
+srand(7);
+for (size_t i = 0; i < count; i++)
+{
+	x[i] = rand() % 2000 - 1000 + rand() / (double)RAND_MAX;
+	y[i] = rand() % 2000 - 1000 + rand() / (double)RAND_MAX;
+	mass[i] = rand() % 10 + 1;
+	singleX[i] = (float)x[i];
+	singleY[i] = (float)y[i];
+	singleMass[i] = (float)mass[i];
+}
+
+gravity_set_kernel(GRAVITY_KERNEL_SCALAR);
+gravity_direct(x, y, mass, count, x, y, referenceX, referenceY, count);
+
+for (int kernel = GRAVITY_KERNEL_SCALAR; kernel < GRAVITY_KERNEL_COUNT; kernel++)
+{
+	double maxError = 0;
+
+	if (!gravity_set_kernel((GravityKernel_t)kernel))
+	{
+		printf("%s not supported, skipped\n", gravity_kernel_name((GravityKernel_t)kernel));
+		continue;
+	}
+	gravity_direct_mixed(singleX, singleY, singleMass, count, singleX, singleY, ax, ay, count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		double error = hypot(ax[i] - referenceX[i], ay[i] - referenceY[i]) / hypot(referenceX[i], referenceY[i]);
+		maxError = fmax(maxError, isfinite(ax[i]) && isfinite(ay[i]) ? error : INFINITY);
+	}
+	printf("%s mixed precision max relative error : %g\n", gravity_kernel_name((GravityKernel_t)kernel), maxError);
+	//positions of about 1000 rounded to floats (6e-5) for pairs a few units apart
+	ASSERT_LESSTHAN(maxError, 1e-3);
+}
+
+ASSERT(gravity_get_precision() == GRAVITY_PRECISION_DOUBLE);
+ASSERT(gravity_precision_from_name("mixed", &precision) && precision == GRAVITY_PRECISION_MIXED);
+ASSERT(!gravity_precision_from_name("half", &precision));
+
+free(x);
+free(y);
+free(mass);
+free(singleX);
+free(singleY);
+free(singleMass);
+free(referenceX);
+free(referenceY);
+free(ax);
+free(ay);
+END_TEST()
+START_TEST("Symmetric pairs match the direct sum")
+//odd count so that the kernels have to deal with a partial register
+const size_t count = 1003;
+double *x = (double *)malloc(count * sizeof(double));
+double *y = (double *)malloc(count * sizeof(double));
+double *mass = (double *)malloc(count * sizeof(double));
+double *referenceX = (double *)malloc(count * sizeof(double));
+double *referenceY = (double *)malloc(count * sizeof(double));
+double *ax = (double *)malloc(count * sizeof(double));
+double *ay = (double *)malloc(count * sizeof(double));
+
+srand(7);
+for (size_t i = 0; i < count; i++)
+{
+	x[i] = rand() % 2000 - 1000 + rand() / (double)RAND_MAX;
+	y[i] = rand() % 2000 - 1000 + rand() / (double)RAND_MAX;
+	mass[i] = rand() % 10 + 1;
+}
+x[5] = x[4];
+y[5] = y[4];
+
+gravity_set_kernel(GRAVITY_KERNEL_SCALAR);
+gravity_direct(x, y, mass, count, x, y, referenceX, referenceY, count);
+
+for (int kernel = GRAVITY_KERNEL_SCALAR; kernel < GRAVITY_KERNEL_COUNT; kernel++)
+{
+	double maxError = 0, momentumX = 0, momentumY = 0, scale = 0;
+
+	if (!gravity_set_kernel((GravityKernel_t)kernel))
+	{
+		printf("%s not supported, skipped\n", gravity_kernel_name((GravityKernel_t)kernel));
+		continue;
+	}
+	//the triangle of pairs in two tiles of columns (overlapping the rows) gives the same pairs as a single one
+	memset(ax, 0, count * sizeof(double));
+	memset(ay, 0, count * sizeof(double));
+	gravity_pairs(x, y, mass, 0, count, 0, 500, ax, ay);
+	gravity_pairs(x, y, mass, 0, count, 500, count, ax, ay);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		double error = hypot(ax[i] - referenceX[i], ay[i] - referenceY[i]) / hypot(referenceX[i], referenceY[i]);
+		maxError = fmax(maxError, isfinite(ax[i]) && isfinite(ay[i]) ? error : INFINITY);
+		momentumX += mass[i] * ax[i];
+		momentumY += mass[i] * ay[i];
+		scale += mass[i] * hypot(ax[i], ay[i]);
+	}
+	printf("%s pairs max relative error : %g, total force %g of the sum of the forces\n", gravity_kernel_name((GravityKernel_t)kernel), maxError,
+		   hypot(momentumX, momentumY) / scale);
+	ASSERT_LESSTHAN(maxError * 1e12, 1);
+	//equal and opposite contributions : the forces cancel out up to the rounding
+	ASSERT_LESSTHAN(hypot(momentumX, momentumY) / scale * 1e12, 1);
+}
+
+free(x);
+free(y);
+free(mass);
+free(referenceX);
+free(referenceY);
+free(ax);
+free(ay);
+END_TEST()
+START_TEST("Tiled sums match the untiled ones")
+const size_t count = 1003;
+double *x = (double *)malloc(count * sizeof(double));
+double *y = (double *)malloc(count * sizeof(double));
+double *mass = (double *)malloc(count * sizeof(double));
+float *singleX = (float *)malloc(count * sizeof(float));
+float *singleY = (float *)malloc(count * sizeof(float));
+float *singleMass = (float *)malloc(count * sizeof(float));
+double *referenceX = (double *)malloc(count * sizeof(double));
+double *referenceY = (double *)malloc(count * sizeof(double));
+double *mixedX = (double *)malloc(count * sizeof(double));
+double *mixedY = (double *)malloc(count * sizeof(double));
+double *pairsX = (double *)calloc(count, sizeof(double));
+double *pairsY = (double *)calloc(count, sizeof(double));
+double *ax = (double *)malloc(count * sizeof(double));
+double *ay = (double *)malloc(count * sizeof(double));
+double maxError = 0, maxMixedError = 0, maxPairsError = 0;
+
+srand(7);
+for (size_t i = 0; i < count; i++)
+{
+	x[i] = rand() % 2000 - 1000 + rand() / (double)RAND_MAX;
+	y[i] = rand() % 2000 - 1000 + rand() / (double)RAND_MAX;
+	mass[i] = rand() % 10 + 1;
+	singleX[i] = (float)x[i];
+	singleY[i] = (float)y[i];
+	singleMass[i] = (float)mass[i];
+}
+
+gravity_set_kernel(gravity_detect_kernel());
+gravity_direct(x, y, mass, count, x, y, referenceX, referenceY, count);
+gravity_direct_mixed(singleX, singleY, singleMass, count, singleX, singleY, mixedX, mixedY, count);
+
+//blocks that do not divide the counts, the last ones are partial
+gravity_set_tiles(GRAVITY_PRECISION_DOUBLE, (GravityTiles_t){100, 7});
+gravity_set_tiles(GRAVITY_PRECISION_MIXED, (GravityTiles_t){100, 7});
+gravity_set_pair_block(100);
+ASSERT(gravity_get_tiles(GRAVITY_PRECISION_DOUBLE).sourceBlock == 100 && gravity_get_tiles(GRAVITY_PRECISION_MIXED).targetBlock == 7);
+gravity_direct(x, y, mass, count, x, y, ax, ay, count);
+for (size_t i = 0; i < count; i++)
+{
+	maxError = fmax(maxError, hypot(ax[i] - referenceX[i], ay[i] - referenceY[i]) / hypot(referenceX[i], referenceY[i]));
+}
+gravity_direct_mixed(singleX, singleY, singleMass, count, singleX, singleY, ax, ay, count);
+for (size_t i = 0; i < count; i++)
+{
+	maxMixedError = fmax(maxMixedError, hypot(ax[i] - mixedX[i], ay[i] - mixedY[i]) / hypot(mixedX[i], mixedY[i]));
+}
+gravity_pairs(x, y, mass, 0, count, 0, count, pairsX, pairsY);
+for (size_t i = 0; i < count; i++)
+{
+	maxPairsError = fmax(maxPairsError, hypot(pairsX[i] - referenceX[i], pairsY[i] - referenceY[i]) / hypot(referenceX[i], referenceY[i]));
+}
+printf("tiled max relative error : %g double, %g mixed, %g pairs\n", maxError, maxMixedError, maxPairsError);
+ASSERT_LESSTHAN(maxError * 1e12, 1);
+//the float partial sums of the mixed kernels are cut at other places
+ASSERT_LESSTHAN(maxMixedError, 1e-5);
+ASSERT_LESSTHAN(maxPairsError * 1e12, 1);
+
+//out of range blocks are clamped
+gravity_set_tiles(GRAVITY_PRECISION_DOUBLE, (GravityTiles_t){1 << 20, 0});
+ASSERT(gravity_get_tiles(GRAVITY_PRECISION_DOUBLE).sourceBlock == GRAVITY_MAX_SOURCE_BLOCK && gravity_get_tiles(GRAVITY_PRECISION_DOUBLE).targetBlock == 1);
+gravity_set_tiles(GRAVITY_PRECISION_DOUBLE, (GravityTiles_t){GRAVITY_DEFAULT_SOURCE_BLOCK, GRAVITY_DEFAULT_TARGET_BLOCK});
+gravity_set_tiles(GRAVITY_PRECISION_MIXED, (GravityTiles_t){GRAVITY_DEFAULT_SOURCE_BLOCK, GRAVITY_DEFAULT_TARGET_BLOCK});
+gravity_set_pair_block(0);
+ASSERT(gravity_get_pair_block() == 1);
+gravity_set_pair_block(GRAVITY_DEFAULT_PAIR_BLOCK);
+
+free(x);
+free(y);
+free(mass);
+free(singleX);
+free(singleY);
+free(singleMass);
+free(referenceX);
+free(referenceY);
+free(mixedX);
+free(mixedY);
+free(pairsX);
+free(pairsY);
+free(ax);
+free(ay);
+END_TEST()
+/* End the overall test suite */
+END_TESTS()
+#endif
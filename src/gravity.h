@@ -0,0 +1,169 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Direct summation gravity kernels (scalar, AVX2 and AVX-512), the best one supported by the processor is picked at runtime,
+              in double precision or in mixed precision (float pair terms, double sums)
+*/
+#include <stddef.h>
+#include <stdbool.h>
+
+#pragma once
+
+//Instruction sets the direct sum can run on
+typedef enum GravityKernel_e {
+	GRAVITY_KERNEL_SCALAR,
+	GRAVITY_KERNEL_AVX2,   //4 sources per instruction (AVX2 + FMA)
+	GRAVITY_KERNEL_AVX512, //8 sources per instruction (AVX-512F)
+	GRAVITY_KERNEL_COUNT
+} GravityKernel_t;
+
+//Precisions of the direct sum of the particle system
+typedef enum GravityPrecision_e {
+	GRAVITY_PRECISION_DOUBLE,
+	GRAVITY_PRECISION_MIXED, //float positions relative to the center of the particles and float pair terms, summed in double
+	GRAVITY_PRECISION_COUNT
+} GravityPrecision_t;
+
+//sources whose float contributions are summed in a float register before being added to the double sums of the mixed precision kernels
+#define GRAVITY_MIXED_BLOCK 256
+//largest block of sources of the tiled direct sums (96 KB of double precision positions and masses)
+#define GRAVITY_MAX_SOURCE_BLOCK 4096
+//tiles used until gravity_autotune or gravity_set_tiles
+#define GRAVITY_DEFAULT_SOURCE_BLOCK 2048
+#define GRAVITY_DEFAULT_TARGET_BLOCK 128
+//columns swept together by gravity_pairs until gravity_autotune or gravity_set_pair_block
+#define GRAVITY_DEFAULT_PAIR_BLOCK 2048
+//size of the direct sum timed by gravity_autotune for every tile candidate (1.5 MB of double precision sources, more targets than the
+//largest target block), best of GRAVITY_AUTOTUNE_REPEATS timings after a warm-up
+#define GRAVITY_AUTOTUNE_SOURCES 32768
+#define GRAVITY_AUTOTUNE_TARGETS 512
+#define GRAVITY_AUTOTUNE_REPEATS 3
+
+//Tiles of the direct sums : once the sources do not fit in the cache anymore, a block of sources is reused by a block of
+//targets before moving to the next one, so the sums stay limited by the arithmetic instead of the memory bandwidth
+typedef struct GravityTiles_s {
+	size_t sourceBlock; //sources swept together, at most GRAVITY_MAX_SOURCE_BLOCK
+	size_t targetBlock; //targets sweeping a block of sources before the next one
+} GravityTiles_t;
+
+/**
+ * @brief Get the fastest kernel supported by the processor.
+ * @return GravityKernel_t
+ */
+GravityKernel_t gravity_detect_kernel(void);
+
+/**
+ * @brief Check if the processor can run a kernel.
+ * @return bool
+ */
+bool gravity_kernel_supported(GravityKernel_t kernel);
+
+/**
+ * @brief Select the kernel used by gravity_direct (the detected one is used until this is called).
+ * @return bool false if the processor does not support it (the selection is left unchanged)
+ */
+bool gravity_set_kernel(GravityKernel_t kernel);
+
+/**
+ * @brief Get the kernel used by gravity_direct.
+ * @return GravityKernel_t
+ */
+GravityKernel_t gravity_get_kernel(void);
+
+/**
+ * @brief Get the name of a kernel ("scalar", "avx2", "avx512").
+ * @return const char*
+ */
+const char *gravity_kernel_name(GravityKernel_t kernel);
+
+/**
+ * @brief Get a kernel from its name.
+ * @return bool false if the name is unknown
+ */
+bool gravity_kernel_from_name(const char *name, GravityKernel_t *kernel);
+
+/**
+ * @brief Compute the gravitational acceleration of every target from every source (direct sum) with the selected kernel, tiled when
+ * there are more sources than the source block. Sources exactly at the position of the target (the target itself) are skipped.
+ * The accelerations are overwritten, not added.
+ * @return void
+ */
+void gravity_direct(const double *sourceX, const double *sourceY, const double *sourceMass, size_t sourceCount,
+					const double *targetX, const double *targetY, double *ax, double *ay, size_t targetCount);
+
+/**
+ * @brief Add the gravitational accelerations of the pairs (row, column), rowBegin <= row < rowEnd, columnBegin <= column < columnEnd
+ * and row < column, to both particles with the selected kernel. Newton's third law : every pair is computed once and gives equal and
+ * opposite contributions, [0, count) x [0, count) is half the pair terms of gravity_direct over the same particles.
+ * The rows sweep the columns one pair block at a time. Particles at the same position are skipped. The accelerations are added to ax/ay (not overwritten).
+ * @return void
+ */
+void gravity_pairs(const double *x, const double *y, const double *mass, size_t rowBegin, size_t rowEnd, size_t columnBegin, size_t columnEnd,
+				   double *ax, double *ay);
+
+/**
+ * @brief Compute the gravitational acceleration of every target from every source with the selected kernel in mixed precision :
+ * the pair terms are computed on floats (twice as many sources per instruction as gravity_direct, half the memory read), partial sums
+ * of GRAVITY_MIXED_BLOCK sources are added in double. The positions should be relative to a point close to the particles (the float
+ * resolution is relative to their magnitude). Sources at the same float position as the target are skipped. The accelerations are overwritten.
+ * @return void
+ */
+void gravity_direct_mixed(const float *sourceX, const float *sourceY, const float *sourceMass, size_t sourceCount,
+						  const float *targetX, const float *targetY, double *ax, double *ay, size_t targetCount);
+
+/**
+ * @brief Select the tiles of the direct sums of a precision (the source block is clamped to [1, GRAVITY_MAX_SOURCE_BLOCK]).
+ * @return void
+ */
+void gravity_set_tiles(GravityPrecision_t precision, GravityTiles_t tiles);
+
+/**
+ * @brief Get the tiles of the direct sums of a precision.
+ * @return GravityTiles_t
+ */
+GravityTiles_t gravity_get_tiles(GravityPrecision_t precision);
+
+/**
+ * @brief Select the columns swept together by gravity_pairs (clamped to [1, GRAVITY_MAX_SOURCE_BLOCK]).
+ * @return void
+ */
+void gravity_set_pair_block(size_t block);
+
+/**
+ * @brief Get the columns swept together by gravity_pairs.
+ * @return size_t
+ */
+size_t gravity_get_pair_block(void);
+
+/**
+ * @brief Time a direct sum of GRAVITY_AUTOTUNE_TARGETS targets and GRAVITY_AUTOTUNE_SOURCES sources with the tile candidates on the
+ * selected kernel and keep the fastest ones, for both precisions of gravity_direct, then gravity_pairs over as many rows and columns with
+ * every pair block candidate (under a second with AVX-512, a few with the scalar kernel). Meant to be called once at startup, after the
+ * kernel is selected.
+ * @return void
+ */
+void gravity_autotune(void);
+
+/**
+ * @brief Select the precision of particle_system_accelerations_direct (double until this is called).
+ * @return void
+ */
+void gravity_set_precision(GravityPrecision_t precision);
+
+/**
+ * @brief Get the precision of particle_system_accelerations_direct.
+ * @return GravityPrecision_t
+ */
+GravityPrecision_t gravity_get_precision(void);
+
+/**
+ * @brief Get the name of a precision ("double", "mixed").
+ * @return const char*
+ */
+const char *gravity_precision_name(GravityPrecision_t precision);
+
+/**
+ * @brief Get a precision from its name.
+ * @return bool false if the name is unknown
+ */
+bool gravity_precision_from_name(const char *name, GravityPrecision_t *precision);
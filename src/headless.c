@@ -0,0 +1,428 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Headless batch simulation (no SDL, no window), runs the physics as fast as possible and writes the particles to csv files
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "particle_system.h"
+#include "simulation.h"
+#include "gravity.h"
+#include "timer.h"
+#include "checkpoint.h"
+#include "trajectory.h"
+#include "profiler.h"
+#include "trace.h"
+
+#define DEFAULT_PARTICLES 250
+#define DEFAULT_STEPS 1000
+#define DEFAULT_HALF_WIDTH 640
+#define DEFAULT_HALF_HEIGHT 360
+
+static void print_usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-n <particles>] [-steps <count>] [-dt <time step>] [-seed <seed>]\n"
+					"          [-solver direct|barnes-hut|particle-mesh] [-theta <opening angle>] [-grid <cells per side>] [-threads <count>] [-kernel scalar|avx2|avx512] [-precision double|mixed]\n"
+					"          [-integrator verlet|leapfrog|yoshida] [-block-levels <0 : off, up to %d>] [-eta <accuracy of the block time steps>]\n"
+					"          [-reorder <steps between two Morton sorts of the particles, 0 : never>]\n"
+					"          [-output <file prefix>] [-every <steps between two outputs>]\n"
+					"          [-load <checkpoint>] [-checkpoint <file written with every output>]\n"
+					"          [-trajectory <file>] [-trajectory-every <steps between two frames>] [-quantum <position resolution>]\n"
+					"          [-profile <csv file of the phase timings of every step, - : summary only>] [-trace <trace.json, needs a build with -DTRACING>]\n",
+			name, BLOCK_STEPS_MAX_LEVEL);
+}
+
+/*
+ * Write the state of every particle to <prefix>_<step>.csv, in the order of their ids (the same row in every file).
+ */
+static bool write_csv(Simulation_t *simulation, const char *prefix)
+{
+	ParticleSystem_t *particles = simulation->particles;
+	char path[512];
+	FILE *file;
+
+	snprintf(path, sizeof(path), "%s_%06llu.csv", prefix, simulation->step);
+	file = fopen(path, "w");
+	if (file == NULL)
+	{
+		fprintf(stderr, "error: could not open %s\n", path);
+		return false;
+	}
+
+	fprintf(file, "x,y,lastX,lastY,mass\n");
+	for (size_t id = 0; id < particles->count; id++)
+	{
+		size_t i = particles->slots[id];
+
+		if (!particle_system_alive(particles, i))
+		{
+			continue;
+		}
+		fprintf(file, "%.17g,%.17g,%.17g,%.17g,%.17g\n", particles->x[i], particles->y[i], particles->lastX[i], particles->lastY[i], particles->mass[i]);
+	}
+
+	fclose(file);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t count = DEFAULT_PARTICLES;
+	unsigned long long steps = DEFAULT_STEPS;
+	unsigned long long every = 0; //0 : only the final state
+	unsigned int seed = (unsigned int)time(NULL);
+	double timeStep = SIMULATION_DEFAULT_TIME_STEP;
+	Solver_t solver = SOLVER_DIRECT;
+	Integrator_t integrator = INTEGRATOR_VERLET;
+	double theta = QUADTREE_DEFAULT_THETA;
+	int meshSize = PARTICLE_MESH_DEFAULT_SIZE;
+	int blockLevels = 0;
+	double blockEta = BLOCK_STEPS_DEFAULT_ETA;
+	int reorderInterval = SIMULATION_DEFAULT_REORDER_INTERVAL;
+	int threads = 0;
+	const char *output = "galaxy";
+	const char *load = NULL;
+	const char *checkpoint = NULL;
+	const char *trajectoryPath = NULL;
+	unsigned long long trajectoryEvery = 1;
+	double quantum = TRAJECTORY_DEFAULT_QUANTUM;
+	TrajectoryWriter_t *trajectory = NULL;
+	const char *profilePath = NULL;
+	Profiler_t *profiler = NULL;
+	const char *tracePath = NULL;
+	Simulation_t *simulation;
+	double start, elapsed;
+	unsigned long long first, evaluations = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (i + 1 >= argc)
+		{
+			print_usage(argv[0]);
+			return 1;
+		}
+
+		if (strcmp(argv[i], "-n") == 0)
+		{
+			count = strtoull(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "-steps") == 0)
+		{
+			steps = strtoull(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "-dt") == 0)
+		{
+			timeStep = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-seed") == 0)
+		{
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "-solver") == 0)
+		{
+			if (!simulation_solver_from_name(argv[++i], &solver))
+			{
+				fprintf(stderr, "error: unknown solver %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-integrator") == 0)
+		{
+			if (!simulation_integrator_from_name(argv[++i], &integrator))
+			{
+				fprintf(stderr, "error: unknown integrator %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-theta") == 0)
+		{
+			theta = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-grid") == 0)
+		{
+			meshSize = atoi(argv[++i]);
+			if (!particle_mesh_valid_size(meshSize))
+			{
+				fprintf(stderr, "error: the grid size must be a power of 2 between %d and %d\n", PARTICLE_MESH_MIN_SIZE, PARTICLE_MESH_MAX_SIZE);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-block-levels") == 0)
+		{
+			blockLevels = atoi(argv[++i]);
+			if (blockLevels < 0 || blockLevels > BLOCK_STEPS_MAX_LEVEL)
+			{
+				fprintf(stderr, "error: the block levels must be between 0 and %d\n", BLOCK_STEPS_MAX_LEVEL);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-eta") == 0)
+		{
+			blockEta = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-reorder") == 0)
+		{
+			reorderInterval = atoi(argv[++i]);
+			if (reorderInterval < 0)
+			{
+				fprintf(stderr, "error: the steps between two sorts must be 0 or more\n");
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-threads") == 0)
+		{
+			threads = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-kernel") == 0)
+		{
+			GravityKernel_t kernel;
+
+			i++;
+			if (!gravity_kernel_from_name(argv[i], &kernel) || !gravity_set_kernel(kernel))
+			{
+				fprintf(stderr, "error: kernel %s unknown or not supported by this processor\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-precision") == 0)
+		{
+			GravityPrecision_t precision;
+
+			if (!gravity_precision_from_name(argv[++i], &precision))
+			{
+				fprintf(stderr, "error: unknown precision %s\n", argv[i]);
+				return 1;
+			}
+			gravity_set_precision(precision);
+		}
+		else if (strcmp(argv[i], "-output") == 0)
+		{
+			output = argv[++i];
+		}
+		else if (strcmp(argv[i], "-every") == 0)
+		{
+			every = strtoull(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "-load") == 0)
+		{
+			load = argv[++i];
+		}
+		else if (strcmp(argv[i], "-checkpoint") == 0)
+		{
+			checkpoint = argv[++i];
+		}
+		else if (strcmp(argv[i], "-trajectory") == 0)
+		{
+			trajectoryPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "-trajectory-every") == 0)
+		{
+			trajectoryEvery = strtoull(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "-quantum") == 0)
+		{
+			quantum = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-profile") == 0)
+		{
+			profilePath = argv[++i];
+		}
+		else if (strcmp(argv[i], "-trace") == 0)
+		{
+			tracePath = argv[++i];
+		}
+		else
+		{
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (load != NULL)
+	{
+		//restart from a checkpoint : its state and settings replace -n, -dt, -seed, -solver and -theta, -steps counts from its step
+		start = timer_now();
+		simulation = checkpoint_load(load, threads);
+		if (simulation == NULL)
+		{
+			return 1;
+		}
+		printf("Restored %s (step %llu) in %.3f ms\n", load, simulation->step, (timer_now() - start) * 1000);
+		count = simulation->particles->count;
+		steps += simulation->step;
+		timeStep = simulation->timeStep;
+		solver = simulation->solver;
+	}
+	else
+	{
+		simulation = simulation_initializer(threads);
+		simulation->solver = solver;
+		simulation->integrator = integrator;
+		simulation->theta = theta;
+		simulation->meshSize = meshSize;
+		simulation->blockLevels = blockLevels;
+		simulation->blockEta = blockEta;
+		simulation->timeStep = timeStep;
+		simulation_populate(simulation, count, DEFAULT_HALF_WIDTH, DEFAULT_HALF_HEIGHT, seed);
+	}
+	//not saved in the checkpoints (only where the particles are in memory)
+	simulation->reorderInterval = reorderInterval;
+
+	//tiles of the direct sums tuned for this processor and the selected kernel
+	gravity_autotune();
+	printf("%zu particles, %llu steps of %g, seed %u, %s solver, %s integrator, %d threads, %s kernel, %s precision (tiles of %zu sources x %zu targets, pair blocks of %zu), sorted every %d steps\n",
+		   count, steps - simulation->step, timeStep, seed, simulation_solver_name(solver), simulation_integrator_name(simulation->integrator),
+		   thread_pool_thread_count(simulation->pool), gravity_kernel_name(gravity_get_kernel()), gravity_precision_name(gravity_get_precision()),
+		   gravity_get_tiles(gravity_get_precision()).sourceBlock, gravity_get_tiles(gravity_get_precision()).targetBlock, gravity_get_pair_block(), reorderInterval);
+
+	if (trajectoryPath != NULL)
+	{
+		//every frame is kept, the simulation waits for the writer thread when it falls behind
+		trajectory = trajectory_writer_initializer(trajectoryPath, quantum, TRAJECTORY_DEFAULT_SLOTS, false);
+		if (trajectory == NULL)
+		{
+			simulation_destroy(simulation);
+			return 1;
+		}
+	}
+
+	if (profilePath != NULL)
+	{
+		//the phases of every step (the step itself, its forces and integration, the outputs)
+		profiler = profiler_initializer();
+		simulation->profiler = profiler;
+		if (strcmp(profilePath, "-") != 0 && !profiler_open_csv(profiler, profilePath))
+		{
+			profiler_destroy(profiler);
+			if (trajectory != NULL)
+			{
+				trajectory_writer_destroy(trajectory);
+			}
+			simulation_destroy(simulation);
+			return 1;
+		}
+	}
+
+	if (tracePath != NULL && !trace_start())
+	{
+		if (profiler != NULL)
+		{
+			profiler_destroy(profiler);
+		}
+		if (trajectory != NULL)
+		{
+			trajectory_writer_destroy(trajectory);
+		}
+		simulation_destroy(simulation);
+		return 1;
+	}
+	TRACE_THREAD_NAME("main");
+
+	first = simulation->step;
+	start = timer_now();
+	while (simulation->step < steps)
+	{
+		PROFILER_SCOPE(profiler, "step") TRACE_SCOPE("step")
+		{
+			simulation_step(simulation);
+		}
+		evaluations += simulation->blockLevels > 0 ? simulation->blocks->evaluations : simulation->particles->count - simulation->particles->freeCount;
+
+		if (trajectory != NULL && trajectoryEvery > 0 && simulation->step % trajectoryEvery == 0)
+		{
+			PROFILER_SCOPE(profiler, "trajectory")
+			{
+				trajectory_writer_push(trajectory, simulation->particles, simulation->step);
+			}
+		}
+		if (every > 0 && simulation->step % every == 0 && simulation->step < steps)
+		{
+			bool written;
+
+			profiler_begin(profiler, "output");
+			written = write_csv(simulation, output) && (checkpoint == NULL || checkpoint_save(simulation, checkpoint));
+			profiler_end(profiler, "output");
+			if (!written)
+			{
+				if (profiler != NULL)
+				{
+					profiler_destroy(profiler);
+				}
+				if (trajectory != NULL)
+				{
+					trajectory_writer_destroy(trajectory);
+				}
+				simulation_destroy(simulation);
+				return 1;
+			}
+		}
+		profiler_end_frame(profiler);
+	}
+	elapsed = timer_now() - start;
+	if (tracePath != NULL)
+	{
+		//the workers of the pool are waiting for the next loop, none of them records anything now
+		trace_stop();
+		if (trace_write(tracePath))
+		{
+			printf("trace written to %s\n", tracePath);
+		}
+		trace_free();
+	}
+
+	printf("%llu steps in %.3f s (%.1f steps/s)\n", steps - first, elapsed, elapsed > 0 ? (steps - first) / elapsed : 0.0);
+	if (simulation->blockLevels > 0 && steps > first)
+	{
+		printf("block time steps (%d levels) : %.1f accelerations per particle and per step\n", simulation->blockLevels,
+			   (double)evaluations / (steps - first) / (simulation->particles->count - simulation->particles->freeCount));
+	}
+	if (gravity_get_precision() == GRAVITY_PRECISION_MIXED && simulation->solver == SOLVER_DIRECT && simulation->blockLevels == 0)
+	{
+		double maxError, rmsError;
+
+		//accelerations of the final positions in both precisions (one more direct sum in double)
+		particle_system_precision_error(simulation->particles, simulation->pool, &maxError, &rmsError);
+		printf("mixed precision relative error of the accelerations : max %.3g, rms %.3g\n", maxError, rmsError);
+	}
+	if (profiler != NULL)
+	{
+		//statistics over the last PROFILER_WINDOW steps in which each phase ran
+		printf("%-12s %10s %10s %10s\n", "phase (ms)", "min", "avg", "p99");
+		for (int i = 0; i < profiler->timerCount; i++)
+		{
+			double min, average, p99;
+
+			if (profiler_statistics(profiler, profiler->timers[i].name, &min, &average, &p99))
+			{
+				printf("%-12s %10.4f %10.4f %10.4f\n", profiler->timers[i].name, min * 1000, average * 1000, p99 * 1000);
+			}
+		}
+		simulation->profiler = NULL;
+		profiler_destroy(profiler);
+	}
+
+	if (trajectory != NULL)
+	{
+		bool written = trajectory_writer_close(trajectory);
+
+		printf("%llu trajectory frames, %.2f MB written to %s\n", trajectory->framesWritten, trajectory->bytesWritten / (1024.0 * 1024.0), trajectoryPath);
+		trajectory_writer_destroy(trajectory);
+		if (!written)
+		{
+			fprintf(stderr, "error: could not write %s\n", trajectoryPath);
+			simulation_destroy(simulation);
+			return 1;
+		}
+	}
+
+	if (!write_csv(simulation, output) || (checkpoint != NULL && !checkpoint_save(simulation, checkpoint)))
+	{
+		simulation_destroy(simulation);
+		return 1;
+	}
+
+	simulation_destroy(simulation);
+	return 0;
+}
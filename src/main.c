@@ -5,11 +5,25 @@
 #include "matrix.h"
 #include "rectangle.h"
 #include "particle.h"
+#include "particle_system.h"
+#include "quadtree.h"
+#include "particle_mesh.h"
+#include "thread_pool.h"
+#include "gravity.h"
+#include "simulation.h"
+#include "snapshot.h"
+#include "profiler.h"
+#include "trace.h"
+#include "timer.h"
+#include "particle_renderer.h"
+#include "text_overlay.h"
+#include "checkpoint.h"
+#include "trajectory.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include <time.h>
-
-#define E_PI 3.1415926535897932384626433832795028841971693993751058209749445923078164062
+#include <string.h>
+#include <stdatomic.h>
 
 //debug var
 char *tmpStrDebug;
@@ -18,159 +32,195 @@ char *tmpStrDebug;
 	printf(tmpStrDebug);                \
 	free(tmpStrDebug);
 
-#define NB_PARTICLES 250
+#define DEFAULT_NB_PARTICLES 250
+//radius (in pixels) around the cursor in which a right click removes the closest particle
+#define DESPAWN_RADIUS 20
 
 #define INITIAL_WINDOW_HEIGHT 720
 #define INITIAL_WINDOW_WIDTH 1280
 #define SCALE 1
-#define MIN_BOUND_X (-(INITIAL_WINDOW_WIDTH * SCALE / 2))  //left most value possible for x
-#define MAX_BOUND_X (INITIAL_WINDOW_WIDTH * SCALE / 2)	   //right most value possible for x
-#define MIN_BOUND_Y (-(INITIAL_WINDOW_HEIGHT * SCALE / 2)) //bottom most value possible for y
-#define MAX_BOUND_Y (INITIAL_WINDOW_HEIGHT * SCALE / 2)	   //top most value possible for y
-#define MIN_MASS (1 * SCALE)
-#define MAX_MASS (10 * SCALE)
+#define MAX_BOUND_X (INITIAL_WINDOW_WIDTH * SCALE / 2)	   //right most value possible for x (the left most is -MAX_BOUND_X)
+#define MAX_BOUND_Y (INITIAL_WINDOW_HEIGHT * SCALE / 2)	   //top most value possible for y (the bottom most is -MAX_BOUND_Y)
 #define TIME_STEP (10 * SCALE)
-#define TIME_STEP_SQUARED (TIME_STEP * TIME_STEP)
+//physics steps per second of the physics thread (independent from the frame rate), 0 : as fast as possible
+#define DEFAULT_PHYSICS_RATE 60
+//seconds between two computations of the total energy (direct sum over every pair, too slow for every step)
+#define ENERGY_INTERVAL 1.0
+//above this number of particles the energy is not computed at all (it would stall the physics thread for seconds)
+#define ENERGY_MAX_PARTICLES 20000
+#define STATS_FONT_SIZE 14
+//characters of the statistics overlay (the phase timings of both threads included)
+#define STATS_BUFFER_SIZE 1024
+#define DEFAULT_CHECKPOINT "galaxy.ckpt"
 
 Uint64 NOW = 0;
 Uint64 LAST = 0;
 double deltaTime = 0;
 
-Matrix_t *g_origin;
-Particle_t *g_particles;
-Particle_t *g_black_hole;
+Vector2_t g_origin;
+Simulation_t *g_simulation; //only used by the physics thread once it is started
+Vector2_t g_black_hole; //position of the black hole for Render() (it never moves, copied before the physics thread starts)
+SnapshotBuffer_t *g_snapshots; //states published by the physics thread for Render()
+ParticleRenderer_t *g_particle_renderer;
+TextOverlay_t *g_text_overlay;
 int g_window_width = INITIAL_WINDOW_WIDTH, g_window_height = INITIAL_WINDOW_HEIGHT;
-bool g_press_right, g_press_left, g_press_control;
+double g_physics_rate = DEFAULT_PHYSICS_RATE;
+bool g_interpolate = true; //render between the two last physics states instead of the last one (only with a fixed physics rate)
+//input shared between the ui thread (events) and the physics thread
+atomic_bool g_press_right, g_press_left, g_press_control;
+atomic_int g_mouse_x, g_mouse_y; //position of the cursor in simulation coordinates (y goes up)
+atomic_bool g_toggle_solver;
+atomic_bool g_save_checkpoint;
+const char *g_checkpoint_path = DEFAULT_CHECKPOINT;
+TrajectoryWriter_t *g_trajectory; //every step is recorded when not NULL, frames are dropped rather than slowing the physics down
+atomic_bool g_physics_running;
+Profiler_t *g_frame_profiler;	//phases of the rendered frames (ui thread only)
+Profiler_t *g_physics_profiler; //phases of the physics steps (physics thread only once it is started)
+atomic_bool g_show_timings;		//P shows the rolling average / 99th percentile of every phase in the overlay
 
-int fill_circle(SDL_Renderer *renderer, int x, int y, int radius)
+/**
+ * @brief Updates the physics values of every particles currently in the simulation (physics thread only).
+ */
+void PhysicsUpdate()
 {
-	int origin_x = (int)matrix_valueOf(g_origin, 0, 0);
-	int origin_y = (int)matrix_valueOf(g_origin, 0, 1);
-	int offsetx, offsety, d;
-	int status;
-
-	offsetx = 0;
-	offsety = radius;
-	d = radius - 1;
-	status = 0;
+	double x = atomic_load(&g_mouse_x);
+	double y = atomic_load(&g_mouse_y);
 
-	while (offsety >= offsetx)
+	profiler_begin(g_physics_profiler, "input");
+	//B cycles through the solvers (direct sum, Barnes-Hut, particle-mesh)
+	if (atomic_exchange(&g_toggle_solver, false))
 	{
+		g_simulation->solver = (Solver_t)((g_simulation->solver + 1) % SOLVER_COUNT);
+		printf("Solver : %s\n", simulation_solver_name(g_simulation->solver));
+	}
 
-		status += SDL_RenderDrawLine(renderer, origin_x + x - offsety, origin_y - y + offsetx, origin_x + x + offsety, origin_y - y + offsetx);
-		status += SDL_RenderDrawLine(renderer, origin_x + x - offsetx, origin_y - y + offsety, origin_x + x + offsetx, origin_y - y + offsety);
-		status += SDL_RenderDrawLine(renderer, origin_x + x - offsetx, origin_y - y - offsety, origin_x + x + offsetx, origin_y - y - offsety);
-		status += SDL_RenderDrawLine(renderer, origin_x + x - offsety, origin_y - y - offsetx, origin_x + x + offsety, origin_y - y - offsetx);
-		if (status < 0)
-		{
-			status = -1;
-			break;
-		}
+	//F5 saves a checkpoint of the state between two steps
+	if (atomic_exchange(&g_save_checkpoint, false) && checkpoint_save(g_simulation, g_checkpoint_path))
+	{
+		printf("Checkpoint saved to %s (step %llu)\n", g_checkpoint_path, g_simulation->step);
+	}
 
-		if (d >= 2 * offsetx)
-		{
-			d -= 2 * offsetx + 1;
-			offsetx += 1;
-		}
-		else if (d < 2 * (radius - offsety))
-		{
-			d += 2 * offsety - 1;
-			offsety -= 1;
-		}
-		else
-		{
-			d += 2 * (offsety - offsetx - 1);
-			offsety -= 1;
-			offsetx += 1;
-		}
+	//left button held : spawn a particle under the cursor every step, right button held : remove the closest one
+	if (g_press_left)
+	{
+		simulation_spawn(g_simulation, x, y, rand() % (SIMULATION_MAX_MASS - SIMULATION_MIN_MASS) + SIMULATION_MIN_MASS);
 	}
+	if (g_press_right)
+	{
+		simulation_despawn_nearest(g_simulation, x, y, DESPAWN_RADIUS * SCALE);
+	}
+	profiler_end(g_physics_profiler, "input");
 
-	return status;
+	//the step measures its own phases (forces, integration) in the same profiler
+	PROFILER_SCOPE(g_physics_profiler, "step")
+	{
+		simulation_step(g_simulation);
+	}
 }
 
 /**
- * @brief Updates the physics values of every particles currently in the simulation.
+ * @brief Physics thread : steps the simulation at g_physics_rate steps per second and publishes every new state to g_snapshots.
  */
-void PhysicsUpdate()
+int PhysicsThread(void *data)
 {
-	Matrix_t *nextPositions[NB_PARTICLES];
-
-	//for every particle
-	for (size_t i = 0; i < NB_PARTICLES; i++)
+	double interval = g_physics_rate > 0 ? 1.0 / g_physics_rate : 0;
+	double next = timer_now();
+	double energy = NAN;
+	double lastEnergyTime = -ENERGY_INTERVAL;
+
+	(void)data;
+	TRACE_THREAD_NAME("physics");
+	while (atomic_load(&g_physics_running))
 	{
-		//declare temporary variables
-		Matrix_t *tmpForce, *tmpTotalForce, *old;
-		INITIALISE_MATRIX_VECTOR2(tmpTotalForce, 0, 0)
+		double start = timer_now();
+		double end;
+		Snapshot_t *snapshot;
 
-		//calculate the gravity forces with every other particle and sum them up
-		for (size_t j = 0; j < NB_PARTICLES; j++)
+		TRACE_SCOPE("PhysicsUpdate")
+		{
+			PhysicsUpdate();
+		}
+		if (g_trajectory != NULL)
 		{
-			if (i != j)
+			PROFILER_SCOPE(g_physics_profiler, "trajectory")
 			{
-				tmpForce = gravitational_force(&g_particles[i], &g_particles[j]);
+				trajectory_writer_push(g_trajectory, g_simulation->particles, g_simulation->step);
+			}
+		}
+		end = timer_now();
+		if (end - lastEnergyTime >= ENERGY_INTERVAL)
+		{
+			PROFILER_SCOPE(g_physics_profiler, "energy")
+			{
+				energy = g_simulation->particles->count <= ENERGY_MAX_PARTICLES ? simulation_energy(g_simulation) : NAN;
+			}
+			lastEnergyTime = end;
+		}
+
+		profiler_begin(g_physics_profiler, "snapshot");
+		snapshot = snapshot_buffer_capture(g_snapshots, g_simulation->particles, g_simulation->step, end);
+		profiler_end(g_physics_profiler, "snapshot");
+		profiler_end_frame(g_physics_profiler);
+		snapshot->stepTime = end - start;
+		snapshot->energy = energy;
+		//formatting every timer costs a few microseconds, only done while the overlay shows them
+		if (atomic_load(&g_show_timings))
+		{
+			profiler_format(g_physics_profiler, snapshot->timings, sizeof(snapshot->timings));
+		}
+		else
+		{
+			snapshot->timings[0] = '\0';
+		}
+		snapshot_buffer_publish(g_snapshots);
 
-				old = tmpTotalForce;
-				tmpTotalForce = matrix_add(tmpTotalForce, tmpForce);
+		if (interval > 0)
+		{
+			double wait;
 
-				//cleanup
-				matrix_destroy(old);
-				matrix_destroy(tmpForce);
+			next += interval;
+			wait = next - timer_now();
+			if (wait > 0)
+			{
+				SDL_Delay((Uint32)(wait * 1000));
+			}
+			else if (wait < -interval)
+			{
+				//more than one step late (the steps are too slow for the rate), do not try to catch up
+				next = timer_now();
 			}
 		}
-		//calculate the gravity force with the black hole
-		tmpForce = gravitational_force(&g_particles[i], g_black_hole);
-
-		old = tmpTotalForce;
-		tmpTotalForce = matrix_add(tmpTotalForce, tmpForce); // kg * m/s^2
-
-		//translate force to acceleration
-		Matrix_t *acceleration = matrix_vector2_multiply_double(tmpTotalForce, 1 / g_particles[i].mass); // m/s^2
-		
-		//compute next position and store it to update later
-		Matrix_t *tmp1 = matrix_vector2_multiply_double(g_particles[i].pos, 2); // 2x(tj)
-		Matrix_t *tmp2 = matrix_sub(tmp1, g_particles[i].lastPos); // 2x(tj) - x(tj-1)
-		Matrix_t *tmp3 = matrix_vector2_multiply_double(acceleration, TIME_STEP_SQUARED); // a(tj)*deltaT^2
-		Matrix_t *nextPos = matrix_add(tmp2, tmp3); // 2x(tj) - x(tj-1) + a(tj)*deltaT^2
-
-		nextPositions[i] = nextPos;
-
-		//cleanup
-		matrix_destroy(tmp1);
-		matrix_destroy(tmp2);
-		matrix_destroy(tmp3);
-		matrix_destroy(acceleration);
-		matrix_destroy(tmpForce);
-		matrix_destroy(tmpTotalForce);
-		matrix_destroy(old);
 	}
 
-	//update the position of every particle
-	for (size_t i = 0; i < NB_PARTICLES; i++)
-	{	
-		particle_updatePosition(&g_particles[i], nextPositions[i]);
-		matrix_destroy(nextPositions[i]);
-	}
+	return 0;
 }
 
 /**
- * @brief Render all of the simulation.
+ * @brief Render the last state published by the physics thread.
+ * alpha in [0, 1] interpolates between the state before it (0) and itself (1).
  */
-void Render(SDL_Renderer *renderer)
+void Render(SDL_Renderer *renderer, Snapshot_t *snapshot, double alpha)
 {
-	Matrix_t *size;
-	INITIALISE_MATRIX_VECTOR2(size, 5, 5)
+	SDL_Color white = {255, 255, 255, 255};
+	SDL_Color grey = {100, 100, 100, 128};
 
-	//draw every particles
-	SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-	for (size_t i = 0; i < NB_PARTICLES; i++)
+	//draw every particles in a single batch of sprites
+	SDL_SetRenderDrawColor(renderer, white.r, white.g, white.b, white.a);
+	particle_renderer_begin(g_particle_renderer);
+	for (size_t i = 0; i < snapshot->count; i++)
 	{
-		fill_circle(renderer, matrix_valueOf(g_particles[i].pos, 0, 0) / SCALE, matrix_valueOf(g_particles[i].pos, 0, 1) / SCALE, g_particles[i].mass / SCALE);
-		//SDL_RenderDrawPoint(renderer, matrix_valueOf(g_origin, 0, 0) + matrix_valueOf(g_particles[i].pos, 0, 0) / SCALE, matrix_valueOf(g_origin, 0, 1) +  matrix_valueOf(g_particles[i].pos, 0, 1) / SCALE);
+		double x = snapshot->lastX[i] + (snapshot->x[i] - snapshot->lastX[i]) * alpha;
+		double y = snapshot->lastY[i] + (snapshot->y[i] - snapshot->lastY[i]) * alpha;
+
+		particle_renderer_add_circle(g_particle_renderer, (float)(g_origin.x + x / SCALE), (float)(g_origin.y - y / SCALE), (float)(snapshot->mass[i] / SCALE), white);
 	}
+	particle_renderer_flush(g_particle_renderer, renderer);
 
 	//draw the black hole
-	SDL_SetRenderDrawColor(renderer, 100, 100, 100, 128);
-	fill_circle(renderer, matrix_valueOf(g_black_hole->pos, 0, 0), matrix_valueOf(g_black_hole->pos, 0, 1), 5);
+	SDL_SetRenderDrawColor(renderer, grey.r, grey.g, grey.b, grey.a);
+	particle_renderer_begin(g_particle_renderer);
+	particle_renderer_add_circle(g_particle_renderer, (float)(g_origin.x + g_black_hole.x / SCALE), (float)(g_origin.y - g_black_hole.y / SCALE), 5, grey);
+	particle_renderer_flush(g_particle_renderer, renderer);
 }
 
 int main(int argc, char *argv[])
@@ -178,7 +228,142 @@ int main(int argc, char *argv[])
 	// ----- SDL INITIALIZATION ------
 	int runSDL = 1;
 	SDL_Event event;
-	char fpsBuffer[50];
+	char statsBuffer[STATS_BUFFER_SIZE];
+	char frameTimings[STATS_BUFFER_SIZE / 2];
+	char energyBuffer[32];
+	double fps = 0;
+	Solver_t solver = SOLVER_DIRECT;
+	Integrator_t integrator = INTEGRATOR_VERLET;
+	double theta = QUADTREE_DEFAULT_THETA;
+	int meshSize = PARTICLE_MESH_DEFAULT_SIZE;
+	int blockLevels = 0;
+	double blockEta = BLOCK_STEPS_DEFAULT_ETA;
+	int reorderInterval = SIMULATION_DEFAULT_REORDER_INTERVAL;
+	int threads = 0; //0 : one thread per processor
+	size_t nbParticles = DEFAULT_NB_PARTICLES;
+	const char *load = NULL;
+	const char *trajectoryPath = NULL;
+	const char *profilePrefix = NULL;
+	const char *tracePath = NULL;
+
+	//command line options : -n <particles>, -load <checkpoint>, -checkpoint <file>, -trajectory <file>, -rate <steps per second>, -no-interpolation, -solver direct|barnes-hut|particle-mesh, -integrator verlet|leapfrog|yoshida, -theta <opening angle>, -grid <cells per side>, -block-levels <count>, -eta <accuracy>, -reorder <steps>, -threads <count>, -kernel scalar|avx2|avx512, -precision double|mixed, -profile-csv <prefix>, -trace <file>
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+		{
+			nbParticles = strtoull(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "-rate") == 0 && i + 1 < argc)
+		{
+			g_physics_rate = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-load") == 0 && i + 1 < argc)
+		{
+			load = argv[++i];
+		}
+		else if (strcmp(argv[i], "-checkpoint") == 0 && i + 1 < argc)
+		{
+			g_checkpoint_path = argv[++i];
+		}
+		else if (strcmp(argv[i], "-trajectory") == 0 && i + 1 < argc)
+		{
+			trajectoryPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "-no-interpolation") == 0)
+		{
+			g_interpolate = false;
+		}
+		else if (strcmp(argv[i], "-solver") == 0 && i + 1 < argc)
+		{
+			if (!simulation_solver_from_name(argv[++i], &solver))
+			{
+				fprintf(stderr, "error: unknown solver %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-integrator") == 0 && i + 1 < argc)
+		{
+			if (!simulation_integrator_from_name(argv[++i], &integrator))
+			{
+				fprintf(stderr, "error: unknown integrator %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-theta") == 0 && i + 1 < argc)
+		{
+			theta = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-grid") == 0 && i + 1 < argc)
+		{
+			meshSize = atoi(argv[++i]);
+			if (!particle_mesh_valid_size(meshSize))
+			{
+				fprintf(stderr, "error: the grid size must be a power of 2 between %d and %d\n", PARTICLE_MESH_MIN_SIZE, PARTICLE_MESH_MAX_SIZE);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-block-levels") == 0 && i + 1 < argc)
+		{
+			blockLevels = atoi(argv[++i]);
+			if (blockLevels < 0 || blockLevels > BLOCK_STEPS_MAX_LEVEL)
+			{
+				fprintf(stderr, "error: the block levels must be between 0 and %d\n", BLOCK_STEPS_MAX_LEVEL);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-eta") == 0 && i + 1 < argc)
+		{
+			blockEta = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-reorder") == 0 && i + 1 < argc)
+		{
+			reorderInterval = atoi(argv[++i]);
+			if (reorderInterval < 0)
+			{
+				fprintf(stderr, "error: the steps between two sorts must be 0 or more\n");
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+		{
+			threads = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-kernel") == 0 && i + 1 < argc)
+		{
+			GravityKernel_t kernel;
+
+			i++;
+			if (!gravity_kernel_from_name(argv[i], &kernel) || !gravity_set_kernel(kernel))
+			{
+				fprintf(stderr, "error: kernel %s unknown or not supported by this processor\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-precision") == 0 && i + 1 < argc)
+		{
+			GravityPrecision_t precision;
+
+			if (!gravity_precision_from_name(argv[++i], &precision))
+			{
+				fprintf(stderr, "error: unknown precision %s\n", argv[i]);
+				return 1;
+			}
+			gravity_set_precision(precision);
+		}
+		else if (strcmp(argv[i], "-profile-csv") == 0 && i + 1 < argc)
+		{
+			profilePrefix = argv[++i];
+		}
+		else if (strcmp(argv[i], "-trace") == 0 && i + 1 < argc)
+		{
+			tracePath = argv[++i];
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [-n <particles>] [-load <checkpoint>] [-checkpoint <file saved with F5>] [-trajectory <file>] [-rate <physics steps per second, 0 : unlimited>] [-no-interpolation] [-solver direct|barnes-hut|particle-mesh] [-integrator verlet|leapfrog|yoshida] [-theta <opening angle>] [-grid <cells per side>] [-block-levels <0 : off, up to %d>] [-eta <accuracy of the block time steps>] [-reorder <steps between two Morton sorts of the particles, 0 : never>] [-threads <count>] [-kernel scalar|avx2|avx512] [-precision double|mixed] [-profile-csv <prefix of the <prefix>_frames.csv and <prefix>_steps.csv timings>] [-trace <trace.json written on exit, needs a build with -DTRACING>]\n", argv[0], BLOCK_STEPS_MAX_LEVEL);
+			return 1;
+		}
+	}
 
 	if (SDL_Init(SDL_INIT_VIDEO) != 0)
 	{
@@ -212,7 +397,7 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 	//init text variables
-	TTF_Font *arial = TTF_OpenFont("./resources/fonts/arial.ttf", 9); //this opens a font style and sets a size
+	TTF_Font *arial = TTF_OpenFont("./resources/fonts/arial.ttf", STATS_FONT_SIZE); //this opens a font style and sets a size
 
 	if (arial == NULL)
 	{
@@ -227,47 +412,120 @@ int main(int argc, char *argv[])
 
 	SDL_Color white = {255, 255, 255, 255}; //color in rgba format
 
-	SDL_Rect fps_rect = {.x = 0, .y = 0, .w = 30, .h = 50};
+	//glyphs of the statistics rasterized once, the font is not needed anymore after that
+	g_text_overlay = text_overlay_initializer(ren, arial, white);
+	TTF_CloseFont(arial);
+	if (g_text_overlay == NULL)
+	{
+		printf("Glyph atlas Error: %s\n", SDL_GetError());
+		SDL_DestroyRenderer(ren);
+		SDL_DestroyWindow(win);
+		TTF_Quit();
+		SDL_Quit();
+		return 1;
+	}
 
 	//init origin
-	g_origin = matrix_initializer(1, 2);
-	*matrix_addressOf(g_origin, 0, 0) = (double)g_window_width / 2.0;
-	*matrix_addressOf(g_origin, 0, 1) = (double)g_window_height / 2.0;
-
-	//set random seed
-	srand(time(NULL));
+	g_origin = vector2((double)g_window_width / 2.0, (double)g_window_height / 2.0);
 
-	//init black hole
-	Matrix_t *zero;
-	INITIALISE_MATRIX_VECTOR2(zero, 0, 0)
-	g_black_hole = particle_initializer(zero, zero, pow(10, 11));
-
-	//init particles
-	g_particles = (Particle_t *)calloc(NB_PARTICLES, sizeof(Particle_t));
-	for (size_t i = 0; i < NB_PARTICLES; i++)
+	//init the simulation, restored from a checkpoint or with a black hole at the origin and particles on circular orbits around it (random seed)
+	if (load != NULL)
 	{
-		Matrix_t *tmpInitial, *tmpPos;
-
-		INITIALISE_MATRIX_VECTOR2(tmpInitial, rand() % (MAX_BOUND_X - MIN_BOUND_X) + MIN_BOUND_X, rand() % (MAX_BOUND_Y - MIN_BOUND_Y) + MIN_BOUND_Y)
-
-		//initialise particle with no speed
-		g_particles[i] = *particle_initializer(zero, tmpInitial, rand() % (MAX_MASS - MIN_MASS) + MIN_MASS);
+		g_simulation = checkpoint_load(load, threads);
+		if (g_simulation == NULL)
+		{
+			text_overlay_destroy(g_text_overlay);
+			SDL_DestroyRenderer(ren);
+			SDL_DestroyWindow(win);
+			TTF_Quit();
+			SDL_Quit();
+			return 1;
+		}
+		printf("Restored %s (step %llu, %zu particles)\n", load, g_simulation->step, g_simulation->particles->count);
+	}
+	else
+	{
+		g_simulation = simulation_initializer(threads);
+		g_simulation->solver = solver;
+		g_simulation->integrator = integrator;
+		g_simulation->theta = theta;
+		g_simulation->meshSize = meshSize;
+		g_simulation->blockLevels = blockLevels;
+		g_simulation->blockEta = blockEta;
+		g_simulation->timeStep = TIME_STEP;
+		simulation_populate(g_simulation, nbParticles, MAX_BOUND_X, MAX_BOUND_Y, time(NULL));
+	}
+	g_simulation->reorderInterval = reorderInterval;
+	//tiles of the direct sums tuned for this processor and the selected kernel
+	gravity_autotune();
+	printf("Physics running on %d threads, %s direct sum kernel in %s precision (tiles of %zu sources x %zu targets, pair blocks of %zu)\n",
+		   thread_pool_thread_count(g_simulation->pool), gravity_kernel_name(gravity_get_kernel()), gravity_precision_name(gravity_get_precision()),
+		   gravity_get_tiles(gravity_get_precision()).sourceBlock, gravity_get_tiles(gravity_get_precision()).targetBlock, gravity_get_pair_block());
+
+	g_particle_renderer = particle_renderer_initializer(ren);
+	if (g_particle_renderer == NULL)
+	{
+		printf("Particle atlas Error: %s\n", SDL_GetError());
+		simulation_destroy(g_simulation);
+		text_overlay_destroy(g_text_overlay);
+		SDL_DestroyRenderer(ren);
+		SDL_DestroyWindow(win);
+		TTF_Quit();
+		SDL_Quit();
+		return 1;
+	}
 
-		//compute the orbital velocity and angle needed for a circular orbit
-		Matrix_t *force = gravitational_force(&g_particles[i], g_black_hole);
-		Matrix_t *acceleration = matrix_vector2_multiply_double(force, 1 / g_particles[i].mass);
+	//a trajectory that cannot be created is not fatal, the simulation just runs without recording it
+	if (trajectoryPath != NULL)
+	{
+		g_trajectory = trajectory_writer_initializer(trajectoryPath, TRAJECTORY_DEFAULT_QUANTUM, TRAJECTORY_DEFAULT_SLOTS, true);
+	}
 
-		double orbitalVelocity = sqrt(matrix_vector2_magnitude(acceleration) * matrix_vector2_distance(tmpInitial, g_black_hole->pos));
-		double angle = atan2(matrix_valueOf(tmpInitial, 0, 1), matrix_valueOf(tmpInitial, 0, 0)) + E_PI / 2;
+	//one profiler per thread, the timings are only written to csv files when asked (a file that cannot be created is not fatal)
+	g_frame_profiler = profiler_initializer();
+	g_physics_profiler = profiler_initializer();
+	g_simulation->profiler = g_physics_profiler;
+	if (profilePrefix != NULL)
+	{
+		char path[1024];
 
-		INITIALISE_MATRIX_VECTOR2(tmpPos, matrix_valueOf(tmpInitial, 0, 0) + orbitalVelocity * TIME_STEP * cos(angle), matrix_valueOf(tmpInitial, 0, 1) + orbitalVelocity * TIME_STEP * sin(angle))
+		snprintf(path, sizeof(path), "%s_frames.csv", profilePrefix);
+		profiler_open_csv(g_frame_profiler, path);
+		snprintf(path, sizeof(path), "%s_steps.csv", profilePrefix);
+		profiler_open_csv(g_physics_profiler, path);
+	}
 
-		particle_updatePosition(&g_particles[i], tmpPos);
+	//every thread records its events from now on, they are written once the physics thread is stopped
+	if (tracePath != NULL && trace_start())
+	{
+		TRACE_THREAD_NAME("render");
+	}
 
-		matrix_destroy(force);
-		matrix_destroy(acceleration);
-		matrix_destroy(tmpPos);
-		matrix_destroy(tmpPos);
+	//publish the initial state, then step the simulation on its own thread
+	g_snapshots = snapshot_buffer_initializer();
+	snapshot_buffer_capture(g_snapshots, g_simulation->particles, g_simulation->step, timer_now());
+	snapshot_buffer_publish(g_snapshots);
+	g_black_hole = g_simulation->blackHole->pos;
+	g_physics_running = true;
+	SDL_Thread *physicsThread = SDL_CreateThread(PhysicsThread, "physics", NULL);
+	if (physicsThread == NULL)
+	{
+		printf("SDL_CreateThread Error: %s\n", SDL_GetError());
+		if (g_trajectory != NULL)
+		{
+			trajectory_writer_destroy(g_trajectory);
+		}
+		profiler_destroy(g_frame_profiler);
+		profiler_destroy(g_physics_profiler);
+		snapshot_buffer_destroy(g_snapshots);
+		particle_renderer_destroy(g_particle_renderer);
+		text_overlay_destroy(g_text_overlay);
+		simulation_destroy(g_simulation);
+		SDL_DestroyRenderer(ren);
+		SDL_DestroyWindow(win);
+		TTF_Quit();
+		SDL_Quit();
+		return 1;
 	}
 
 	printf("Start main SDL loop\n");
@@ -279,6 +537,7 @@ int main(int argc, char *argv[])
 		deltaTime = (double)((NOW - LAST) / (double)SDL_GetPerformanceFrequency());
 
 		//Events handling
+		profiler_begin(g_frame_profiler, "events");
 		while (SDL_PollEvent(&event) > 0)
 		{
 			switch (event.type)
@@ -293,8 +552,7 @@ int main(int argc, char *argv[])
 					g_window_width = event.window.data1;
 					g_window_height = event.window.data2;
 
-					*matrix_addressOf(g_origin, 0, 0) = (double)g_window_width / 2.0;
-					*matrix_addressOf(g_origin, 0, 1) = (double)g_window_height / 2.0;
+					g_origin = vector2((double)g_window_width / 2.0, (double)g_window_height / 2.0);
 
 					SDL_SetWindowSize(win, g_window_width, g_window_height);
 					break;
@@ -303,11 +561,54 @@ int main(int argc, char *argv[])
 					break;
 				}
 				break;
+			case SDL_MOUSEBUTTONDOWN:
+			case SDL_MOUSEBUTTONUP:
+				g_mouse_x = (int)((event.button.x - g_origin.x) * SCALE);
+				g_mouse_y = (int)((g_origin.y - event.button.y) * SCALE);
+				if (event.button.button == SDL_BUTTON_LEFT)
+				{
+					g_press_left = event.type == SDL_MOUSEBUTTONDOWN;
+				}
+				else if (event.button.button == SDL_BUTTON_RIGHT)
+				{
+					g_press_right = event.type == SDL_MOUSEBUTTONDOWN;
+				}
+				break;
+			case SDL_MOUSEMOTION:
+				g_mouse_x = (int)((event.motion.x - g_origin.x) * SCALE);
+				g_mouse_y = (int)((g_origin.y - event.motion.y) * SCALE);
+				break;
+			case SDL_KEYDOWN:
+				//B cycles through the solvers (direct sum, Barnes-Hut, particle-mesh)
+				//(the switch is done by the physics thread between two steps)
+				if (event.key.keysym.sym == SDLK_b)
+				{
+					g_toggle_solver = true;
+				}
+				//F5 saves a checkpoint (done by the physics thread between two steps)
+				else if (event.key.keysym.sym == SDLK_F5)
+				{
+					g_save_checkpoint = true;
+				}
+				//I switches the interpolation between the two last physics states on and off
+				else if (event.key.keysym.sym == SDLK_i)
+				{
+					g_interpolate = !g_interpolate;
+					printf("Interpolation : %s\n", g_interpolate ? "on" : "off");
+				}
+				//P shows the time taken by every phase of the frames and of the physics steps
+				else if (event.key.keysym.sym == SDLK_p)
+				{
+					g_show_timings = !g_show_timings;
+				}
+				break;
 			default:
 				//printf("Event not processed\n");
 				break;
 			}
 		}
+		profiler_end(g_frame_profiler, "events");
+		profiler_begin(g_frame_profiler, "render");
 
 		// Set render color to black
 		SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
@@ -315,38 +616,85 @@ int main(int argc, char *argv[])
 		// Clear the entire screen to our selected color.
 		SDL_RenderClear(ren);
 
-		//FPS counter
-		snprintf(fpsBuffer, 50, "%.0f", (1.0 / deltaTime));
-		SDL_Surface *fpsMessage = TTF_RenderText_Solid(arial, fpsBuffer, white);
+		//render the last state published by the physics thread
+		Snapshot_t *snapshot = snapshot_buffer_acquire(g_snapshots);
+		double alpha = 1;
+		if (g_interpolate && g_physics_rate > 0)
+		{
+			alpha = fmin(fmax((timer_now() - snapshot->time) * g_physics_rate, 0), 1);
+		}
+		TRACE_SCOPE("Render")
+		{
+			Render(ren, snapshot, alpha);
+		}
+		profiler_end(g_frame_profiler, "render");
 
-		SDL_Texture *fpsTexture = SDL_CreateTextureFromSurface(ren, fpsMessage);
-		SDL_FreeSurface(fpsMessage);
+		//statistics overlay (fps smoothed over about 20 frames)
+		profiler_begin(g_frame_profiler, "overlay");
+		if (deltaTime > 0)
+		{
+			fps = fps == 0 ? 1.0 / deltaTime : fps * 0.95 + 0.05 / deltaTime;
+		}
+		snprintf(energyBuffer, sizeof(energyBuffer), isnan(snapshot->energy) ? "-" : "%.6e", snapshot->energy);
+		snprintf(statsBuffer, sizeof(statsBuffer), "FPS %.0f\nStep %.2f ms\nN %zu\nEnergy %s",
+				 fps, snapshot->stepTime * 1000, snapshot->count, energyBuffer);
+		if (g_show_timings)
+		{
+			//average / 99th percentile over the last PROFILER_WINDOW frames and steps
+			profiler_format(g_frame_profiler, frameTimings, sizeof(frameTimings));
+			snprintf(statsBuffer + strlen(statsBuffer), sizeof(statsBuffer) - strlen(statsBuffer), "\n\nFrame (avg / p99)\n%s\n\nPhysics (avg / p99)\n%s",
+					 frameTimings, snapshot->timings);
+		}
+		text_overlay_draw(g_text_overlay, ren, 4, 4, statsBuffer);
+		profiler_end(g_frame_profiler, "overlay");
 
-		SDL_RenderCopy(ren, fpsTexture, NULL, &fps_rect);
+		PROFILER_SCOPE(g_frame_profiler, "present") TRACE_SCOPE("SDL_RenderPresent")
+		{
+			SDL_RenderPresent(ren);
+		}
+		profiler_end_frame(g_frame_profiler);
+	}
+
+	//stop the physics thread before freeing what it uses
+	g_physics_running = false;
+	SDL_WaitThread(physicsThread, NULL);
 
-		//Physics and render
-		PhysicsUpdate();
-		Render(ren);
+	if (tracePath != NULL)
+	{
+		trace_stop();
+		if (trace_write(tracePath))
+		{
+			printf("Trace written to %s\n", tracePath);
+		}
+		trace_free();
+	}
 
-		SDL_RenderPresent(ren);
-		SDL_DestroyTexture(fpsTexture);
+	if (g_trajectory != NULL)
+	{
+		if (trajectory_writer_close(g_trajectory))
+		{
+			printf("Trajectory : %llu frames written to %s (%llu dropped)\n", g_trajectory->framesWritten, trajectoryPath, g_trajectory->framesDropped);
+		}
+		else
+		{
+			fprintf(stderr, "error: could not write %s\n", trajectoryPath);
+		}
+		trajectory_writer_destroy(g_trajectory);
 	}
+	profiler_destroy(g_frame_profiler);
+	profiler_destroy(g_physics_profiler);
 
-	// SDL Cleanup
-	TTF_CloseFont(arial);
+	// SDL Cleanup (the textures before their renderer)
+	particle_renderer_destroy(g_particle_renderer);
+	text_overlay_destroy(g_text_overlay);
 	SDL_DestroyRenderer(ren);
 	SDL_DestroyWindow(win);
 	TTF_Quit();
 	SDL_Quit();
 
 	// app variables cleanup
-	matrix_destroy(g_origin);
-	matrix_destroy(zero);
-	particle_destroy(g_black_hole);
-	for (size_t i = 0; i < NB_PARTICLES; i++)
-	{
-		particle_destroy(&g_particles[i]);
-	}
+	snapshot_buffer_destroy(g_snapshots);
+	simulation_destroy(g_simulation);
 
 	return 0;
 }
\ No newline at end of file
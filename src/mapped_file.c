@@ -0,0 +1,88 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Read-only files mapped in memory with private copy-on-write pages (writes change the memory, never the file)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "mapped_file.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile_t *mapped_file_open(const char *path)
+{
+	MappedFile_t *file = (MappedFile_t *)calloc(1, sizeof(MappedFile_t));
+#ifdef _WIN32
+	LARGE_INTEGER size;
+
+	file->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file->file, &size) || size.QuadPart == 0)
+	{
+		if (file->file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(file->file);
+		}
+		free(file);
+		return NULL;
+	}
+	file->size = (size_t)size.QuadPart;
+
+	file->mapping = CreateFileMappingA(file->file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	file->data = file->mapping != NULL ? MapViewOfFile(file->mapping, FILE_MAP_COPY, 0, 0, 0) : NULL;
+	if (file->data == NULL)
+	{
+		if (file->mapping != NULL)
+		{
+			CloseHandle(file->mapping);
+		}
+		CloseHandle(file->file);
+		free(file);
+		return NULL;
+	}
+#else
+	struct stat info;
+	int descriptor = open(path, O_RDONLY);
+
+	if (descriptor < 0 || fstat(descriptor, &info) != 0 || info.st_size == 0)
+	{
+		if (descriptor >= 0)
+		{
+			close(descriptor);
+		}
+		free(file);
+		return NULL;
+	}
+	file->size = (size_t)info.st_size;
+
+	file->data = mmap(NULL, file->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0);
+	//the mapping stays valid once the descriptor is closed
+	close(descriptor);
+	if (file->data == MAP_FAILED)
+	{
+		free(file);
+		return NULL;
+	}
+#endif
+
+	return file;
+}
+
+void mapped_file_close(void *file)
+{
+	MappedFile_t *mapped = (MappedFile_t *)file;
+
+#ifdef _WIN32
+	UnmapViewOfFile(mapped->data);
+	CloseHandle(mapped->mapping);
+	CloseHandle(mapped->file);
+#else
+	munmap(mapped->data, mapped->size);
+#endif
+	free(mapped);
+}
@@ -0,0 +1,30 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Read-only files mapped in memory with private copy-on-write pages (writes change the memory, never the file)
+*/
+#include <stddef.h>
+
+#pragma once
+
+//Mapped file
+typedef struct MappedFile_s {
+	void *data;
+	size_t size;
+#ifdef _WIN32
+	void *file; //HANDLE of the file and of the mapping
+	void *mapping;
+#endif
+} MappedFile_t;
+
+/**
+ * @brief Map a whole file in memory. The pages are loaded on first access, and copied on first write.
+ * @return MappedFile_t* NULL if the file could not be opened or mapped (or is empty)
+ */
+MappedFile_t *mapped_file_open(const char *path);
+
+/**
+ * @brief Unmap the file and free the MappedFile_t (takes a void* so that it can be used as the release function of borrowed arrays).
+ * @return void
+ */
+void mapped_file_close(void *file);
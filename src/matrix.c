@@ -9,20 +9,161 @@ Description : Matrix structure and functions (values are stored in a single arra
 #include "tests.h"
 #include <string.h>
 #include <float.h>
+#include <time.h>
 #include <math.h>
 
+//arena used by the matrices created by each thread
+static _Thread_local MatrixArena_t *t_arena;
+
+/*
+ * Allocate a block able to hold size bytes.
+ */
+static MatrixArenaBlock_t *matrix_arena_block(size_t size)
+{
+	MatrixArenaBlock_t *block = (MatrixArenaBlock_t *)malloc(sizeof(MatrixArenaBlock_t) + size);
+
+	if (block == NULL)
+	{
+		fprintf(stderr, "error: could not allocate %zu bytes for a matrix arena\n", size);
+		exit(1);
+	}
+	block->size = size;
+	block->used = 0;
+	block->next = NULL;
+
+	return block;
+}
+
+/*
+ * Bump allocation of size bytes (aligned on a double) from the last block of the arena, a new block is added when it is full.
+ */
+static void *matrix_arena_allocate(MatrixArena_t *arena, size_t size)
+{
+	MatrixArenaBlock_t *block = arena->first;
+	void *memory;
+
+	size = (size + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+	while (block->next != NULL)
+	{
+		block = block->next;
+	}
+	if (block->size - block->used < size)
+	{
+		block->next = matrix_arena_block(size > 2 * block->size ? size : 2 * block->size);
+		block = block->next;
+	}
+
+	memory = (unsigned char *)block->data + block->used;
+	block->used += size;
+	if (matrix_arena_used(arena) > arena->peak)
+	{
+		arena->peak = matrix_arena_used(arena);
+	}
+
+	return memory;
+}
+
 Matrix_t *matrix_initializer(int size_x, int size_y)
 {
-	Matrix_t *matrix = (Matrix_t *)malloc(sizeof(Matrix_t));
+	Matrix_t *matrix;
+
+	if (t_arena != NULL)
+	{
+		//the values right after the struct
+		matrix = (Matrix_t *)matrix_arena_allocate(t_arena, sizeof(Matrix_t) + size_x * size_y * sizeof(double));
+		matrix->values = (double *)(matrix + 1);
+		memset(matrix->values, 0, size_x * size_y * sizeof(double));
+		matrix->arena = t_arena;
+	}
+	else
+	{
+		matrix = (Matrix_t *)malloc(sizeof(Matrix_t));
+		matrix->values = (double *)calloc(size_x * size_y, sizeof(double));
+		matrix->arena = NULL;
+	}
 
 	matrix->size_x = size_x;
 	matrix->size_y = size_y;
 
-	matrix->values = (double *)calloc(size_x * size_y, sizeof(double));
+	return matrix;
+}
+
+Matrix_t matrix_wrap(double *values, int size_x, int size_y)
+{
+	Matrix_t matrix = {size_x, size_y, values, NULL};
 
 	return matrix;
 }
 
+MatrixArena_t *matrix_arena_initializer(size_t size)
+{
+	MatrixArena_t *arena = (MatrixArena_t *)calloc(1, sizeof(MatrixArena_t));
+
+	arena->first = matrix_arena_block(size);
+
+	return arena;
+}
+
+MatrixArena_t *matrix_arena_use(MatrixArena_t *arena)
+{
+	MatrixArena_t *previous = t_arena;
+
+	t_arena = arena;
+
+	return previous;
+}
+
+void matrix_arena_reset(MatrixArena_t *arena)
+{
+	if (arena->first->next != NULL)
+	{
+		//the last frame did not fit : one block for all of it from now on
+		size_t size = matrix_arena_used(arena);
+		MatrixArenaBlock_t *block = arena->first;
+
+		while (block != NULL)
+		{
+			MatrixArenaBlock_t *next = block->next;
+
+			free(block);
+			block = next;
+		}
+		arena->first = matrix_arena_block(size);
+	}
+	arena->first->used = 0;
+	arena->resets++;
+}
+
+size_t matrix_arena_used(MatrixArena_t *arena)
+{
+	size_t used = 0;
+
+	for (MatrixArenaBlock_t *block = arena->first; block != NULL; block = block->next)
+	{
+		used += block->used;
+	}
+
+	return used;
+}
+
+void matrix_arena_destroy(MatrixArena_t *arena)
+{
+	MatrixArenaBlock_t *block = arena->first;
+
+	if (t_arena == arena)
+	{
+		t_arena = NULL;
+	}
+	while (block != NULL)
+	{
+		MatrixArenaBlock_t *next = block->next;
+
+		free(block);
+		block = next;
+	}
+	free(arena);
+}
+
 bool matrix_equals(Matrix_t *one, Matrix_t *two)
 {
 	if (one->size_x == two->size_x && one->size_y == two->size_y)
@@ -74,21 +215,66 @@ Matrix_t *matrix_clone(Matrix_t *matrix)
 	return newMatrix;
 }
 
-Matrix_t *matrix_add(Matrix_t *one, Matrix_t *two)
+/*
+ * Check that result has the given size, print an error naming the operation otherwise.
+ */
+static bool matrix_check_result(Matrix_t *result, int size_x, int size_y, const char *operation)
 {
-	Matrix_t *newMatrix;
+	if (result->size_x != size_x || result->size_y != size_y)
+	{
+		fprintf(stderr, "error: %s : the result is a %dx%d matrix instead of %dx%d\n", operation, result->size_x, result->size_y, size_x, size_y);
+		return false;
+	}
+	return true;
+}
 
-	if (one->size_x == two->size_x && one->size_y == two->size_y)
+bool matrix_add_into(Matrix_t *result, Matrix_t *one, Matrix_t *two)
+{
+	if (one->size_x != two->size_x || one->size_y != two->size_y)
+	{
+		fprintf(stderr, "error: cannot add a %dx%d matrix and a %dx%d one\n", one->size_x, one->size_y, two->size_x, two->size_y);
+		return false;
+	}
+	if (!matrix_check_result(result, one->size_x, one->size_y, "matrix_add_into"))
+	{
+		return false;
+	}
+
+	//value by value : result can be one of the operands
+	for (int i = 0; i < one->size_x * one->size_y; i++)
 	{
-		newMatrix = matrix_initializer(one->size_x, one->size_y);
+		result->values[i] = one->values[i] + two->values[i];
+	}
+	return true;
+}
 
-		for (int y = 0; y < one->size_y; y++)
-		{
-			for (int x = 0; x < one->size_x; x++)
-			{
-				*matrix_addressOf(newMatrix, x, y) = matrix_valueOf(one, x, y) + matrix_valueOf(two, x, y);
-			}
-		}
+bool matrix_sub_into(Matrix_t *result, Matrix_t *one, Matrix_t *two)
+{
+	if (one->size_x != two->size_x || one->size_y != two->size_y)
+	{
+		fprintf(stderr, "error: cannot subtract a %dx%d matrix from a %dx%d one\n", two->size_x, two->size_y, one->size_x, one->size_y);
+		return false;
+	}
+	if (!matrix_check_result(result, one->size_x, one->size_y, "matrix_sub_into"))
+	{
+		return false;
+	}
+
+	for (int i = 0; i < one->size_x * one->size_y; i++)
+	{
+		result->values[i] = one->values[i] - two->values[i];
+	}
+	return true;
+}
+
+Matrix_t *matrix_add(Matrix_t *one, Matrix_t *two)
+{
+	Matrix_t *newMatrix = matrix_initializer(one->size_x, one->size_y);
+
+	if (!matrix_add_into(newMatrix, one, two))
+	{
+		matrix_destroy(newMatrix);
+		return NULL;
 	}
 
 	return newMatrix;
@@ -96,19 +282,12 @@ Matrix_t *matrix_add(Matrix_t *one, Matrix_t *two)
 
 Matrix_t *matrix_sub(Matrix_t *one, Matrix_t *two)
 {
-	Matrix_t *newMatrix;
+	Matrix_t *newMatrix = matrix_initializer(one->size_x, one->size_y);
 
-	if (one->size_x == two->size_x && one->size_y == two->size_y)
+	if (!matrix_sub_into(newMatrix, one, two))
 	{
-		newMatrix = matrix_initializer(one->size_x, one->size_y);
-
-		for (int y = 0; y < one->size_y; y++)
-		{
-			for (int x = 0; x < one->size_x; x++)
-			{
-				*matrix_addressOf(newMatrix, x, y) = matrix_valueOf(one, x, y) - matrix_valueOf(two, x, y);
-			}
-		}
+		matrix_destroy(newMatrix);
+		return NULL;
 	}
 
 	return newMatrix;
@@ -146,29 +325,70 @@ double matrix1d_dot_product(Matrix_t *one, Matrix_t *two)
 	return dotProd;
 }
 
-Matrix_t *matrix_multiply(Matrix_t *one, Matrix_t *two)
+bool matrix_multiply_into(Matrix_t *result, Matrix_t *one, Matrix_t *two)
 {
-	Matrix_t *newMatrix;
+	//products of the transformations of the app (3x3 by 3x3 or 1x3) are computed on the stack
+	double stackValues[MATRIX_STACK_VALUES];
+	double *values;
 	double dotProduct;
 
-	if (one->size_x == two->size_y)
+	if (one->size_x != two->size_y)
+	{
+		fprintf(stderr, "error: cannot multiply a %dx%d matrix by a %dx%d one\n", one->size_x, one->size_y, two->size_x, two->size_y);
+		return false;
+	}
+	if (!matrix_check_result(result, two->size_x, one->size_y, "matrix_multiply_into"))
 	{
-		newMatrix = matrix_initializer(two->size_x, one->size_y);
+		return false;
+	}
 
-		for (int y = 0; y < newMatrix->size_y; y++)
+	//every value of the operands is needed until the end : written to the result at once when it is one of them
+	values = result->size_x * result->size_y <= MATRIX_STACK_VALUES ? stackValues : (double *)malloc(result->size_x * result->size_y * sizeof(double));
+	for (int y = 0; y < result->size_y; y++)
+	{
+		for (int x = 0; x < result->size_x; x++)
 		{
-			for (int x = 0; x < newMatrix->size_x; x++)
-			{
-				dotProduct = 0;
+			dotProduct = 0;
 
-				for (int i = 0; i < one->size_x; i++)
-				{
-					dotProduct += matrix_valueOf(one, i, y) * matrix_valueOf(two, x, i);
-				}
-				*matrix_addressOf(newMatrix, x, y) = dotProduct;
+			for (int i = 0; i < one->size_x; i++)
+			{
+				dotProduct += matrix_valueOf(one, i, y) * matrix_valueOf(two, x, i);
 			}
+			values[y * result->size_x + x] = dotProduct;
 		}
 	}
+	memcpy(result->values, values, result->size_x * result->size_y * sizeof(double));
+	if (values != stackValues)
+	{
+		free(values);
+	}
+
+	return true;
+}
+
+bool matrix_multiply_double_into(Matrix_t *result, Matrix_t *matrix, double number)
+{
+	if (!matrix_check_result(result, matrix->size_x, matrix->size_y, "matrix_multiply_double_into"))
+	{
+		return false;
+	}
+
+	for (int i = 0; i < matrix->size_x * matrix->size_y; i++)
+	{
+		result->values[i] = matrix->values[i] * number;
+	}
+	return true;
+}
+
+Matrix_t *matrix_multiply(Matrix_t *one, Matrix_t *two)
+{
+	Matrix_t *newMatrix = matrix_initializer(two->size_x, one->size_y);
+
+	if (!matrix_multiply_into(newMatrix, one, two))
+	{
+		matrix_destroy(newMatrix);
+		return NULL;
+	}
 
 	return newMatrix;
 }
@@ -177,13 +397,7 @@ Matrix_t *matrix_multiply_double(Matrix_t *matrix, double number)
 {
 	Matrix_t *newMatrix = matrix_initializer(matrix->size_x, matrix->size_y);
 
-	for (int y = 0; y < matrix->size_y; y++)
-	{
-		for (int x = 0; x < matrix->size_x; x++)
-		{
-			*matrix_addressOf(newMatrix, x, y) = matrix_valueOf(matrix, x, y) * number;
-		}
-	}
+	matrix_multiply_double_into(newMatrix, matrix, number);
 
 	return newMatrix;
 }
@@ -209,13 +423,48 @@ double matrix_vector2_distance(Matrix_t *one, Matrix_t *two)
 	return distance;
 }
 
+bool matrix_vector2_multiply_double_into(Matrix_t *result, Matrix_t *matrix, double scalar)
+{
+	if (matrix->size_x != 1 || matrix->size_y != 3)
+	{
+		fprintf(stderr, "error: a %dx%d matrix is not a 2d vector\n", matrix->size_x, matrix->size_y);
+		return false;
+	}
+	if (!matrix_check_result(result, 1, 3, "matrix_vector2_multiply_double_into"))
+	{
+		return false;
+	}
+
+	*matrix_addressOf(result, 0, 0) = matrix_valueOf(matrix, 0, 0) * scalar;
+	*matrix_addressOf(result, 0, 1) = matrix_valueOf(matrix, 0, 1) * scalar;
+	*matrix_addressOf(result, 0, 2) = 1;
+
+	return true;
+}
+
 Matrix_t *matrix_vector2_multiply_double(Matrix_t *matrix, double scalar)
 {
-	Matrix_t *newMatrix = matrix_initializer(matrix->size_x, matrix->size_y);
+	Matrix_t *newMatrix = matrix_initializer(1, 3);
+
+	if (!matrix_vector2_multiply_double_into(newMatrix, matrix, scalar))
+	{
+		matrix_destroy(newMatrix);
+		return NULL;
+	}
+
+	return newMatrix;
+}
+
+Vector2_t matrix_to_vector2(Matrix_t *matrix)
+{
+	return vector2(matrix_valueOf(matrix, 0, 0), matrix_valueOf(matrix, 0, 1));
+}
+
+Matrix_t *matrix_from_vector2(Vector2_t vector)
+{
+	Matrix_t *newMatrix;
 
-	*matrix_addressOf(newMatrix, 0, 0) = matrix_valueOf(matrix, 0, 0) * scalar;
-	*matrix_addressOf(newMatrix, 0, 1) = matrix_valueOf(matrix, 0, 1) * scalar;
-	*matrix_addressOf(newMatrix, 0, 2) = 1;
+	INITIALISE_MATRIX_VECTOR2(newMatrix, vector.x, vector.y)
 
 	return newMatrix;
 }
@@ -264,6 +513,11 @@ char *matrix_toString(Matrix_t *matrix)
 
 void matrix_destroy(Matrix_t *matrix)
 {
+	//freed with the rest of its arena
+	if (matrix->arena != NULL)
+	{
+		return;
+	}
 	free(matrix->values);
 	free(matrix);
 }
@@ -424,6 +678,60 @@ matrix_destroy(multi);
 matrix_destroy(result);
 END_TEST()
 
+START_TEST("In place and into the caller's matrices")
+Matrix_t *one, *two, *wrong;
+double values[4];
+Matrix_t result = matrix_wrap(values, 2, 2);
+
+one = matrix_initializer(2, 2);
+*matrix_addressOf(one, 0, 0) = 1;
+*matrix_addressOf(one, 1, 0) = 2;
+*matrix_addressOf(one, 0, 1) = 3;
+*matrix_addressOf(one, 1, 1) = 4;
+two = matrix_clone(one);
+wrong = matrix_initializer(3, 2);
+
+ASSERT(matrix_add_into(&result, one, two));
+ASSERT(matrix_valueOf(&result, 1, 1) == 8);
+ASSERT(matrix_sub_into(&result, &result, one));
+ASSERT(matrix_equals(&result, one));
+ASSERT(matrix_multiply_double_into(&result, one, 2));
+ASSERT(matrix_valueOf(&result, 0, 1) == 6);
+
+//one * one in place : |7,10| |15,22|
+ASSERT(matrix_multiply_into(one, one, two));
+ASSERT(matrix_valueOf(one, 0, 0) == 7 && matrix_valueOf(one, 1, 0) == 10);
+ASSERT(matrix_valueOf(one, 0, 1) == 15 && matrix_valueOf(one, 1, 1) == 22);
+
+//mismatching sizes are reported and leave the result untouched
+ASSERT(!matrix_add_into(&result, one, wrong));
+ASSERT(!matrix_sub_into(wrong, one, two));
+ASSERT(!matrix_multiply_into(&result, wrong, one));
+ASSERT(!matrix_multiply_double_into(wrong, one, 2));
+ASSERT(!matrix_vector2_multiply_double_into(&result, one, 2));
+ASSERT(matrix_valueOf(&result, 0, 1) == 6);
+ASSERT(matrix_add(one, wrong) == NULL);
+ASSERT(matrix_multiply(wrong, one) == NULL);
+
+matrix_destroy(one);
+matrix_destroy(two);
+matrix_destroy(wrong);
+END_TEST()
+
+START_TEST("2d vector into the caller's matrix")
+double values[3] = {0, 0, 1};
+Matrix_t vector = matrix_wrap(values, 1, 3);
+Matrix_t *scaled;
+
+*matrix_addressOf(&vector, 0, 0) = 3;
+*matrix_addressOf(&vector, 0, 1) = 4;
+ASSERT(matrix_vector2_multiply_double_into(&vector, &vector, 2));
+ASSERT(values[0] == 6 && values[1] == 8);
+scaled = matrix_vector2_multiply_double(&vector, 0.5);
+ASSERT(matrix_valueOf(scaled, 0, 0) == 3 && matrix_valueOf(scaled, 0, 1) == 4);
+matrix_destroy(scaled);
+END_TEST()
+
 START_TEST("ToString")
 Matrix_t *one = matrix_initializer(2, 2);
 *matrix_addressOf(one, 0, 0) = 1;
@@ -436,6 +744,102 @@ ASSERT(strcmp(toString, "|1.000000,2.000000|\n|3.000000,4.000000|\n") == 0);
 free(toString);
 matrix_destroy(one);
 END_TEST()
+
+START_TEST("Vector2")
+Vector2_t one = vector2(3, 4);
+Vector2_t two = vector2(1, -2);
+Matrix_t *matrix = matrix_from_vector2(one);
+
+ASSERT(vector2_add(one, two).x == 4 && vector2_add(one, two).y == 2);
+ASSERT(vector2_sub(one, two).x == 2 && vector2_sub(one, two).y == 6);
+ASSERT(vector2_multiply_double(one, 2).y == 8);
+ASSERT(vector2_dot_product(one, two) == -5);
+ASSERT(vector2_magnitude(one) == 5);
+ASSERT(vector2_distance(one, one) == 0);
+ASSERT(matrix_vector2_magnitude(matrix) == 5);
+ASSERT(matrix_to_vector2(matrix).y == 4);
+
+matrix_destroy(matrix);
+END_TEST()
+
+START_TEST("Arena")
+MatrixArena_t *arena = matrix_arena_initializer(1024);
+Matrix_t *one, *two, *product, *heap;
+
+ASSERT(matrix_arena_use(arena) == NULL);
+one = matrix_identity(3);
+two = matrix_clone(one);
+*matrix_addressOf(two, 2, 0) = 5;
+product = matrix_multiply(one, two);
+//struct and values in one piece, one after the other
+ASSERT(one->arena == arena && one->values == (double *)(one + 1));
+ASSERT((unsigned char *)two == (unsigned char *)one + sizeof(Matrix_t) + 9 * sizeof(double));
+ASSERT(matrix_equals(product, two));
+ASSERT(matrix_arena_used(arena) == 3 * (sizeof(Matrix_t) + 9 * sizeof(double)));
+matrix_destroy(product); //nothing to do
+ASSERT(matrix_arena_use(NULL) == arena);
+heap = matrix_initializer(1, 3);
+ASSERT(heap->arena == NULL);
+matrix_destroy(heap);
+
+//the same memory after a reset, zeroed again
+matrix_arena_reset(arena);
+matrix_arena_use(arena);
+two = matrix_initializer(3, 3);
+ASSERT((void *)two == (void *)one && matrix_valueOf(two, 0, 0) == 0);
+
+//more than the first block : more blocks for this frame, a single bigger one after the reset
+for (int i = 0; i < 100; i++)
+{
+	INITIALISE_MATRIX_VECTOR2(one, i, i)
+	ASSERT(matrix_valueOf(one, 0, 2) == 1);
+}
+ASSERT(arena->first->next != NULL);
+ASSERT(matrix_arena_used(arena) == arena->peak);
+matrix_arena_reset(arena);
+ASSERT(arena->first->next == NULL && arena->first->size >= arena->peak);
+ASSERT(matrix_arena_used(arena) == 0 && arena->resets == 2);
+
+matrix_arena_destroy(arena);
+ASSERT(matrix_arena_use(NULL) == NULL);
+END_TEST()
+
+START_TEST("Arena against the heap")
+MatrixArena_t *arena = matrix_arena_initializer(MATRIX_ARENA_DEFAULT_SIZE);
+Matrix_t *transform = matrix_identity(3);
+double seconds[2];
+
+//a frame of 100 transformed points, 10000 frames on the heap then in the arena
+for (int run = 0; run < 2; run++)
+{
+	clock_t start = clock();
+
+	matrix_arena_use(run == 1 ? arena : NULL);
+	for (int frame = 0; frame < 10000; frame++)
+	{
+		for (int i = 0; i < 100; i++)
+		{
+			Matrix_t *point, *moved;
+
+			INITIALISE_MATRIX_VECTOR2(point, i, frame)
+			moved = matrix_multiply(transform, point);
+			matrix_destroy(point);
+			matrix_destroy(moved);
+		}
+		if (run == 1)
+		{
+			matrix_arena_reset(arena);
+		}
+	}
+	seconds[run] = (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+matrix_arena_use(NULL);
+printf("1M temporary matrices : %.1f ms on the heap, %.1f ms in an arena\n", seconds[0] * 1000, seconds[1] * 1000);
+ASSERT(arena->first->next == NULL);
+
+matrix_destroy(transform);
+matrix_arena_destroy(arena);
+END_TEST()
 /* End the overall test suite */
 END_TESTS()
 #endif
\ No newline at end of file
@@ -3,7 +3,9 @@ Author : Yannis Perrin
 Date : 20.03.2019
 Description : Matrix structure (values are stored in a single array, representing a 2d one)
 */
+#include <stddef.h>
 #include <stdbool.h>
+#include <math.h>
 
 #pragma once
 
@@ -19,19 +21,140 @@ Description : Matrix structure (values are stored in a single array, representin
 	*matrix_addressOf(var, 0, 1) = (y);      \
 	*matrix_addressOf(var, 0, 2) = 1;
 
+//default size of the first block of a MatrixArena_t (about 1000 matrices of 1 x 3)
+#define MATRIX_ARENA_DEFAULT_SIZE (64 * 1024)
+//values of a product computed on the stack by matrix_multiply_into (larger ones use a temporary heap buffer)
+#define MATRIX_STACK_VALUES 16
+
 //Matrix
 typedef struct Matrix_s {
 	int size_x;
 	int size_y;
 	double *values;
+	struct MatrixArena_s *arena; //arena the matrix was allocated from (matrix_destroy does nothing), NULL : allocated on the heap
 } Matrix_t;
 
+//Block of an arena
+typedef struct MatrixArenaBlock_s {
+	size_t size;
+	size_t used;
+	struct MatrixArenaBlock_s *next; //blocks added when the first one is full, merged into it by the next reset
+	double data[];
+} MatrixArenaBlock_t;
+
+//Arena of matrices (opt-in) : while an arena is used by a thread, the matrices it creates are bump-allocated in the arena, the struct
+//and the values in one piece. They do not have to be destroyed, they are all freed at once by matrix_arena_reset (ex: at the end of a frame).
+typedef struct MatrixArena_s {
+	MatrixArenaBlock_t *first;
+	size_t peak; //most bytes used between two resets
+	unsigned long long resets;
+} MatrixArena_t;
+
+//2d vector passed by value (nothing to allocate or free), used instead of a Matrix_t(1, 3) in the hot paths
+typedef struct Vector2_s {
+	double x;
+	double y;
+} Vector2_t;
+
+/**
+ * @brief Create a Vector2_t from its coordinates.
+ * @return Vector2_t
+ */
+static inline Vector2_t vector2(double x, double y)
+{
+	Vector2_t vector = {x, y};
+	return vector;
+}
+/**
+ * @brief Add two Vector2_t together.
+ * @return Vector2_t
+ */
+static inline Vector2_t vector2_add(Vector2_t one, Vector2_t two)
+{
+	return vector2(one.x + two.x, one.y + two.y);
+}
+/**
+ * @brief Subtract a Vector2_t with another (one - two).
+ * @return Vector2_t
+ */
+static inline Vector2_t vector2_sub(Vector2_t one, Vector2_t two)
+{
+	return vector2(one.x - two.x, one.y - two.y);
+}
+/**
+ * @brief Multiply a Vector2_t by a scalar number.
+ * @return Vector2_t
+ */
+static inline Vector2_t vector2_multiply_double(Vector2_t vector, double scalar)
+{
+	return vector2(vector.x * scalar, vector.y * scalar);
+}
+/**
+ * @brief Compute the dot product (scalar product) of two Vector2_t.
+ * @return double
+ */
+static inline double vector2_dot_product(Vector2_t one, Vector2_t two)
+{
+	return one.x * two.x + one.y * two.y;
+}
+/**
+ * @brief Compute the magnitude of a Vector2_t.
+ * @return double
+ */
+static inline double vector2_magnitude(Vector2_t vector)
+{
+	return sqrt(vector2_dot_product(vector, vector));
+}
+/**
+ * @brief Compute the distance between two Vector2_t.
+ * @return double
+ */
+static inline double vector2_distance(Vector2_t one, Vector2_t two)
+{
+	return vector2_magnitude(vector2_sub(two, one));
+}
+
 /**
  * @brief Initializes a new Matrix_t instance at the specified Matrix_t pointer.
+ * Allocated from the arena used by the calling thread if any (see matrix_arena_use), on the heap otherwise.
  * @return void
  */
 Matrix_t *matrix_initializer(int size_x, int size_y);
 
+/**
+ * @brief Get a Matrix_t using the given values (size_x * size_y of them, owned by the caller, ex: an array on the stack)
+ * as the result or an operand of the _into functions. Must not be destroyed.
+ * @return Matrix_t
+ */
+Matrix_t matrix_wrap(double *values, int size_x, int size_y);
+
+/**
+ * @brief Initializes a new empty MatrixArena_t with a first block of size bytes (it grows when a frame needs more).
+ * @return MatrixArena_t*
+ */
+MatrixArena_t *matrix_arena_initializer(size_t size);
+/**
+ * @brief Allocate the next matrices created by the calling thread from arena (NULL : from the heap again).
+ * @return MatrixArena_t* the arena used before
+ */
+MatrixArena_t *matrix_arena_use(MatrixArena_t *arena);
+/**
+ * @brief Free every matrix allocated from the arena at once, they must not be used anymore.
+ * The blocks added since the last reset are merged into one block big enough for all of them.
+ * @return void
+ */
+void matrix_arena_reset(MatrixArena_t *arena);
+/**
+ * @brief Get the number of bytes allocated from the arena since the last reset.
+ * @return size_t
+ */
+size_t matrix_arena_used(MatrixArena_t *arena);
+/**
+ * @brief Free the blocks and the MatrixArena_t (the calling thread stops using it).
+ * @return void
+ */
+void matrix_arena_destroy(MatrixArena_t *arena);
+
 /**
  * @brief Get the pointer to one of the values of the Matrix_t.
  * @return double*
@@ -55,14 +178,24 @@ bool matrix_equals(Matrix_t *one, Matrix_t *two);
 Matrix_t *matrix_clone(Matrix_t *matrix);
 /**
  * @brief Add two Matrix_t together.
- * @return Matrix_t
+ * @return Matrix_t NULL if they do not have the same size (a message is printed on stderr)
  */
 Matrix_t *matrix_add(Matrix_t *one, Matrix_t *two);
 /**
  * @brief Subtract a Matrix_t with another (one - two).
- * @return Matrix_t
+ * @return Matrix_t NULL if they do not have the same size (a message is printed on stderr)
  */
 Matrix_t *matrix_sub(Matrix_t *one, Matrix_t *two);
+/**
+ * @brief Add two Matrix_t together into result (of their size, it can be one of them).
+ * @return bool false if the sizes do not match, result is not changed (a message is printed on stderr)
+ */
+bool matrix_add_into(Matrix_t *result, Matrix_t *one, Matrix_t *two);
+/**
+ * @brief Subtract a Matrix_t with another (one - two) into result (of their size, it can be one of them).
+ * @return bool false if the sizes do not match, result is not changed (a message is printed on stderr)
+ */
+bool matrix_sub_into(Matrix_t *result, Matrix_t *one, Matrix_t *two);
 
 
 /**
@@ -87,21 +220,48 @@ double matrix_vector2_magnitude(Matrix_t *matrix);
 double matrix_vector2_distance(Matrix_t *one, Matrix_t *two);
 /**
  * @brief Multiply a Matrix_t representing a 2d vector (Matrix_t of size : (1, 3)) by a scalar number.
- * @return double
+ * @return Matrix_t NULL if matrix is not a 2d vector (a message is printed on stderr)
  */
 Matrix_t *matrix_vector2_multiply_double(Matrix_t *matrix, double scalar);
+/**
+ * @brief Multiply a Matrix_t representing a 2d vector (Matrix_t of size : (1, 3)) by a scalar number into result (a 2d vector, it can be matrix).
+ * @return bool false if matrix or result is not a 2d vector, result is not changed (a message is printed on stderr)
+ */
+bool matrix_vector2_multiply_double_into(Matrix_t *result, Matrix_t *matrix, double scalar);
 
 
 /**
- * @brief Compute the vector product of two Matrix_t (has to have the same size).
- * @return Matrix_t
+ * @brief Compute the product of two Matrix_t (one * two, the width of one has to be the height of two).
+ * @return Matrix_t NULL if the sizes do not match (a message is printed on stderr)
  */
 Matrix_t *matrix_multiply(Matrix_t *one, Matrix_t *two);
 /**
- * @brief Compute the vector product of two Matrix_t (has to have the same size).
+ * @brief Multiply every value of a Matrix_t by a scalar number.
  * @return Matrix_t
  */
 Matrix_t *matrix_multiply_double(Matrix_t *matrix, double number);
+/**
+ * @brief Compute the product of two Matrix_t into result (width of two x height of one, it can be one of them : in place transformation).
+ * @return bool false if the sizes do not match, result is not changed (a message is printed on stderr)
+ */
+bool matrix_multiply_into(Matrix_t *result, Matrix_t *one, Matrix_t *two);
+/**
+ * @brief Multiply every value of a Matrix_t by a scalar number into result (of its size, it can be matrix).
+ * @return bool false if result does not have the size of matrix, it is not changed (a message is printed on stderr)
+ */
+bool matrix_multiply_double_into(Matrix_t *result, Matrix_t *matrix, double number);
+
+/**
+ * @brief Get the Vector2_t stored in a Matrix_t representing a 2d vector (Matrix_t of size : (1, 3)).
+ * @return Vector2_t
+ */
+Vector2_t matrix_to_vector2(Matrix_t *matrix);
+/**
+ * @brief Create a Matrix_t representing a 2d vector (Matrix_t of size : (1, 3)) from a Vector2_t.
+ * do not forget to free after use
+ * @return Matrix_t
+ */
+Matrix_t *matrix_from_vector2(Vector2_t vector);
 
 /**
  * @brief Get the identity matrix of a given size.
@@ -114,4 +274,8 @@ Matrix_t *matrix_identity(int size);
  */
 char* matrix_toString(Matrix_t *matrix);
 
+/**
+ * @brief Free a Matrix_t allocated on the heap (does nothing for one allocated from an arena).
+ * @return void
+ */
 void matrix_destroy(Matrix_t *matrix);
\ No newline at end of file
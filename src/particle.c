@@ -3,25 +3,21 @@
 #include <stdlib.h>
 #include "tests.h"
 
-Particle_t *particle_initializer(Matrix_t *lastPos, Matrix_t *pos, double mass)
+Particle_t *particle_initializer(Vector2_t lastPos, Vector2_t pos, double mass)
 {
     Particle_t *newParticle = (Particle_t *)malloc(sizeof(Particle_t));
 
-    newParticle->pos = matrix_clone(pos);
-    newParticle->lastPos = matrix_clone(lastPos);
+    newParticle->pos = pos;
+    newParticle->lastPos = lastPos;
     newParticle->mass = mass;
 
     return newParticle;
 }
 
-void particle_updatePosition(Particle_t *particle, Matrix_t *position)
+void particle_updatePosition(Particle_t *particle, Vector2_t position)
 {
-    Matrix_t *old = particle->lastPos;
-
     particle->lastPos = particle->pos;
-    particle->pos = matrix_clone(position);
-
-    matrix_destroy(old);
+    particle->pos = position;
 }
 
 void particle_changeMass(Particle_t *particle, double massChange)
@@ -31,76 +27,61 @@ void particle_changeMass(Particle_t *particle, double massChange)
 
 void particle_print(Particle_t *particle)
 {
-    char *tmp = matrix_toString(particle->lastPos);
 	printf("Last position : \n");
-    printf(tmp);
-    free(tmp);
-    tmp = matrix_toString(particle->pos);
+    printf("|%f|\n|%f|\n", particle->lastPos.x, particle->lastPos.y);
     printf("Position : \n");
-    printf(tmp);
-    free(tmp);
+    printf("|%f|\n|%f|\n", particle->pos.x, particle->pos.y);
     printf("Mass : %lf\n", particle->mass);
 }
 
 void particle_destroy(Particle_t *particle)
 {
-    matrix_destroy(particle->lastPos);
-    matrix_destroy(particle->pos);
+    free(particle);
 }
 
-Matrix_t *gravitational_force(Particle_t *first, Particle_t *second)
+Vector2_t gravitational_force(Particle_t *first, Particle_t *second)
 {
-	Matrix_t *diff, *diffMult;
-	double mult;
+	Vector2_t diff;
+	double distance;
 
 	//calculations
-	diff = matrix_sub(second->pos, first->pos);
-	mult = G * ((first->mass * second->mass) / pow(matrix_vector2_magnitude(diff), 3));
-	diffMult = matrix_vector2_multiply_double(diff, mult);
-
-	//cleanup
-	matrix_destroy(diff);
+	diff = vector2_sub(second->pos, first->pos);
+	distance = vector2_magnitude(diff);
 
-	return diffMult;
+	return vector2_multiply_double(diff, G * ((first->mass * second->mass) / (distance * distance * distance)));
 }
 
-//Build test : (mingw32-)gcc -o test.exe matrix.c -DUNIT_TESTS_P
+//Build test : (mingw32-)gcc -o test.exe particle.c -DUNIT_TESTS_P
 #ifdef UNIT_TESTS_P
 /* Start the overall test suite */
 START_TESTS()
 START_TEST("Initialization")
-Particle_t *g_particles = (Particle_t *)calloc(100, sizeof(Particle_t));
-Matrix_t *pos, *speed;
-INITIALISE_MATRIX_VECTOR2(pos, 10, 10)
-INITIALISE_MATRIX_VECTOR2(speed, 3, 3)
-Particle_t *newParticle = particle_initializer(pos, speed, 10);
+Particle_t *newParticle = particle_initializer(vector2(10, 10), vector2(3, 3), 10);
 
-char *tmpStr = "";
+ASSERT(newParticle->lastPos.x == 10);
+ASSERT(newParticle->pos.y == 3);
+ASSERT(newParticle->mass == 10);
 
-for (size_t i = 0; i < 100; i++)
-{
-    Matrix_t *tmpPos, *tmpSpeed;
-    INITIALISE_MATRIX_VECTOR2(tmpPos, rand() % 50, rand() % 50)
-    INITIALISE_MATRIX_VECTOR2(tmpSpeed, 0, 0)
-    g_particles[i] = *particle_initializer(tmpPos, tmpSpeed, (rand() % 10) + 1);
-}
-for (size_t i = 0; i < 100; i++)
-{
-    tmpStr = matrix_toString(g_particles[i].pos);
-    printf("%s", tmpStr);
-    free(tmpStr);
-
-    tmpStr = matrix_toString(g_particles[i].speed);
-    printf("%s", tmpStr);
-    printf("%f\n", g_particles[i].mass);
-    free(tmpStr);
-}
+particle_updatePosition(newParticle, vector2(4, 5));
 
-ASSERT(true);
+ASSERT(newParticle->lastPos.x == 3);
+ASSERT(newParticle->pos.y == 5);
 
 particle_destroy(newParticle);
-matrix_destroy(pos);
-matrix_destroy(speed);
+END_TEST()
+
+START_TEST("Gravitational force")
+Particle_t *one = particle_initializer(vector2(0, 0), vector2(0, 0), 2);
+Particle_t *two = particle_initializer(vector2(0, 2), vector2(0, 2), 3);
+Vector2_t force = gravitational_force(one, two);
+
+SET_EPSILON(1e-20)
+ASSERT(force.x == 0);
+ASSERT_EQUALS_FLOAT(force.y, G * 6 / 4);
+ASSERT_EQUALS_FLOAT(gravitational_force(two, one).y, -G * 6 / 4);
+
+particle_destroy(one);
+particle_destroy(two);
 END_TEST()
 /* End the overall test suite */
 END_TESTS()
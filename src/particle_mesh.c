@@ -0,0 +1,431 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Particle-mesh gravity solver, O(N + M log M) for N particles on a grid of M cells, meant for very large numbers of particles
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "particle.h"
+#include "particle_system.h"
+#include "thread_pool.h"
+#include "particle_mesh.h"
+#include "tests.h"
+
+#define E_PI 3.1415926535897932384626433832795028841971693993751058209749445923078164062
+//integral of 1 / r over a square of side 1 from its center (4 ln(1 + sqrt(2))) : potential of a cell on itself, in cell units
+#define PARTICLE_MESH_SELF_POTENTIAL 3.5254943480781717
+
+bool particle_mesh_valid_size(int size)
+{
+	return size >= PARTICLE_MESH_MIN_SIZE && size <= PARTICLE_MESH_MAX_SIZE && (size & (size - 1)) == 0;
+}
+
+/*
+ * In place radix 2 FFT of n complex values (n is the padded size of the mesh, the twiddle factors come from its tables).
+ * The inverse transform is not divided by n.
+ */
+static void particle_mesh_fft(ParticleMesh_t *mesh, double *real, double *imaginary, bool inverse)
+{
+	int n = mesh->paddedSize;
+
+	//bit reversal permutation
+	for (int i = 1, j = 0; i < n; i++)
+	{
+		int bit = n >> 1;
+
+		for (; j & bit; bit >>= 1)
+		{
+			j ^= bit;
+		}
+		j ^= bit;
+
+		if (i < j)
+		{
+			double swap = real[i];
+			real[i] = real[j];
+			real[j] = swap;
+			swap = imaginary[i];
+			imaginary[i] = imaginary[j];
+			imaginary[j] = swap;
+		}
+	}
+
+	//butterflies
+	for (int length = 2; length <= n; length <<= 1)
+	{
+		int half = length / 2;
+		int stride = n / length;
+
+		for (int start = 0; start < n; start += length)
+		{
+			for (int k = 0; k < half; k++)
+			{
+				double wr = mesh->cosTable[k * stride];
+				double wi = inverse ? mesh->sinTable[k * stride] : -mesh->sinTable[k * stride];
+				int a = start + k;
+				int b = a + half;
+				double tr = real[b] * wr - imaginary[b] * wi;
+				double ti = real[b] * wi + imaginary[b] * wr;
+
+				real[b] = real[a] - tr;
+				imaginary[b] = imaginary[a] - ti;
+				real[a] += tr;
+				imaginary[a] += ti;
+			}
+		}
+	}
+}
+
+//arguments of the tasks
+typedef struct ParticleMeshContext_s {
+	ParticleMesh_t *mesh;
+	ParticleSystem_t *system;
+	double *real; //grid transformed by the row and column tasks
+	double *imaginary;
+	bool inverse;
+} ParticleMeshContext_t;
+
+static void particle_mesh_rows_task(void *context, int thread, size_t begin, size_t end)
+{
+	ParticleMeshContext_t *arguments = (ParticleMeshContext_t *)context;
+	size_t n = arguments->mesh->paddedSize;
+
+	(void)thread;
+	for (size_t row = begin; row < end; row++)
+	{
+		particle_mesh_fft(arguments->mesh, &arguments->real[row * n], &arguments->imaginary[row * n], arguments->inverse);
+	}
+}
+
+/*
+ * Columns are copied to the scratch column of the thread, transformed contiguously and copied back.
+ */
+static void particle_mesh_columns_task(void *context, int thread, size_t begin, size_t end)
+{
+	ParticleMeshContext_t *arguments = (ParticleMeshContext_t *)context;
+	size_t n = arguments->mesh->paddedSize;
+	double *real = &arguments->mesh->scratch[2 * n * thread];
+	double *imaginary = real + n;
+
+	for (size_t column = begin; column < end; column++)
+	{
+		for (size_t row = 0; row < n; row++)
+		{
+			real[row] = arguments->real[row * n + column];
+			imaginary[row] = arguments->imaginary[row * n + column];
+		}
+		particle_mesh_fft(arguments->mesh, real, imaginary, arguments->inverse);
+		for (size_t row = 0; row < n; row++)
+		{
+			arguments->real[row * n + column] = real[row];
+			arguments->imaginary[row * n + column] = imaginary[row];
+		}
+	}
+}
+
+/*
+ * Product of the transform of the masses with the transform of the kernel (convolution).
+ */
+static void particle_mesh_multiply_task(void *context, int thread, size_t begin, size_t end)
+{
+	ParticleMesh_t *mesh = ((ParticleMeshContext_t *)context)->mesh;
+	size_t n = mesh->paddedSize;
+
+	(void)thread;
+	for (size_t i = begin * n; i < end * n; i++)
+	{
+		double real = mesh->real[i] * mesh->kernelReal[i] - mesh->imaginary[i] * mesh->kernelImaginary[i];
+		double imaginary = mesh->real[i] * mesh->kernelImaginary[i] + mesh->imaginary[i] * mesh->kernelReal[i];
+
+		mesh->real[i] = real;
+		mesh->imaginary[i] = imaginary;
+	}
+}
+
+/*
+ * Acceleration at the center of the cells of rows [begin, end) : minus the gradient of the potential, by central differences
+ * (one sided on the border of the grid).
+ */
+static void particle_mesh_gradient_task(void *context, int thread, size_t begin, size_t end)
+{
+	ParticleMesh_t *mesh = ((ParticleMeshContext_t *)context)->mesh;
+	int size = mesh->size;
+	size_t n = mesh->paddedSize;
+	//potential = -G / cellSize * convolution / n^2 (the inverse FFT is not normalized)
+	double scale = G / (mesh->cellSize * mesh->cellSize * (double)n * (double)n);
+
+	(void)thread;
+	for (size_t row = begin; row < end; row++)
+	{
+		const double *potential = &mesh->real[row * n];
+		const double *below = &mesh->real[(row > 0 ? row - 1 : row) * n];
+		const double *above = &mesh->real[(row + 1 < (size_t)size ? row + 1 : row) * n];
+		double rowScale = row > 0 && row + 1 < (size_t)size ? scale / 2 : scale;
+
+		for (int column = 0; column < size; column++)
+		{
+			int left = column > 0 ? column - 1 : column;
+			int right = column + 1 < size ? column + 1 : column;
+
+			mesh->ax[row * size + column] = (potential[right] - potential[left]) * (right - left == 2 ? scale / 2 : scale);
+			mesh->ay[row * size + column] = (above[column] - below[column]) * rowScale;
+		}
+	}
+}
+
+/*
+ * Position of a particle in the grid : cell (column, row) of its lower left neighbor center and its offset (tx, ty) in [0, 1) from it.
+ */
+static void particle_mesh_locate(ParticleMesh_t *mesh, double x, double y, int *column, int *row, double *tx, double *ty)
+{
+	double fx = (x - mesh->originX) / mesh->cellSize;
+	double fy = (y - mesh->originY) / mesh->cellSize;
+
+	*column = (int)fx;
+	*row = (int)fy;
+	*tx = fx - *column;
+	*ty = fy - *row;
+}
+
+/*
+ * Cloud-in-cell interpolation of the acceleration grid at the particles [begin, end).
+ */
+static void particle_mesh_interpolate_task(void *context, int thread, size_t begin, size_t end)
+{
+	ParticleMeshContext_t *arguments = (ParticleMeshContext_t *)context;
+	ParticleMesh_t *mesh = arguments->mesh;
+	ParticleSystem_t *system = arguments->system;
+	int size = mesh->size;
+
+	(void)thread;
+	for (size_t i = begin; i < end; i++)
+	{
+		int column, row;
+		double tx, ty;
+		size_t cell;
+
+		if (system->mass[i] == 0)
+		{
+			system->ax[i] = 0;
+			system->ay[i] = 0;
+			continue;
+		}
+
+		particle_mesh_locate(mesh, system->x[i], system->y[i], &column, &row, &tx, &ty);
+		cell = (size_t)row * size + column;
+		system->ax[i] = (1 - ty) * ((1 - tx) * mesh->ax[cell] + tx * mesh->ax[cell + 1]) + ty * ((1 - tx) * mesh->ax[cell + size] + tx * mesh->ax[cell + size + 1]);
+		system->ay[i] = (1 - ty) * ((1 - tx) * mesh->ay[cell] + tx * mesh->ay[cell + 1]) + ty * ((1 - tx) * mesh->ay[cell + size] + tx * mesh->ay[cell + size + 1]);
+	}
+}
+
+/*
+ * 2D FFT of a padded grid whose rows from rowCount are 0 (their transform along x is 0 too, they are skipped).
+ */
+static void particle_mesh_forward(ParticleMesh_t *mesh, double *real, double *imaginary, size_t rowCount, ThreadPool_t *pool)
+{
+	ParticleMeshContext_t context = {mesh, NULL, real, imaginary, false};
+
+	thread_pool_parallel_for(pool, rowCount, particle_mesh_rows_task, &context);
+	thread_pool_parallel_for(pool, mesh->paddedSize, particle_mesh_columns_task, &context);
+}
+
+ParticleMesh_t *particle_mesh_initializer(int size)
+{
+	ParticleMesh_t *mesh;
+	size_t n = 2 * (size_t)size;
+
+	if (!particle_mesh_valid_size(size))
+	{
+		return NULL;
+	}
+
+	mesh = (ParticleMesh_t *)malloc(sizeof(ParticleMesh_t));
+	mesh->size = size;
+	mesh->paddedSize = (int)n;
+	mesh->originX = 0;
+	mesh->originY = 0;
+	mesh->cellSize = 1;
+	mesh->real = (double *)malloc(n * n * sizeof(double));
+	mesh->imaginary = (double *)malloc(n * n * sizeof(double));
+	mesh->kernelReal = (double *)malloc(n * n * sizeof(double));
+	mesh->kernelImaginary = (double *)calloc(n * n, sizeof(double));
+	mesh->cosTable = (double *)malloc(n / 2 * sizeof(double));
+	mesh->sinTable = (double *)malloc(n / 2 * sizeof(double));
+	mesh->ax = (double *)malloc((size_t)size * size * sizeof(double));
+	mesh->ay = (double *)malloc((size_t)size * size * sizeof(double));
+	mesh->scratchThreads = 1;
+	mesh->scratch = (double *)malloc(2 * n * sizeof(double));
+
+	for (size_t k = 0; k < n / 2; k++)
+	{
+		mesh->cosTable[k] = cos(2 * E_PI * k / n);
+		mesh->sinTable[k] = sin(2 * E_PI * k / n);
+	}
+
+	//Green's function 1 / r for the offsets -(size - 1) to size - 1 between two cells, negative offsets wrap around the padded grid
+	for (size_t row = 0; row < n; row++)
+	{
+		double dy = row < (size_t)size ? (double)row : (double)row - n;
+
+		for (size_t column = 0; column < n; column++)
+		{
+			double dx = column < (size_t)size ? (double)column : (double)column - n;
+
+			mesh->kernelReal[row * n + column] = row == 0 && column == 0 ? PARTICLE_MESH_SELF_POTENTIAL : 1 / hypot(dx, dy);
+		}
+	}
+	particle_mesh_forward(mesh, mesh->kernelReal, mesh->kernelImaginary, n, NULL);
+
+	return mesh;
+}
+
+void particle_mesh_accelerations(ParticleMesh_t *mesh, ParticleSystem_t *system, ThreadPool_t *pool)
+{
+	ParticleMeshContext_t context = {mesh, system, mesh->real, mesh->imaginary, false};
+	int threadCount = thread_pool_thread_count(pool);
+	size_t n = mesh->paddedSize;
+	double minX, maxX, minY, maxY;
+	double extent;
+
+	if (threadCount > mesh->scratchThreads)
+	{
+		mesh->scratchThreads = threadCount;
+		mesh->scratch = (double *)realloc(mesh->scratch, 2 * n * threadCount * sizeof(double));
+	}
+
+	//the grid covers the bounding square of the particles (free slots of the system are skipped) with a margin of one cell on every side
+	particle_system_bounds(system, 0, system->count, &minX, &minY, &maxX, &maxY);
+	extent = fmax(maxX - minX, maxY - minY);
+	mesh->cellSize = extent > 0 ? extent * (1 + 1e-9) / (mesh->size - 3) : 1;
+	mesh->originX = (minX + maxX) / 2 - mesh->cellSize * (mesh->size - 1) / 2;
+	mesh->originY = (minY + maxY) / 2 - mesh->cellSize * (mesh->size - 1) / 2;
+
+	//cloud-in-cell assignment of the masses to the 4 closest cell centers (serial, the cells of neighbor particles overlap)
+	memset(mesh->real, 0, n * n * sizeof(double));
+	memset(mesh->imaginary, 0, n * n * sizeof(double));
+	for (size_t i = 0; i < system->count; i++)
+	{
+		int column, row;
+		double tx, ty;
+		double mass = system->mass[i];
+		double *cell;
+
+		if (mass == 0)
+		{
+			continue;
+		}
+
+		particle_mesh_locate(mesh, system->x[i], system->y[i], &column, &row, &tx, &ty);
+		cell = &mesh->real[row * n + column];
+		cell[0] += mass * (1 - tx) * (1 - ty);
+		cell[1] += mass * tx * (1 - ty);
+		cell[n] += mass * (1 - tx) * ty;
+		cell[n + 1] += mass * tx * ty;
+	}
+
+	//convolution with the Green's function : forward FFT, product, inverse FFT (only the rows covering the particles are needed)
+	particle_mesh_forward(mesh, mesh->real, mesh->imaginary, mesh->size, pool);
+	thread_pool_parallel_for(pool, n, particle_mesh_multiply_task, &context);
+	context.inverse = true;
+	thread_pool_parallel_for(pool, n, particle_mesh_columns_task, &context);
+	thread_pool_parallel_for(pool, mesh->size, particle_mesh_rows_task, &context);
+
+	thread_pool_parallel_for(pool, mesh->size, particle_mesh_gradient_task, &context);
+	thread_pool_parallel_for(pool, system->count, particle_mesh_interpolate_task, &context);
+}
+
+void particle_mesh_destroy(ParticleMesh_t *mesh)
+{
+	free(mesh->real);
+	free(mesh->imaginary);
+	free(mesh->kernelReal);
+	free(mesh->kernelImaginary);
+	free(mesh->cosTable);
+	free(mesh->sinTable);
+	free(mesh->ax);
+	free(mesh->ay);
+	free(mesh->scratch);
+	free(mesh);
+}
+
+//Build test : (mingw32-)gcc -o test.exe particle_mesh.c particle_system.c particle.c thread_pool.c gravity.c timer.c -lpthread -DUNIT_TESTS_PM
+#ifdef UNIT_TESTS_PM
+/* Start the overall test suite */
+START_TESTS()
+START_TEST("Force between two distant particles")
+ParticleMesh_t *mesh = particle_mesh_initializer(128);
+ParticleSystem_t *system = particle_system_initializer(2);
+double expected = G * 3 / (1000.0 * 1000.0);
+
+ASSERT(particle_mesh_initializer(100) == NULL);
+//1000 apart : about 125 cells of 8
+particle_system_add(system, 0, 0, 0, 0, 2);
+particle_system_add(system, 1000, 0, 1000, 0, 3);
+particle_mesh_accelerations(mesh, system, NULL);
+
+ASSERT_LESSTHAN(fabs(system->ax[0] - expected) / expected, 0.01);
+ASSERT_LESSTHAN(fabs(system->ay[0]) / expected, 0.01);
+ASSERT_LESSTHAN(fabs(system->ax[1] + expected * 2 / 3) / expected, 0.01);
+
+particle_system_destroy(system);
+particle_mesh_destroy(mesh);
+END_TEST()
+
+START_TEST("Same force between two clusters as the direct sum, same result with threads")
+ParticleMesh_t *mesh = particle_mesh_initializer(256);
+ParticleSystem_t *system = particle_system_initializer(2000);
+ThreadPool_t *pool = thread_pool_initializer(4);
+double *directX = (double *)malloc(2000 * sizeof(double));
+double *directY = (double *)malloc(2000 * sizeof(double));
+double *serialX = (double *)malloc(2000 * sizeof(double));
+double directForceX = 0, directForceY = 0, forceX = 0, forceY = 0;
+bool same = true;
+
+//two clusters 3000 apart : the force of one on the other (sum of the forces on its particles, the internal ones cancel out)
+//is resolved by the grid, unlike the forces between close particles
+srand(7);
+for (size_t i = 0; i < 2000; i++)
+{
+	double angle = rand() / (RAND_MAX + 1.0) * 2 * E_PI;
+	double radius = sqrt(rand() / (RAND_MAX + 1.0)) * 300;
+	double x = radius * cos(angle) + (i % 2 == 0 ? -1500 : 1500);
+	double y = radius * sin(angle);
+
+	particle_system_add(system, x, y, x, y, rand() % 10 + 1);
+}
+
+particle_system_accelerations_direct(system, NULL);
+memcpy(directX, system->ax, 2000 * sizeof(double));
+memcpy(directY, system->ay, 2000 * sizeof(double));
+
+particle_mesh_accelerations(mesh, system, NULL);
+memcpy(serialX, system->ax, 2000 * sizeof(double));
+for (size_t i = 0; i < 2000; i += 2)
+{
+	directForceX += system->mass[i] * directX[i];
+	directForceY += system->mass[i] * directY[i];
+	forceX += system->mass[i] * system->ax[i];
+	forceY += system->mass[i] * system->ay[i];
+}
+ASSERT_LESSTHAN(fabs(forceX - directForceX) / directForceX, 0.01);
+ASSERT_LESSTHAN(fabs(forceY - directForceY) / directForceX, 0.01);
+
+particle_mesh_accelerations(mesh, system, pool);
+for (size_t i = 0; i < 2000; i++)
+{
+	same = same && system->ax[i] == serialX[i];
+}
+ASSERT(same);
+
+free(directX);
+free(directY);
+free(serialX);
+thread_pool_destroy(pool);
+particle_system_destroy(system);
+particle_mesh_destroy(mesh);
+END_TEST()
+/* End the overall test suite */
+END_TESTS()
+#endif
@@ -0,0 +1,65 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Particle-mesh gravity solver (cloud-in-cell mass assignment on a grid, potential computed with an FFT)
+*/
+#include <stddef.h>
+#include <stdbool.h>
+#include "particle_system.h"
+#include "thread_pool.h"
+
+#pragma once
+
+//default number of cells per side of the grid
+#define PARTICLE_MESH_DEFAULT_SIZE 256
+//grid sizes accepted (powers of 2 only, the FFT is radix 2)
+#define PARTICLE_MESH_MIN_SIZE 8
+#define PARTICLE_MESH_MAX_SIZE 2048
+
+//Particle mesh
+//The grid covers the bounding square of the particles, it is padded to twice its size with zeros so that the periodic
+//convolution of the FFT gives the potential of isolated masses (no image of the particles on the other side of the grid).
+typedef struct ParticleMesh_s {
+	int size;		  //cells per side of the grid covering the particles
+	int paddedSize;	  //2 * size, cells per side of the FFT grid
+	double originX;	  //position of the center of the cell (0, 0)
+	double originY;
+	double cellSize;
+	double *real;	  //paddedSize^2 grid : masses, then their transform, then the potential
+	double *imaginary;
+	double *kernelReal; //transform of the Green's function 1 / r in cell units, computed once
+	double *kernelImaginary;
+	double *cosTable; //cos and sin of 2 pi k / paddedSize for k < paddedSize / 2
+	double *sinTable;
+	double *ax; //size^2 grids of the acceleration at the center of the cells
+	double *ay;
+	double *scratch; //one column (real and imaginary) per thread for the FFTs along y
+	int scratchThreads;
+} ParticleMesh_t;
+
+/**
+ * @brief Check if a grid size is supported (power of 2 between PARTICLE_MESH_MIN_SIZE and PARTICLE_MESH_MAX_SIZE).
+ * @return bool
+ */
+bool particle_mesh_valid_size(int size);
+
+/**
+ * @brief Initializes a new ParticleMesh_t with a grid of size x size cells (see particle_mesh_valid_size).
+ * @return ParticleMesh_t* NULL if the size is not supported
+ */
+ParticleMesh_t *particle_mesh_initializer(int size);
+
+/**
+ * @brief Compute the acceleration of every particle of the system caused by the others, stores it in ax/ay.
+ * The masses are assigned to the grid with the cloud-in-cell scheme, the potential is the FFT convolution of the grid with -G / r,
+ * and its gradient is interpolated back to the particles with the same weights. Forces between particles closer than a few cells
+ * are smoothed out. The FFTs and the interpolation are split between the threads of the pool (NULL to run on the calling thread only).
+ * @return void
+ */
+void particle_mesh_accelerations(ParticleMesh_t *mesh, ParticleSystem_t *system, ThreadPool_t *pool);
+
+/**
+ * @brief Free the grids and the ParticleMesh_t.
+ * @return void
+ */
+void particle_mesh_destroy(ParticleMesh_t *mesh);
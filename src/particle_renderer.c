@@ -0,0 +1,221 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Batched renderer of the particles, every particle of a frame is a textured quad from a sprite atlas of antialiased disks,
+              all of them are put in one vertex buffer and drawn with a single call
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "particle_renderer.h"
+
+#define PARTICLE_RENDERER_INITIAL_CAPACITY 1024
+//every pixel of the atlas is sampled SUBSAMPLES x SUBSAMPLES times to compute the coverage of the disk (antialiasing)
+#define PARTICLE_RENDERER_SUBSAMPLES 4
+
+#if PARTICLE_RENDERER_GEOMETRY
+/*
+ * Rasterize one white disk per radius side by side in a texture, the alpha is the coverage of the pixel by the disk.
+ */
+static bool particle_renderer_build_atlas(ParticleRenderer_t *renderer, SDL_Renderer *sdlRenderer)
+{
+	int width = 0;
+	int height = 2 * PARTICLE_RENDERER_MAX_RADIUS + 2;
+	int x = 0;
+	Uint32 *pixels;
+
+	//cells of 2 * radius + 2 pixels (1 pixel of transparent border so that the filtering does not bleed between disks)
+	for (int radius = 1; radius <= PARTICLE_RENDERER_MAX_RADIUS; radius++)
+	{
+		width += 2 * radius + 2;
+	}
+
+	pixels = (Uint32 *)calloc(width * height, sizeof(Uint32));
+	for (int radius = 1; radius <= PARTICLE_RENDERER_MAX_RADIUS; radius++)
+	{
+		int size = 2 * radius + 2;
+		double center = size / 2.0;
+
+		for (int py = 0; py < size; py++)
+		{
+			for (int px = 0; px < size; px++)
+			{
+				int covered = 0;
+
+				for (int sy = 0; sy < PARTICLE_RENDERER_SUBSAMPLES; sy++)
+				{
+					for (int sx = 0; sx < PARTICLE_RENDERER_SUBSAMPLES; sx++)
+					{
+						double dx = px + (sx + 0.5) / PARTICLE_RENDERER_SUBSAMPLES - center;
+						double dy = py + (sy + 0.5) / PARTICLE_RENDERER_SUBSAMPLES - center;
+						covered += dx * dx + dy * dy <= radius * radius;
+					}
+				}
+
+				//RGBA32 is r, g, b, a in memory order whatever the endianness
+				Uint8 *pixel = (Uint8 *)&pixels[py * width + x + px];
+				pixel[0] = pixel[1] = pixel[2] = 255;
+				pixel[3] = (Uint8)(255 * covered / (PARTICLE_RENDERER_SUBSAMPLES * PARTICLE_RENDERER_SUBSAMPLES));
+			}
+		}
+
+		renderer->sprites[radius].u0 = (float)x / width;
+		renderer->sprites[radius].v0 = 0;
+		renderer->sprites[radius].u1 = (float)(x + size) / width;
+		renderer->sprites[radius].v1 = (float)size / height;
+		renderer->sprites[radius].halfSize = size / 2.0f;
+		x += size;
+	}
+	//radius 0 (particles smaller than half a pixel) uses the smallest disk
+	renderer->sprites[0] = renderer->sprites[1];
+
+	renderer->atlas = SDL_CreateTexture(sdlRenderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, width, height);
+	if (renderer->atlas == NULL || SDL_UpdateTexture(renderer->atlas, NULL, pixels, width * sizeof(Uint32)) != 0)
+	{
+		free(pixels);
+		return false;
+	}
+	SDL_SetTextureBlendMode(renderer->atlas, SDL_BLENDMODE_BLEND);
+
+	free(pixels);
+	return true;
+}
+#endif
+
+ParticleRenderer_t *particle_renderer_initializer(SDL_Renderer *sdlRenderer)
+{
+	ParticleRenderer_t *renderer = (ParticleRenderer_t *)calloc(1, sizeof(ParticleRenderer_t));
+
+#if PARTICLE_RENDERER_GEOMETRY
+	if (!particle_renderer_build_atlas(renderer, sdlRenderer))
+	{
+		particle_renderer_destroy(renderer);
+		return NULL;
+	}
+#else
+	(void)sdlRenderer;
+#endif
+
+	return renderer;
+}
+
+void particle_renderer_begin(ParticleRenderer_t *renderer)
+{
+#if PARTICLE_RENDERER_GEOMETRY
+	renderer->vertexCount = 0;
+	renderer->indexCount = 0;
+#else
+	renderer->rectCount = 0;
+#endif
+}
+
+#if PARTICLE_RENDERER_GEOMETRY
+/*
+ * Make room for vertexCount more vertices and indexCount more indices.
+ */
+static void particle_renderer_reserve(ParticleRenderer_t *renderer, size_t vertexCount, size_t indexCount)
+{
+	if (renderer->vertexCount + vertexCount > renderer->vertexCapacity)
+	{
+		renderer->vertexCapacity = renderer->vertexCapacity == 0 ? PARTICLE_RENDERER_INITIAL_CAPACITY : renderer->vertexCapacity * 2;
+		while (renderer->vertexCount + vertexCount > renderer->vertexCapacity)
+		{
+			renderer->vertexCapacity *= 2;
+		}
+		renderer->vertices = (SDL_Vertex *)realloc(renderer->vertices, renderer->vertexCapacity * sizeof(SDL_Vertex));
+	}
+	if (renderer->indexCount + indexCount > renderer->indexCapacity)
+	{
+		renderer->indexCapacity = renderer->indexCapacity == 0 ? PARTICLE_RENDERER_INITIAL_CAPACITY : renderer->indexCapacity * 2;
+		while (renderer->indexCount + indexCount > renderer->indexCapacity)
+		{
+			renderer->indexCapacity *= 2;
+		}
+		renderer->indices = (int *)realloc(renderer->indices, renderer->indexCapacity * sizeof(int));
+	}
+}
+#endif
+
+void particle_renderer_add_circle(ParticleRenderer_t *renderer, float x, float y, float radius, SDL_Color color)
+{
+#if PARTICLE_RENDERER_GEOMETRY
+	int rounded = (int)(radius + 0.5f);
+	ParticleSprite_t *sprite = &renderer->sprites[rounded > PARTICLE_RENDERER_MAX_RADIUS ? PARTICLE_RENDERER_MAX_RADIUS : rounded];
+	int first = (int)renderer->vertexCount;
+	SDL_Vertex *vertex;
+	int *index;
+
+	particle_renderer_reserve(renderer, 4, 6);
+	vertex = &renderer->vertices[renderer->vertexCount];
+	index = &renderer->indices[renderer->indexCount];
+
+	//quad centered on the particle : upper left, upper right, lower right, lower left
+	for (int i = 0; i < 4; i++)
+	{
+		bool right = i == 1 || i == 2;
+		bool lower = i >= 2;
+
+		vertex[i].position.x = x + (right ? sprite->halfSize : -sprite->halfSize);
+		vertex[i].position.y = y + (lower ? sprite->halfSize : -sprite->halfSize);
+		vertex[i].color = color;
+		vertex[i].tex_coord.x = right ? sprite->u1 : sprite->u0;
+		vertex[i].tex_coord.y = lower ? sprite->v1 : sprite->v0;
+	}
+	index[0] = first;
+	index[1] = first + 1;
+	index[2] = first + 2;
+	index[3] = first;
+	index[4] = first + 2;
+	index[5] = first + 3;
+
+	renderer->vertexCount += 4;
+	renderer->indexCount += 6;
+#else
+	SDL_Rect *rect;
+
+	(void)color;
+	if (renderer->rectCount == renderer->rectCapacity)
+	{
+		renderer->rectCapacity = renderer->rectCapacity == 0 ? PARTICLE_RENDERER_INITIAL_CAPACITY : renderer->rectCapacity * 2;
+		renderer->rects = (SDL_Rect *)realloc(renderer->rects, renderer->rectCapacity * sizeof(SDL_Rect));
+	}
+
+	//squares of the size of the circle, drawn with the current draw color
+	rect = &renderer->rects[renderer->rectCount++];
+	rect->x = (int)(x - radius);
+	rect->y = (int)(y - radius);
+	rect->w = rect->h = radius < 0.5f ? 1 : (int)(2 * radius);
+#endif
+}
+
+int particle_renderer_flush(ParticleRenderer_t *renderer, SDL_Renderer *sdlRenderer)
+{
+#if PARTICLE_RENDERER_GEOMETRY
+	if (renderer->indexCount == 0)
+	{
+		return 0;
+	}
+	return SDL_RenderGeometry(sdlRenderer, renderer->atlas, renderer->vertices, (int)renderer->vertexCount, renderer->indices, (int)renderer->indexCount);
+#else
+	if (renderer->rectCount == 0)
+	{
+		return 0;
+	}
+	return SDL_RenderFillRects(sdlRenderer, renderer->rects, (int)renderer->rectCount);
+#endif
+}
+
+void particle_renderer_destroy(ParticleRenderer_t *renderer)
+{
+#if PARTICLE_RENDERER_GEOMETRY
+	if (renderer->atlas != NULL)
+	{
+		SDL_DestroyTexture(renderer->atlas);
+	}
+	free(renderer->vertices);
+	free(renderer->indices);
+#else
+	free(renderer->rects);
+#endif
+	free(renderer);
+}
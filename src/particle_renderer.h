@@ -0,0 +1,76 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Batched renderer of the particles, every particle of a frame is a textured quad from a sprite atlas of antialiased disks,
+              all of them are put in one vertex buffer and drawn with a single call
+*/
+#include <stddef.h>
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+
+#pragma once
+
+//SDL_RenderGeometry (textured triangles) exists since SDL 2.0.18, older versions fall back to one SDL_RenderFillRects call (squares)
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+#define PARTICLE_RENDERER_GEOMETRY 1
+#else
+#define PARTICLE_RENDERER_GEOMETRY 0
+#endif
+
+//radius in pixels of the biggest disk of the atlas (there is one disk per integer radius from 1 to this one), bigger particles are clamped to it
+#define PARTICLE_RENDERER_MAX_RADIUS 16
+
+//Position of a disk in the atlas (texture coordinates from 0 to 1)
+typedef struct ParticleSprite_s {
+	float u0, v0;
+	float u1, v1;
+	float halfSize; //half of the size of the quad in pixels (radius + 1 pixel of transparent border)
+} ParticleSprite_t;
+
+//Particle renderer
+typedef struct ParticleRenderer_s {
+#if PARTICLE_RENDERER_GEOMETRY
+	SDL_Texture *atlas; //white disks, tinted by the color of the vertices
+	ParticleSprite_t sprites[PARTICLE_RENDERER_MAX_RADIUS + 1];
+	SDL_Vertex *vertices;
+	int *indices;
+	size_t vertexCount;
+	size_t indexCount;
+	size_t vertexCapacity;
+	size_t indexCapacity;
+#else
+	SDL_Rect *rects;
+	size_t rectCount;
+	size_t rectCapacity;
+#endif
+} ParticleRenderer_t;
+
+/**
+ * @brief Initializes a new empty ParticleRenderer_t and rasterizes its sprite atlas into a texture of the SDL renderer.
+ * @return ParticleRenderer_t* NULL if the texture could not be created (see SDL_GetError)
+ */
+ParticleRenderer_t *particle_renderer_initializer(SDL_Renderer *sdlRenderer);
+
+/**
+ * @brief Empty the batch, to call at the start of every frame. The buffers are kept and only grow.
+ * @return void
+ */
+void particle_renderer_begin(ParticleRenderer_t *renderer);
+
+/**
+ * @brief Add a disk (in screen coordinates) to the batch, as a quad textured with the disk of the atlas of the closest radius.
+ * @return void
+ */
+void particle_renderer_add_circle(ParticleRenderer_t *renderer, float x, float y, float radius, SDL_Color color);
+
+/**
+ * @brief Draw every circle of the batch with a single SDL_RenderGeometry (or SDL_RenderFillRects) call.
+ * @return int 0 on success, a negative value on error (see SDL_GetError)
+ */
+int particle_renderer_flush(ParticleRenderer_t *renderer, SDL_Renderer *sdlRenderer);
+
+/**
+ * @brief Free the atlas, the buffers and the ParticleRenderer_t.
+ * @return void
+ */
+void particle_renderer_destroy(ParticleRenderer_t *renderer);
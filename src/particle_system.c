@@ -0,0 +1,1290 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Particle system (structure of arrays) and the functions stepping it
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "matrix.h"
+#include "particle.h"
+#include "particle_system.h"
+#include "gravity.h"
+#include "tests.h"
+
+#define PARTICLE_SYSTEM_MIN_CAPACITY 16
+//digits of the radix sort of the Morton keys (4 passes of 8 bits)
+#define PARTICLE_SYSTEM_RADIX_BITS 8
+#define PARTICLE_SYSTEM_RADIX_BUCKETS (1 << PARTICLE_SYSTEM_RADIX_BITS)
+//key of the free slots, above every Morton key of PARTICLE_SYSTEM_MORTON_BITS bits per axis so that they end up last
+#define PARTICLE_SYSTEM_FREE_KEY UINT32_MAX
+
+/*
+ * Allocate an array of doubles aligned on PARTICLE_SYSTEM_ALIGNMENT bytes.
+ */
+static double *aligned_array(size_t count)
+{
+	size_t size = count * sizeof(double);
+	void *array = NULL;
+
+	//round up so that the next array never shares a cache line with this one
+	size = (size + PARTICLE_SYSTEM_ALIGNMENT - 1) / PARTICLE_SYSTEM_ALIGNMENT * PARTICLE_SYSTEM_ALIGNMENT;
+#ifdef _WIN32
+	array = _aligned_malloc(size, PARTICLE_SYSTEM_ALIGNMENT);
+#else
+	if (posix_memalign(&array, PARTICLE_SYSTEM_ALIGNMENT, size) != 0)
+	{
+		array = NULL;
+	}
+#endif
+	if (array == NULL)
+	{
+		fprintf(stderr, "error: could not allocate %zu bytes for the particle system\n", size);
+		exit(1);
+	}
+
+	return (double *)array;
+}
+
+static void aligned_free(double *array)
+{
+#ifdef _WIN32
+	_aligned_free(array);
+#else
+	free(array);
+#endif
+}
+
+/*
+ * Copy the count first values of an array to a new aligned one of the given capacity.
+ */
+static double *aligned_copy(double *array, size_t count, size_t capacity)
+{
+	double *newArray = aligned_array(capacity);
+
+	if (array != NULL)
+	{
+		memcpy(newArray, array, count * sizeof(double));
+	}
+
+	return newArray;
+}
+
+/*
+ * Move an array to a bigger aligned one, keeping the count first values.
+ */
+static double *aligned_grow(double *array, size_t count, size_t capacity)
+{
+	double *newArray = aligned_copy(array, count, capacity);
+
+	if (array != NULL)
+	{
+		aligned_free(array);
+	}
+
+	return newArray;
+}
+
+ParticleSystem_t *particle_system_initializer(size_t capacity)
+{
+	ParticleSystem_t *system = (ParticleSystem_t *)calloc(1, sizeof(ParticleSystem_t));
+
+	system->processors = thread_pool_cpu_count();
+	particle_system_reserve(system, capacity);
+
+	return system;
+}
+
+ParticleSystem_t *particle_system_from_arrays(size_t count, double *x, double *y, double *lastX, double *lastY, double *mass,
+											  void (*release)(void *owner), void *owner)
+{
+	ParticleSystem_t *system = (ParticleSystem_t *)calloc(1, sizeof(ParticleSystem_t));
+	size_t capacity = count > 0 ? count : 1;
+
+	system->count = count;
+	system->capacity = count;
+	system->x = x;
+	system->y = y;
+	system->lastX = lastX;
+	system->lastY = lastY;
+	system->mass = mass;
+	system->ax = aligned_array(capacity);
+	system->ay = aligned_array(capacity);
+	system->vx = aligned_array(capacity);
+	system->vy = aligned_array(capacity);
+	system->freeSlots = (size_t *)malloc(capacity * sizeof(size_t));
+	system->ids = (size_t *)malloc(capacity * sizeof(size_t));
+	system->slots = (size_t *)malloc(capacity * sizeof(size_t));
+	for (size_t i = 0; i < count; i++)
+	{
+		system->ids[i] = i;
+		system->slots[i] = i;
+	}
+	system->processors = thread_pool_cpu_count();
+	system->release = release;
+	system->owner = owner;
+
+	return system;
+}
+
+void particle_system_reserve(ParticleSystem_t *system, size_t capacity)
+{
+	if (capacity < PARTICLE_SYSTEM_MIN_CAPACITY)
+	{
+		capacity = PARTICLE_SYSTEM_MIN_CAPACITY;
+	}
+	if (capacity <= system->capacity)
+	{
+		return;
+	}
+
+	if (system->release != NULL)
+	{
+		//borrowed arrays : copied to arrays of the system, then given back to their owner
+		system->x = aligned_copy(system->x, system->count, capacity);
+		system->y = aligned_copy(system->y, system->count, capacity);
+		system->lastX = aligned_copy(system->lastX, system->count, capacity);
+		system->lastY = aligned_copy(system->lastY, system->count, capacity);
+		system->mass = aligned_copy(system->mass, system->count, capacity);
+		system->release(system->owner);
+		system->release = NULL;
+		system->owner = NULL;
+	}
+	else
+	{
+		system->x = aligned_grow(system->x, system->count, capacity);
+		system->y = aligned_grow(system->y, system->count, capacity);
+		system->lastX = aligned_grow(system->lastX, system->count, capacity);
+		system->lastY = aligned_grow(system->lastY, system->count, capacity);
+		system->mass = aligned_grow(system->mass, system->count, capacity);
+	}
+	system->ax = aligned_grow(system->ax, system->count, capacity);
+	system->ay = aligned_grow(system->ay, system->count, capacity);
+	system->vx = aligned_grow(system->vx, system->count, capacity);
+	system->vy = aligned_grow(system->vy, system->count, capacity);
+	//there are never more free slots than slots in use
+	system->freeSlots = (size_t *)realloc(system->freeSlots, capacity * sizeof(size_t));
+	system->ids = (size_t *)realloc(system->ids, capacity * sizeof(size_t));
+	system->slots = (size_t *)realloc(system->slots, capacity * sizeof(size_t));
+	system->capacity = capacity;
+}
+
+size_t particle_system_add(ParticleSystem_t *system, double lastX, double lastY, double x, double y, double mass)
+{
+	size_t index;
+
+	if (system->freeCount > 0)
+	{
+		index = system->freeSlots[--system->freeCount];
+	}
+	else
+	{
+		if (system->count == system->capacity)
+		{
+			particle_system_reserve(system, system->capacity * 2);
+		}
+		index = system->count++;
+		//the ids in use are [0, count)
+		system->ids[index] = index;
+		system->slots[index] = index;
+	}
+
+	system->x[index] = x;
+	system->y[index] = y;
+	system->lastX[index] = lastX;
+	system->lastY[index] = lastY;
+	system->mass[index] = mass;
+	system->ax[index] = 0;
+	system->ay[index] = 0;
+	system->vx[index] = 0;
+	system->vy[index] = 0;
+
+	return index;
+}
+
+void particle_system_remove(ParticleSystem_t *system, size_t index)
+{
+	if (index >= system->count || system->mass[index] == 0)
+	{
+		return;
+	}
+
+	system->mass[index] = 0;
+	system->ax[index] = 0;
+	system->ay[index] = 0;
+	if (index == system->count - 1 && system->ids[index] == index)
+	{
+		//the last slot is simply dropped, the free ones stay below count (a sorted particle may hold another id in the last slot)
+		system->count--;
+	}
+	else
+	{
+		system->freeSlots[system->freeCount++] = index;
+	}
+}
+
+bool particle_system_alive(ParticleSystem_t *system, size_t index)
+{
+	return index < system->count && system->mass[index] != 0;
+}
+
+bool particle_system_needs_compaction(ParticleSystem_t *system)
+{
+	return system->freeCount * PARTICLE_SYSTEM_COMPACT_RATIO > system->count;
+}
+
+void particle_system_compact(ParticleSystem_t *system)
+{
+	size_t hole = 0;
+	size_t last = system->count;
+	size_t alive = system->count - system->freeCount;
+	size_t freeIds = 0;
+
+	//ids of the free slots below the new count, given to the particles whose id is not (the free list is not needed anymore)
+	for (size_t i = 0; i < system->count; i++)
+	{
+		if (system->mass[i] == 0 && system->ids[i] < alive)
+		{
+			system->freeSlots[freeIds++] = system->ids[i];
+		}
+	}
+
+	while (true)
+	{
+		//first free slot from the start and last particle from the end
+		while (hole < last && system->mass[hole] != 0)
+		{
+			hole++;
+		}
+		while (last > hole && system->mass[last - 1] == 0)
+		{
+			last--;
+		}
+		if (hole >= last)
+		{
+			break;
+		}
+
+		last--;
+		system->x[hole] = system->x[last];
+		system->y[hole] = system->y[last];
+		system->lastX[hole] = system->lastX[last];
+		system->lastY[hole] = system->lastY[last];
+		system->mass[hole] = system->mass[last];
+		system->ax[hole] = system->ax[last];
+		system->ay[hole] = system->ay[last];
+		system->vx[hole] = system->vx[last];
+		system->vy[hole] = system->vy[last];
+		system->ids[hole] = system->ids[last];
+		system->mass[last] = 0;
+	}
+
+	system->count = hole;
+	system->freeCount = 0;
+	//in the same order as the holes, a system that was never sorted keeps ids equal to the slots
+	freeIds = 0;
+	for (size_t i = 0; i < system->count; i++)
+	{
+		if (system->ids[i] >= system->count)
+		{
+			system->ids[i] = system->freeSlots[freeIds++];
+		}
+		system->slots[system->ids[i]] = i;
+	}
+}
+
+bool particle_system_bounds(ParticleSystem_t *system, size_t begin, size_t end, double *minX, double *minY, double *maxX, double *maxY)
+{
+	*minX = *minY = INFINITY;
+	*maxX = *maxY = -INFINITY;
+	for (size_t i = begin; i < end; i++)
+	{
+		if (system->mass[i] != 0)
+		{
+			*minX = fmin(*minX, system->x[i]);
+			*minY = fmin(*minY, system->y[i]);
+			*maxX = fmax(*maxX, system->x[i]);
+			*maxY = fmax(*maxY, system->y[i]);
+		}
+	}
+	if (*minX > *maxX)
+	{
+		*minX = *minY = *maxX = *maxY = 0;
+		return false;
+	}
+	return true;
+}
+
+//arguments of the tasks of the Morton sort, the loops of the radix sort are split in one chunk of the keys per thread
+typedef struct SortContext_s {
+	ParticleSystem_t *system;
+	size_t chunks;
+	double *bounds; //minX, minY, maxX, maxY of the particles alive of every chunk
+	double minX;
+	double minY;
+	double scale; //cells of the keys per unit of length
+	uint32_t *keys;
+	uint32_t *sortedKeys;
+	size_t *indices; //slot of the particle of every key
+	size_t *sortedIndices;
+	size_t *offsets; //PARTICLE_SYSTEM_RADIX_BUCKETS counts then offsets per chunk
+	int shift;		 //of the digit of the current pass
+	double *source;	 //array being permuted
+	double *destination;
+} SortContext_t;
+
+/*
+ * Insert a 0 bit before every bit of the 16 low bits of value.
+ */
+static uint32_t morton_spread(uint32_t value)
+{
+	value &= 0xFFFF;
+	value = (value | (value << 8)) & 0x00FF00FF;
+	value = (value | (value << 4)) & 0x0F0F0F0F;
+	value = (value | (value << 2)) & 0x33333333;
+	value = (value | (value << 1)) & 0x55555555;
+	return value;
+}
+
+static void particle_system_bounds_task(void *context, int thread, size_t begin, size_t end)
+{
+	SortContext_t *sort = (SortContext_t *)context;
+	ParticleSystem_t *system = sort->system;
+
+	(void)thread;
+	for (size_t chunk = begin; chunk < end; chunk++)
+	{
+		double *bounds = &sort->bounds[4 * chunk];
+
+		//a chunk without particles alive must not widen the box
+		if (!particle_system_bounds(system, system->count * chunk / sort->chunks, system->count * (chunk + 1) / sort->chunks,
+									&bounds[0], &bounds[1], &bounds[2], &bounds[3]))
+		{
+			bounds[0] = bounds[1] = INFINITY;
+			bounds[2] = bounds[3] = -INFINITY;
+		}
+	}
+}
+
+static void particle_system_keys_task(void *context, int thread, size_t begin, size_t end)
+{
+	SortContext_t *sort = (SortContext_t *)context;
+	ParticleSystem_t *system = sort->system;
+
+	(void)thread;
+	for (size_t i = begin; i < end; i++)
+	{
+		sort->keys[i] = PARTICLE_SYSTEM_FREE_KEY;
+		sort->indices[i] = i;
+		if (system->mass[i] != 0)
+		{
+			uint32_t cellX = (uint32_t)((system->x[i] - sort->minX) * sort->scale);
+			uint32_t cellY = (uint32_t)((system->y[i] - sort->minY) * sort->scale);
+
+			sort->keys[i] = morton_spread(cellX) | morton_spread(cellY) << 1;
+		}
+	}
+}
+
+static void particle_system_histogram_task(void *context, int thread, size_t begin, size_t end)
+{
+	SortContext_t *sort = (SortContext_t *)context;
+	size_t count = sort->system->count;
+
+	(void)thread;
+	for (size_t chunk = begin; chunk < end; chunk++)
+	{
+		size_t *counts = &sort->offsets[chunk * PARTICLE_SYSTEM_RADIX_BUCKETS];
+
+		memset(counts, 0, PARTICLE_SYSTEM_RADIX_BUCKETS * sizeof(size_t));
+		for (size_t i = count * chunk / sort->chunks; i < count * (chunk + 1) / sort->chunks; i++)
+		{
+			counts[(sort->keys[i] >> sort->shift) & (PARTICLE_SYSTEM_RADIX_BUCKETS - 1)]++;
+		}
+	}
+}
+
+/*
+ * Move the keys of every chunk to the offsets of their digit, in their order (stable sort).
+ */
+static void particle_system_scatter_task(void *context, int thread, size_t begin, size_t end)
+{
+	SortContext_t *sort = (SortContext_t *)context;
+	size_t count = sort->system->count;
+
+	(void)thread;
+	for (size_t chunk = begin; chunk < end; chunk++)
+	{
+		size_t *offsets = &sort->offsets[chunk * PARTICLE_SYSTEM_RADIX_BUCKETS];
+
+		for (size_t i = count * chunk / sort->chunks; i < count * (chunk + 1) / sort->chunks; i++)
+		{
+			size_t position = offsets[(sort->keys[i] >> sort->shift) & (PARTICLE_SYSTEM_RADIX_BUCKETS - 1)]++;
+
+			sort->sortedKeys[position] = sort->keys[i];
+			sort->sortedIndices[position] = sort->indices[i];
+		}
+	}
+}
+
+static void particle_system_gather_task(void *context, int thread, size_t begin, size_t end)
+{
+	SortContext_t *sort = (SortContext_t *)context;
+	size_t *order = sort->system->order;
+
+	(void)thread;
+	for (size_t i = begin; i < end; i++)
+	{
+		sort->destination[i] = sort->source[order[i]];
+	}
+}
+
+static void particle_system_ids_task(void *context, int thread, size_t begin, size_t end)
+{
+	SortContext_t *sort = (SortContext_t *)context;
+	ParticleSystem_t *system = sort->system;
+
+	(void)thread;
+	for (size_t i = begin; i < end; i++)
+	{
+		//sortedIndices is free once the sort is done
+		sort->sortedIndices[i] = system->ids[system->order[i]];
+		system->slots[sort->sortedIndices[i]] = i;
+	}
+}
+
+void particle_system_sort_morton(ParticleSystem_t *system, ThreadPool_t *pool)
+{
+	size_t count = system->count;
+	SortContext_t sort;
+	double maxX = -INFINITY, maxY = -INFINITY;
+	double *scratch;
+	//the borrowed arrays first
+	double **arrays[] = {&system->x, &system->y, &system->lastX, &system->lastY, &system->mass,
+						 &system->ax, &system->ay, &system->vx, &system->vy};
+	const size_t borrowable = 5;
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	system->order = (size_t *)realloc(system->order, system->capacity * sizeof(size_t));
+	sort.system = system;
+	sort.chunks = (size_t)thread_pool_thread_count(pool);
+	sort.bounds = (double *)malloc(4 * sort.chunks * sizeof(double));
+	sort.keys = (uint32_t *)malloc(count * sizeof(uint32_t));
+	sort.sortedKeys = (uint32_t *)malloc(count * sizeof(uint32_t));
+	sort.indices = system->order;
+	sort.sortedIndices = (size_t *)malloc(count * sizeof(size_t));
+	sort.offsets = (size_t *)malloc(sort.chunks * PARTICLE_SYSTEM_RADIX_BUCKETS * sizeof(size_t));
+
+	//keys : the cells of a square grid over the bounding box of the particles alive, their bits interleaved
+	thread_pool_parallel_for(pool, sort.chunks, particle_system_bounds_task, &sort);
+	sort.minX = sort.minY = INFINITY;
+	for (size_t chunk = 0; chunk < sort.chunks; chunk++)
+	{
+		sort.minX = fmin(sort.minX, sort.bounds[4 * chunk]);
+		sort.minY = fmin(sort.minY, sort.bounds[4 * chunk + 1]);
+		maxX = fmax(maxX, sort.bounds[4 * chunk + 2]);
+		maxY = fmax(maxY, sort.bounds[4 * chunk + 3]);
+	}
+	sort.scale = fmax(maxX - sort.minX, maxY - sort.minY) > 0 ? ((1 << PARTICLE_SYSTEM_MORTON_BITS) - 1) / fmax(maxX - sort.minX, maxY - sort.minY) : 0;
+	thread_pool_parallel_for(pool, count, particle_system_keys_task, &sort);
+
+	//least significant digit first, every pass is stable : the counts of every chunk, their offsets in the order of the digits
+	//then of the chunks, and every chunk moves its keys to its offsets
+	for (sort.shift = 0; sort.shift < 32; sort.shift += PARTICLE_SYSTEM_RADIX_BITS)
+	{
+		size_t offset = 0;
+		uint32_t *swapKeys = sort.keys;
+		size_t *swapIndices = sort.indices;
+
+		thread_pool_parallel_for(pool, sort.chunks, particle_system_histogram_task, &sort);
+		for (size_t digit = 0; digit < PARTICLE_SYSTEM_RADIX_BUCKETS; digit++)
+		{
+			for (size_t chunk = 0; chunk < sort.chunks; chunk++)
+			{
+				size_t digitCount = sort.offsets[chunk * PARTICLE_SYSTEM_RADIX_BUCKETS + digit];
+
+				sort.offsets[chunk * PARTICLE_SYSTEM_RADIX_BUCKETS + digit] = offset;
+				offset += digitCount;
+			}
+		}
+		thread_pool_parallel_for(pool, sort.chunks, particle_system_scatter_task, &sort);
+		sort.keys = sort.sortedKeys;
+		sort.sortedKeys = swapKeys;
+		sort.indices = sort.sortedIndices;
+		sort.sortedIndices = swapIndices;
+	}
+	//an even number of passes : the sorted slots are back in order
+	free(sort.keys);
+	free(sort.sortedKeys);
+	free(sort.offsets);
+	free(sort.bounds);
+
+	//permute every array : gathered to a scratch array which takes its place (copied back to a borrowed array)
+	scratch = aligned_array(system->capacity);
+	for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++)
+	{
+		sort.source = *arrays[i];
+		sort.destination = scratch;
+		thread_pool_parallel_for(pool, count, particle_system_gather_task, &sort);
+		if (system->release != NULL && i < borrowable)
+		{
+			memcpy(*arrays[i], scratch, count * sizeof(double));
+		}
+		else
+		{
+			*arrays[i] = scratch;
+			scratch = sort.source;
+		}
+	}
+	aligned_free(scratch);
+	thread_pool_parallel_for(pool, count, particle_system_ids_task, &sort);
+	memcpy(system->ids, sort.sortedIndices, count * sizeof(size_t));
+	free(sort.sortedIndices);
+
+	//the free slots are the last ones, the lowest is reused first
+	for (size_t i = 0; i < system->freeCount; i++)
+	{
+		system->freeSlots[i] = count - 1 - i;
+	}
+}
+
+static void particle_system_accelerations_mixed_task(void *context, int thread, size_t begin, size_t end)
+{
+	ParticleSystem_t *system = (ParticleSystem_t *)context;
+
+	(void)thread;
+	gravity_direct_mixed(system->singleX, system->singleY, system->singleMass, system->count,
+						 &system->singleX[begin], &system->singleY[begin], &system->ax[begin], &system->ay[begin], end - begin);
+}
+
+/*
+ * Refresh the float copies of the positions and masses, relative to the center of the bounding box of the particles
+ * so that the float resolution is the one of the size of the system and not of its distance to the origin.
+ */
+static void particle_system_refresh_single(ParticleSystem_t *system)
+{
+	double minX, minY, maxX, maxY;
+	double centerX, centerY;
+
+	if (system->singleCapacity < system->capacity)
+	{
+		aligned_free((double *)system->singleX);
+		aligned_free((double *)system->singleY);
+		aligned_free((double *)system->singleMass);
+		//2 floats per double of the aligned arrays
+		system->singleX = (float *)aligned_array((system->capacity + 1) / 2);
+		system->singleY = (float *)aligned_array((system->capacity + 1) / 2);
+		system->singleMass = (float *)aligned_array((system->capacity + 1) / 2);
+		system->singleCapacity = system->capacity;
+	}
+
+	particle_system_bounds(system, 0, system->count, &minX, &minY, &maxX, &maxY);
+	centerX = (minX + maxX) / 2;
+	centerY = (minY + maxY) / 2;
+
+	for (size_t i = 0; i < system->count; i++)
+	{
+		system->singleX[i] = (float)(system->x[i] - centerX);
+		system->singleY[i] = (float)(system->y[i] - centerY);
+		system->singleMass[i] = (float)system->mass[i];
+	}
+}
+
+//tiles of a round of the symmetric direct sum
+typedef struct PairsContext_s {
+	ParticleSystem_t *system;
+	size_t blocks; //even
+	size_t round;  //blocks - 1 : the tiles of the blocks with themselves
+} PairsContext_t;
+
+/*
+ * Even number of blocks of the symmetric direct sum : enough tiles per round for every processor, but never blocks so small that the
+ * rounds cost more in synchronization than in pairs. Only depends on the particles and the processors, never on the threads of the pool.
+ */
+static size_t particle_system_pair_blocks(size_t count, int processors)
+{
+	size_t blocks = (count + PARTICLE_SYSTEM_PAIR_BLOCK - 1) / PARTICLE_SYSTEM_PAIR_BLOCK;
+	size_t busy = 2 * (size_t)processors;
+	size_t limit = busy > PARTICLE_SYSTEM_PAIR_MAX_BLOCKS ? busy : PARTICLE_SYSTEM_PAIR_MAX_BLOCKS;
+
+	blocks = blocks < busy ? busy : blocks > limit ? limit : blocks;
+	if (blocks > count / PARTICLE_SYSTEM_PAIR_MIN_BLOCK)
+	{
+		blocks = count / PARTICLE_SYSTEM_PAIR_MIN_BLOCK;
+	}
+	blocks -= blocks % 2;
+	return blocks < 2 ? 2 : blocks;
+}
+
+/*
+ * Tile k of a round : round robin pairing of the blocks (the last one stays in place, the others rotate), every block is in exactly
+ * one tile of a round and every pair of blocks in exactly one round.
+ */
+static void particle_system_accelerations_pairs_task(void *context, int thread, size_t begin, size_t end)
+{
+	PairsContext_t *pairs = (PairsContext_t *)context;
+	ParticleSystem_t *system = pairs->system;
+	size_t blocks = pairs->blocks;
+
+	(void)thread;
+	for (size_t k = begin; k < end; k++)
+	{
+		size_t first, second;
+
+		if (pairs->round == blocks - 1)
+		{
+			first = second = k;
+		}
+		else
+		{
+			first = k == 0 ? blocks - 1 : (pairs->round + k) % (blocks - 1);
+			second = (pairs->round + blocks - 1 - k) % (blocks - 1);
+			if (first > second)
+			{
+				size_t swap = first;
+				first = second;
+				second = swap;
+			}
+		}
+		gravity_pairs(system->x, system->y, system->mass, system->count * first / blocks, system->count * (first + 1) / blocks,
+					  system->count * second / blocks, system->count * (second + 1) / blocks, system->ax, system->ay);
+	}
+}
+
+void particle_system_accelerations_direct(ParticleSystem_t *system, ThreadPool_t *pool)
+{
+	if (gravity_get_precision() == GRAVITY_PRECISION_MIXED && system->count > 0)
+	{
+		particle_system_refresh_single(system);
+		thread_pool_parallel_for(pool, system->count, particle_system_accelerations_mixed_task, system);
+		return;
+	}
+
+	//the blocks keep a pool of one thread per processor busy, the sums are the same whatever the number of threads
+	PairsContext_t pairs = {system, particle_system_pair_blocks(system->count, system->processors), 0};
+
+	memset(system->ax, 0, system->count * sizeof(double));
+	memset(system->ay, 0, system->count * sizeof(double));
+	//the pairs inside every block, then blocks - 1 rounds of blocks / 2 tiles between two blocks
+	pairs.round = pairs.blocks - 1;
+	thread_pool_parallel_for(pool, pairs.blocks, particle_system_accelerations_pairs_task, &pairs);
+	for (pairs.round = 0; pairs.round < pairs.blocks - 1; pairs.round++)
+	{
+		thread_pool_parallel_for(pool, pairs.blocks / 2, particle_system_accelerations_pairs_task, &pairs);
+	}
+}
+
+void particle_system_precision_error(ParticleSystem_t *system, ThreadPool_t *pool, double *maxError, double *rmsError)
+{
+	GravityPrecision_t precision = gravity_get_precision();
+	double *mixedX = (double *)malloc(system->count * sizeof(double));
+	double *mixedY = (double *)malloc(system->count * sizeof(double));
+	double sum = 0;
+	size_t alive = 0;
+
+	gravity_set_precision(GRAVITY_PRECISION_MIXED);
+	particle_system_accelerations_direct(system, pool);
+	memcpy(mixedX, system->ax, system->count * sizeof(double));
+	memcpy(mixedY, system->ay, system->count * sizeof(double));
+	gravity_set_precision(GRAVITY_PRECISION_DOUBLE);
+	particle_system_accelerations_direct(system, pool);
+	gravity_set_precision(precision);
+
+	*maxError = 0;
+	for (size_t i = 0; i < system->count; i++)
+	{
+		double norm = hypot(system->ax[i], system->ay[i]);
+		double error;
+
+		if (system->mass[i] == 0 || norm == 0)
+		{
+			continue;
+		}
+		error = hypot(mixedX[i] - system->ax[i], mixedY[i] - system->ay[i]) / norm;
+		*maxError = fmax(*maxError, error);
+		sum += error * error;
+		alive++;
+	}
+	*rmsError = alive > 0 ? sqrt(sum / alive) : 0;
+
+	free(mixedX);
+	free(mixedY);
+}
+
+//arguments of the attraction task
+typedef struct AttractionContext_s {
+	ParticleSystem_t *system;
+	Particle_t *body;
+} AttractionContext_t;
+
+static void particle_system_add_attraction_task(void *context, int thread, size_t begin, size_t end)
+{
+	ParticleSystem_t *system = ((AttractionContext_t *)context)->system;
+	Particle_t *body = ((AttractionContext_t *)context)->body;
+	const double gm = G * body->mass;
+	double bodyX = body->pos.x;
+	double bodyY = body->pos.y;
+
+	(void)thread;
+	for (size_t i = begin; i < end; i++)
+	{
+		double dx = bodyX - system->x[i];
+		double dy = bodyY - system->y[i];
+		double distanceSquared = dx * dx + dy * dy;
+		double inv = gm / (distanceSquared * sqrt(distanceSquared));
+
+		system->ax[i] += dx * inv;
+		system->ay[i] += dy * inv;
+	}
+}
+
+void particle_system_add_attraction(ParticleSystem_t *system, Particle_t *body, ThreadPool_t *pool)
+{
+	AttractionContext_t context = {system, body};
+
+	thread_pool_parallel_for(pool, system->count, particle_system_add_attraction_task, &context);
+}
+
+//arguments of the step task
+typedef struct StepContext_s {
+	ParticleSystem_t *system;
+	double timeStepSquared;
+} StepContext_t;
+
+static void particle_system_step_task(void *context, int thread, size_t begin, size_t end)
+{
+	ParticleSystem_t *system = ((StepContext_t *)context)->system;
+	const double timeStepSquared = ((StepContext_t *)context)->timeStepSquared;
+
+	(void)thread;
+	for (size_t i = begin; i < end; i++)
+	{
+		double nextX = 2 * system->x[i] - system->lastX[i] + system->ax[i] * timeStepSquared;
+		double nextY = 2 * system->y[i] - system->lastY[i] + system->ay[i] * timeStepSquared;
+
+		//free slot, stays where it is
+		if (system->mass[i] == 0)
+		{
+			continue;
+		}
+
+		system->lastX[i] = system->x[i];
+		system->lastY[i] = system->y[i];
+		system->x[i] = nextX;
+		system->y[i] = nextY;
+	}
+}
+
+void particle_system_step(ParticleSystem_t *system, double timeStep, ThreadPool_t *pool)
+{
+	StepContext_t context = {system, timeStep * timeStep};
+
+	thread_pool_parallel_for(pool, system->count, particle_system_step_task, &context);
+}
+
+//arguments of the kick, drift and velocity tasks
+typedef struct LeapfrogContext_s {
+	ParticleSystem_t *system;
+	double timeStep;
+} LeapfrogContext_t;
+
+static void particle_system_kick_task(void *context, int thread, size_t begin, size_t end)
+{
+	ParticleSystem_t *system = ((LeapfrogContext_t *)context)->system;
+	const double timeStep = ((LeapfrogContext_t *)context)->timeStep;
+
+	(void)thread;
+	for (size_t i = begin; i < end; i++)
+	{
+		system->vx[i] += system->ax[i] * timeStep;
+		system->vy[i] += system->ay[i] * timeStep;
+	}
+}
+
+void particle_system_kick(ParticleSystem_t *system, double timeStep, ThreadPool_t *pool)
+{
+	LeapfrogContext_t context = {system, timeStep};
+
+	thread_pool_parallel_for(pool, system->count, particle_system_kick_task, &context);
+}
+
+static void particle_system_drift_task(void *context, int thread, size_t begin, size_t end)
+{
+	ParticleSystem_t *system = ((LeapfrogContext_t *)context)->system;
+	const double timeStep = ((LeapfrogContext_t *)context)->timeStep;
+
+	(void)thread;
+	for (size_t i = begin; i < end; i++)
+	{
+		//free slot, stays where it is
+		if (system->mass[i] == 0)
+		{
+			continue;
+		}
+
+		system->x[i] += system->vx[i] * timeStep;
+		system->y[i] += system->vy[i] * timeStep;
+	}
+}
+
+void particle_system_drift(ParticleSystem_t *system, double timeStep, ThreadPool_t *pool)
+{
+	LeapfrogContext_t context = {system, timeStep};
+
+	thread_pool_parallel_for(pool, system->count, particle_system_drift_task, &context);
+}
+
+static void particle_system_velocities_task(void *context, int thread, size_t begin, size_t end)
+{
+	ParticleSystem_t *system = ((LeapfrogContext_t *)context)->system;
+	const double timeStep = ((LeapfrogContext_t *)context)->timeStep;
+
+	(void)thread;
+	for (size_t i = begin; i < end; i++)
+	{
+		system->vx[i] = (system->x[i] - system->lastX[i]) / timeStep + system->ax[i] * timeStep / 2;
+		system->vy[i] = (system->y[i] - system->lastY[i]) / timeStep + system->ay[i] * timeStep / 2;
+	}
+}
+
+void particle_system_velocities_from_positions(ParticleSystem_t *system, double timeStep, ThreadPool_t *pool)
+{
+	LeapfrogContext_t context = {system, timeStep};
+
+	thread_pool_parallel_for(pool, system->count, particle_system_velocities_task, &context);
+}
+
+ParticleSystem_t *particle_system_from_particles(Particle_t *particles, size_t count)
+{
+	ParticleSystem_t *system = particle_system_initializer(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		particle_system_add_particle(system, &particles[i]);
+	}
+
+	return system;
+}
+
+size_t particle_system_add_particle(ParticleSystem_t *system, Particle_t *particle)
+{
+	return particle_system_add(system, particle->lastPos.x, particle->lastPos.y, particle->pos.x, particle->pos.y, particle->mass);
+}
+
+Particle_t *particle_system_get_particle(ParticleSystem_t *system, size_t index)
+{
+	return particle_initializer(vector2(system->lastX[index], system->lastY[index]), vector2(system->x[index], system->y[index]), system->mass[index]);
+}
+
+void particle_system_set_particle(ParticleSystem_t *system, size_t index, Particle_t *particle)
+{
+	system->x[index] = particle->pos.x;
+	system->y[index] = particle->pos.y;
+	system->lastX[index] = particle->lastPos.x;
+	system->lastY[index] = particle->lastPos.y;
+	system->mass[index] = particle->mass;
+}
+
+void particle_system_destroy(ParticleSystem_t *system)
+{
+	if (system->release != NULL)
+	{
+		system->release(system->owner);
+	}
+	else
+	{
+		aligned_free(system->x);
+		aligned_free(system->y);
+		aligned_free(system->lastX);
+		aligned_free(system->lastY);
+		aligned_free(system->mass);
+	}
+	aligned_free(system->ax);
+	aligned_free(system->ay);
+	aligned_free(system->vx);
+	aligned_free(system->vy);
+	aligned_free((double *)system->singleX);
+	aligned_free((double *)system->singleY);
+	aligned_free((double *)system->singleMass);
+	free(system->freeSlots);
+	free(system->ids);
+	free(system->slots);
+	free(system->order);
+	free(system);
+}
+
+//Build test : (mingw32-)gcc -o test.exe particle_system.c particle.c thread_pool.c gravity.c timer.c -lpthread -DUNIT_TESTS_PS
+#ifdef UNIT_TESTS_PS
+/* Start the overall test suite */
+START_TESTS()
+START_TEST("Growth and alignment")
+ParticleSystem_t *system = particle_system_initializer(0);
+
+for (size_t i = 0; i < 100; i++)
+{
+	particle_system_add(system, i, i, i, i, 1);
+}
+
+ASSERT(system->count == 100);
+ASSERT(system->capacity >= 100);
+ASSERT(system->x[99] == 99);
+ASSERT((size_t)system->x % PARTICLE_SYSTEM_ALIGNMENT == 0);
+ASSERT((size_t)system->mass % PARTICLE_SYSTEM_ALIGNMENT == 0);
+
+particle_system_destroy(system);
+END_TEST()
+
+START_TEST("Compatibility with Particle_t")
+ParticleSystem_t *system = particle_system_initializer(4);
+Particle_t *particle, *copy;
+
+particle = particle_initializer(vector2(1, 2), vector2(3, 4), 5);
+
+particle_system_add_particle(system, particle);
+copy = particle_system_get_particle(system, 0);
+
+ASSERT(copy->pos.x == 3 && copy->pos.y == 4);
+ASSERT(copy->lastPos.x == 1 && copy->lastPos.y == 2);
+ASSERT(copy->mass == 5);
+
+particle_destroy(particle);
+particle_destroy(copy);
+particle_system_destroy(system);
+END_TEST()
+
+START_TEST("Same accelerations as gravitational_force")
+Particle_t *particles = (Particle_t *)calloc(10, sizeof(Particle_t));
+ParticleSystem_t *system;
+
+for (size_t i = 0; i < 10; i++)
+{
+	Vector2_t pos = vector2(rand() % 100, rand() % 100 + 100 * i);
+	particles[i].lastPos = pos;
+	particles[i].pos = pos;
+	particles[i].mass = rand() % 10 + 1;
+}
+system = particle_system_from_particles(particles, 10);
+particle_system_accelerations_direct(system, NULL);
+
+for (size_t i = 0; i < 10; i++)
+{
+	double fx = 0, fy = 0;
+
+	for (size_t j = 0; j < 10; j++)
+	{
+		if (i != j)
+		{
+			Vector2_t force = gravitational_force(&particles[i], &particles[j]);
+			fx += force.x;
+			fy += force.y;
+		}
+	}
+
+	ASSERT_LESSTHAN(fabs(fx / particles[i].mass - system->ax[i]) / fabs(system->ax[i]) * 1e9, 1);
+	ASSERT_LESSTHAN(fabs(fy / particles[i].mass - system->ay[i]) / fabs(system->ay[i]) * 1e9, 1);
+}
+
+free(particles);
+particle_system_destroy(system);
+END_TEST()
+
+START_TEST("Verlet step")
+ParticleSystem_t *system = particle_system_initializer(1);
+
+particle_system_add(system, 0, 0, 1, 2, 1);
+system->ax[0] = 0.5;
+system->ay[0] = -1;
+particle_system_step(system, 2, NULL);
+
+ASSERT(system->lastX[0] == 1);
+ASSERT(system->lastY[0] == 2);
+ASSERT(system->x[0] == 4);
+ASSERT(system->y[0] == 0);
+
+particle_system_destroy(system);
+END_TEST()
+
+START_TEST("Same result whatever the number of threads")
+ParticleSystem_t *system = particle_system_initializer(1000);
+ThreadPool_t *pool = thread_pool_initializer(3);
+double *ax = (double *)malloc(1000 * sizeof(double));
+bool same = true;
+
+for (size_t i = 0; i < 1000; i++)
+{
+	double x = rand() % 1000, y = rand() % 1000;
+	particle_system_add(system, x, y, x, y, rand() % 10 + 1);
+}
+particle_system_accelerations_direct(system, NULL);
+for (size_t i = 0; i < 1000; i++)
+{
+	ax[i] = system->ax[i];
+}
+particle_system_accelerations_direct(system, pool);
+for (size_t i = 0; i < 1000; i++)
+{
+	same = same && ax[i] == system->ax[i];
+}
+ASSERT(same);
+
+free(ax);
+thread_pool_destroy(pool);
+particle_system_destroy(system);
+END_TEST()
+
+START_TEST("Pair blocks for every processor")
+ParticleSystem_t *system = particle_system_initializer(4096);
+ThreadPool_t *pool = thread_pool_initializer(32);
+double *ax = (double *)malloc(4096 * sizeof(double));
+double error = 0;
+bool same = true;
+
+//tiles per round (blocks / 2) : every processor gets one once the blocks keep PARTICLE_SYSTEM_PAIR_MIN_BLOCK particles
+ASSERT(particle_system_pair_blocks(250, 1) == 2);
+ASSERT(particle_system_pair_blocks(250, 8) == 6);
+ASSERT(particle_system_pair_blocks(4096, 1) == 16);
+ASSERT(particle_system_pair_blocks(4096, 8) == 16);
+ASSERT(particle_system_pair_blocks(4096, 32) == 64);
+ASSERT(particle_system_pair_blocks(1 << 20, 1) == PARTICLE_SYSTEM_PAIR_MAX_BLOCKS);
+ASSERT(particle_system_pair_blocks(1 << 20, 64) == 128);
+
+for (size_t i = 0; i < 4096; i++)
+{
+	double x = rand() % 1000, y = rand() % 1000;
+	particle_system_add(system, x, y, x, y, rand() % 10 + 1);
+}
+particle_system_accelerations_direct(system, NULL);
+memcpy(ax, system->ax, 4096 * sizeof(double));
+
+//blocks of a 32 processors machine : the same for any pool, the rounding of the sums of one processor
+system->processors = 32;
+particle_system_accelerations_direct(system, pool);
+for (size_t i = 0; i < 4096; i++)
+{
+	error = fmax(error, fabs(system->ax[i] - ax[i]) / fmax(fabs(ax[i]), 1e-12));
+	ax[i] = system->ax[i];
+}
+ASSERT_LESSTHAN(error, 1e-9);
+particle_system_accelerations_direct(system, NULL);
+for (size_t i = 0; i < 4096; i++)
+{
+	same = same && ax[i] == system->ax[i];
+}
+ASSERT(same);
+
+free(ax);
+thread_pool_destroy(pool);
+particle_system_destroy(system);
+END_TEST()
+
+START_TEST("Mixed precision far from the origin")
+ParticleSystem_t *system = particle_system_initializer(1000);
+ThreadPool_t *pool = thread_pool_initializer(3);
+double maxError, rmsError;
+
+//a system 1000 wide around (1e6, -1e6) : floats of the absolute positions would be 0.06 apart, relative ones 6e-5
+for (size_t i = 0; i < 1000; i++)
+{
+	double x = 1e6 + rand() % 1000 + rand() / (double)RAND_MAX, y = -1e6 + rand() % 1000 + rand() / (double)RAND_MAX;
+	particle_system_add(system, x, y, x, y, rand() % 10 + 1);
+}
+particle_system_precision_error(system, pool, &maxError, &rmsError);
+ASSERT(gravity_get_precision() == GRAVITY_PRECISION_DOUBLE);
+ASSERT_LESSTHAN(maxError, 1e-3);
+ASSERT_LESSTHAN(rmsError, 1e-4);
+
+thread_pool_destroy(pool);
+particle_system_destroy(system);
+END_TEST()
+
+START_TEST("Remove, reuse of the free slots and compaction")
+ParticleSystem_t *system = particle_system_initializer(0);
+bool contiguous = true;
+double massSum = 0;
+
+for (size_t i = 0; i < 20; i++)
+{
+	particle_system_add(system, i, i, i, i, i + 1);
+}
+particle_system_remove(system, 3);
+particle_system_remove(system, 7);
+particle_system_remove(system, 7); //already free, ignored
+particle_system_remove(system, 19); //last slot, dropped
+
+ASSERT(system->count == 19);
+ASSERT(system->freeCount == 2);
+ASSERT(!particle_system_alive(system, 7));
+ASSERT(particle_system_alive(system, 8));
+
+//free slots do not move during a step
+system->ax[7] = 1;
+particle_system_step(system, 1, NULL);
+ASSERT(system->x[7] == 7);
+
+//the last freed slot is reused first
+ASSERT(particle_system_add(system, 0, 0, 0, 0, 100) == 7);
+ASSERT(system->freeCount == 1);
+
+for (size_t i = 0; i < 10; i++)
+{
+	particle_system_remove(system, i);
+}
+ASSERT(particle_system_needs_compaction(system));
+particle_system_compact(system);
+
+ASSERT(system->count == 9);
+ASSERT(system->freeCount == 0);
+ASSERT(!particle_system_needs_compaction(system));
+for (size_t i = 0; i < system->count; i++)
+{
+	contiguous = contiguous && particle_system_alive(system, i);
+	massSum += system->mass[i];
+}
+ASSERT(contiguous);
+//particles 11 to 19 (masses 11 to 19) are left
+ASSERT(massSum == 11 + 12 + 13 + 14 + 15 + 16 + 17 + 18 + 19);
+
+particle_system_destroy(system);
+END_TEST()
+
+START_TEST("Bounds of the particles alive")
+ParticleSystem_t *system = particle_system_initializer(0);
+double minX, minY, maxX, maxY;
+
+ASSERT(!particle_system_bounds(system, 0, system->count, &minX, &minY, &maxX, &maxY));
+ASSERT(minX == 0 && minY == 0 && maxX == 0 && maxY == 0);
+particle_system_add(system, -5, 100, -5, 100, 1);
+particle_system_add(system, 2, -3, 2, -3, 1);
+particle_system_add(system, 50, 50, 50, 50, 1);
+particle_system_add(system, 1, 1, 1, 1, 1);
+//the free slot keeps its position, it is skipped
+particle_system_remove(system, 2);
+ASSERT(particle_system_bounds(system, 0, system->count, &minX, &minY, &maxX, &maxY));
+ASSERT(minX == -5 && minY == -3 && maxX == 2 && maxY == 100);
+//only free slots in the range
+ASSERT(!particle_system_bounds(system, 2, 3, &minX, &minY, &maxX, &maxY));
+
+particle_system_destroy(system);
+END_TEST()
+START_TEST("Morton sort and stable ids")
+ThreadPool_t *pool = thread_pool_initializer(3);
+ParticleSystem_t *system = particle_system_initializer(0);
+ParticleSystem_t *serial = particle_system_initializer(0);
+double *x = (double *)malloc(1000 * sizeof(double));
+double before = 0, after = 0;
+bool stable = true, sorted = true, same = true, permutation = true;
+bool *seen = (bool *)calloc(1000, sizeof(bool));
+size_t previous = 0;
+
+srand(3);
+for (size_t i = 0; i < 1000; i++)
+{
+	x[i] = rand() % 2000 - 1000 + rand() / (double)RAND_MAX;
+	double y = rand() % 2000 - 1000 + rand() / (double)RAND_MAX;
+	particle_system_add(system, x[i], y, x[i], y, rand() % 10 + 1);
+	particle_system_add(serial, x[i], y, x[i], y, system->mass[i]);
+	system->vx[i] = (double)i;
+}
+for (size_t i = 0; i < 1000; i += 10)
+{
+	particle_system_remove(system, i);
+	particle_system_remove(serial, i);
+}
+for (size_t i = 1; i < system->count; i++)
+{
+	before += hypot(system->x[i] - system->x[i - 1], system->y[i] - system->y[i - 1]);
+}
+
+particle_system_sort_morton(system, pool);
+particle_system_sort_morton(serial, NULL);
+for (size_t i = 0; i < system->count; i++)
+{
+	size_t id = system->ids[i];
+
+	//every particle and its attributes keep their id, order gives their previous slot
+	stable = stable && system->slots[id] == i && (!particle_system_alive(system, i) || (system->x[i] == x[id] && system->vx[i] == (double)id));
+	stable = stable && system->order[i] == id;
+	//the free slots last
+	sorted = sorted && particle_system_alive(system, i) == (i < system->count - system->freeCount);
+	same = same && serial->ids[i] == id && serial->x[i] == system->x[i];
+	if (i > 0 && particle_system_alive(system, i))
+	{
+		after += hypot(system->x[i] - system->x[i - 1], system->y[i] - system->y[i - 1]);
+	}
+}
+ASSERT(stable);
+ASSERT(sorted);
+ASSERT(same);
+//consecutive particles are neighbours
+printf("distance between consecutive particles : %g before, %g after the sort\n", before / system->count, after / system->count);
+ASSERT_LESSTHAN(after * 10, before);
+
+//the lowest free slot is reused, with the id of the particle removed there
+previous = system->count - system->freeCount;
+ASSERT(particle_system_add(system, 0, 0, 0, 0, 1) == previous);
+ASSERT(system->ids[previous] % 10 == 0);
+
+//ids of the particles moved by a compaction : a permutation of [0, count) again, the others keep theirs
+for (size_t i = 0; i < 400; i++)
+{
+	particle_system_remove(system, i);
+}
+particle_system_compact(system);
+for (size_t i = 0; i < system->count; i++)
+{
+	permutation = permutation && system->ids[i] < system->count && !seen[system->ids[i]] && system->slots[system->ids[i]] == i;
+	seen[system->ids[i] < system->count ? system->ids[i] : 0] = true;
+}
+ASSERT(permutation);
+
+free(seen);
+free(x);
+thread_pool_destroy(pool);
+particle_system_destroy(serial);
+particle_system_destroy(system);
+END_TEST()
+
+START_TEST("Ids of a system that is never sorted")
+ParticleSystem_t *system = particle_system_initializer(0);
+bool identity = true;
+
+//3 particles in the reverse order of their keys : the last slot holds id 0 after the sort, it is not dropped by its removal
+for (size_t i = 0; i < 3; i++)
+{
+	particle_system_add(system, 2.0 - i, 0, 2.0 - i, 0, 1);
+}
+particle_system_sort_morton(system, NULL);
+ASSERT(system->ids[2] == 0 && system->slots[0] == 2 && system->x[2] == 2);
+particle_system_remove(system, 2);
+ASSERT(system->count == 3 && system->freeCount == 1);
+particle_system_destroy(system);
+
+system = particle_system_initializer(0);
+
+for (size_t i = 0; i < 100; i++)
+{
+	particle_system_add(system, i, i, i, i, 1);
+}
+for (size_t i = 0; i < 100; i += 3)
+{
+	particle_system_remove(system, i);
+}
+particle_system_add(system, 0, 0, 0, 0, 1);
+particle_system_compact(system);
+for (size_t i = 0; i < system->count; i++)
+{
+	identity = identity && system->ids[i] == i && system->slots[i] == i;
+}
+ASSERT(identity);
+
+particle_system_destroy(system);
+END_TEST()
+/* End the overall test suite */
+END_TESTS()
+#endif
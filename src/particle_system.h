@@ -0,0 +1,206 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Particle system (structure of arrays, every attribute of the particles is stored in its own contiguous aligned array)
+*/
+#include <stddef.h>
+#include <stdbool.h>
+#include "particle.h"
+#include "thread_pool.h"
+
+#pragma once
+
+//alignment in bytes of every array of the system (cache line / widest simd register)
+#define PARTICLE_SYSTEM_ALIGNMENT 64
+//the system should be compacted once more than 1 / PARTICLE_SYSTEM_COMPACT_RATIO of its slots are free
+#define PARTICLE_SYSTEM_COMPACT_RATIO 4
+//the symmetric direct sum splits the particles in blocks of PARTICLE_SYSTEM_PAIR_BLOCK particles, PARTICLE_SYSTEM_PAIR_MAX_BLOCKS at most,
+//and in at least 2 blocks per processor (a round has blocks / 2 tiles) as long as they keep PARTICLE_SYSTEM_PAIR_MIN_BLOCK particles
+#define PARTICLE_SYSTEM_PAIR_BLOCK 256
+#define PARTICLE_SYSTEM_PAIR_MIN_BLOCK 32
+#define PARTICLE_SYSTEM_PAIR_MAX_BLOCKS 64
+//bits per axis of the Morton keys of particle_system_sort_morton (cells of 1 / 2^15 of the bounding box of the particles)
+#define PARTICLE_SYSTEM_MORTON_BITS 15
+
+//Particle system
+//Removed particles leave a free slot with a mass of 0 (no effect on the forces, not moved by the step) which is reused by the next add,
+//so count is the number of slots in use, the number of particles alive is count - freeCount.
+//The slots change when the particles are sorted (particle_system_sort_morton), the ids do not : the id of a particle is the slot
+//it would have in a system that was never sorted, so the ids are a permutation of [0, count) (a free slot keeps its id until it is reused).
+typedef struct ParticleSystem_s {
+	size_t count;
+	size_t capacity;
+	double *x;
+	double *y;
+	double *lastX;
+	double *lastY;
+	double *mass;
+	double *ax; //acceleration computed by the force stage, used by particle_system_step
+	double *ay;
+	double *vx; //velocity of the leapfrog integrators (kick / drift), not used by particle_system_step
+	double *vy;
+	size_t *freeSlots; //stack of the indices of the free slots (all below count)
+	size_t freeCount;
+	size_t *ids;   //id of the particle in every slot
+	size_t *slots; //slot of every id
+	size_t *order; //slot of every particle before the last particle_system_sort_morton, NULL before the first one
+	//float copies of the positions (relative to the center of the particles) and masses for the mixed precision direct sum,
+	//allocated by its first use and refreshed by every call
+	float *singleX;
+	float *singleY;
+	float *singleMass;
+	size_t singleCapacity;
+	int processors; //thread_pool_cpu_count() at the creation of the system, the blocks of the symmetric direct sum are sized for it
+	//x, y, lastX, lastY and mass can be borrowed from an owner (ex: a mapped checkpoint file), released by release(owner) instead of being freed,
+	//NULL when the system owns them
+	void (*release)(void *owner);
+	void *owner;
+} ParticleSystem_t;
+
+/**
+ * @brief Initializes a new empty ParticleSystem_t able to hold capacity particles before growing.
+ * @return ParticleSystem_t*
+ */
+ParticleSystem_t *particle_system_initializer(size_t capacity);
+
+/**
+ * @brief Create a system of count particles using the given arrays directly (no copy), they must be aligned on PARTICLE_SYSTEM_ALIGNMENT
+ * and writable. They stay owned by owner : release(owner) is called when the system does not need them anymore
+ * (particle_system_destroy, or the first time the system grows and moves them to its own arrays).
+ * @return ParticleSystem_t*
+ */
+ParticleSystem_t *particle_system_from_arrays(size_t count, double *x, double *y, double *lastX, double *lastY, double *mass,
+											  void (*release)(void *owner), void *owner);
+
+/**
+ * @brief Grow the arrays of the system so that it can hold at least capacity particles.
+ * @return void
+ */
+void particle_system_reserve(ParticleSystem_t *system, size_t capacity);
+
+/**
+ * @brief Add a particle to the system in O(1) : reuse the last freed slot if any, otherwise append it (growing the system if needed).
+ * The mass must be greater than 0.
+ * @return size_t the index of the new particle
+ */
+size_t particle_system_add(ParticleSystem_t *system, double lastX, double lastY, double x, double y, double mass);
+
+/**
+ * @brief Remove a particle from the system in O(1), its slot is marked free (mass of 0) and pushed on the free list.
+ * The indices of the other particles do not change. The last slot is dropped instead when its id is the last one.
+ * @return void
+ */
+void particle_system_remove(ParticleSystem_t *system, size_t index);
+
+/**
+ * @brief Check if the slot at index holds a particle (false for a removed one).
+ * @return bool
+ */
+bool particle_system_alive(ParticleSystem_t *system, size_t index);
+
+/**
+ * @brief Check if more than 1 / PARTICLE_SYSTEM_COMPACT_RATIO of the slots of the system are free.
+ * @return bool
+ */
+bool particle_system_needs_compaction(ParticleSystem_t *system);
+
+/**
+ * @brief Move the last particles into the free slots so that the particles are contiguous again and the free list is empty, in O(count).
+ * Changes the indices of the moved particles, and the ids of the particles whose id is not below the new count (they take the ids
+ * of the free slots, so that the ids are a permutation of [0, count) again).
+ * @return void
+ */
+void particle_system_compact(ParticleSystem_t *system);
+
+/**
+ * @brief Bounding box of the particles alive in the slots [begin, end) of the system (the free slots are skipped).
+ * @return bool false if none of the slots holds a particle alive (the bounds are then all 0)
+ */
+bool particle_system_bounds(ParticleSystem_t *system, size_t begin, size_t end, double *minX, double *minY, double *maxX, double *maxY);
+
+/**
+ * @brief Sort the particles along a Morton (Z-order) curve of their positions so that close particles are close in memory,
+ * the free slots go after the particles alive. Parallel radix sort of the keys, then every array is permuted (order gives the
+ * previous slot of every particle). The ids of the particles do not change, only their slots.
+ * @return void
+ */
+void particle_system_sort_morton(ParticleSystem_t *system, ThreadPool_t *pool);
+
+/**
+ * @brief Compute the acceleration of every particle from the gravity of all the other ones (direct sum), stores it in ax/ay.
+ * Uses the gravity kernel and the precision selected in gravity.h (simd when the processor supports it). The particles are split between the threads of the pool (NULL to run on the calling thread only).
+ * In double precision every pair is computed once for both particles (gravity_pairs) : the tiles of pairs of blocks run in rounds
+ * in which no two tiles share a block, so no thread writes the accelerations of another one and the sums are added in the same order
+ * whatever the number of threads.
+ * @return void
+ */
+void particle_system_accelerations_direct(ParticleSystem_t *system, ThreadPool_t *pool);
+
+/**
+ * @brief Compare the accelerations of the mixed precision direct sum with the double precision one for the current positions,
+ * the relative error of a particle being |a_mixed - a_double| / |a_double|. ax/ay are left with the double precision accelerations.
+ * @return void
+ */
+void particle_system_precision_error(ParticleSystem_t *system, ThreadPool_t *pool, double *maxError, double *rmsError);
+
+/**
+ * @brief Add the acceleration caused by the gravity of an external body (ex: the black hole) to ax/ay.
+ * @return void
+ */
+void particle_system_add_attraction(ParticleSystem_t *system, Particle_t *body, ThreadPool_t *pool);
+
+/**
+ * @brief Move every particle with position Verlet (x(tj+1) = 2x(tj) - x(tj-1) + a(tj)*deltaT^2) using the accelerations in ax/ay.
+ * @return void
+ */
+void particle_system_step(ParticleSystem_t *system, double timeStep, ThreadPool_t *pool);
+
+/**
+ * @brief Kick of the leapfrog integrators : v += a * timeStep for every particle, using the accelerations in ax/ay.
+ * @return void
+ */
+void particle_system_kick(ParticleSystem_t *system, double timeStep, ThreadPool_t *pool);
+
+/**
+ * @brief Drift of the leapfrog integrators : x += v * timeStep for every particle (lastX/lastY are not changed).
+ * @return void
+ */
+void particle_system_drift(ParticleSystem_t *system, double timeStep, ThreadPool_t *pool);
+
+/**
+ * @brief Set the velocities from the last two positions of the Verlet scheme and the accelerations in ax/ay at the current positions
+ * (v = (x - lastX) / timeStep + a * timeStep / 2, the mean velocity of the last step being the one half a step before).
+ * @return void
+ */
+void particle_system_velocities_from_positions(ParticleSystem_t *system, double timeStep, ThreadPool_t *pool);
+
+/**
+ * @brief Create a particle system holding copies of the given particles (compatibility with the Particle_t api).
+ * @return ParticleSystem_t*
+ */
+ParticleSystem_t *particle_system_from_particles(Particle_t *particles, size_t count);
+
+/**
+ * @brief Append a copy of a Particle_t to the system (compatibility with the Particle_t api).
+ * @return size_t the index of the new particle
+ */
+size_t particle_system_add_particle(ParticleSystem_t *system, Particle_t *particle);
+
+/**
+ * @brief Create a new Particle_t from one of the particles of the system (compatibility with the Particle_t api).
+ * do not forget to destroy after use
+ * @return Particle_t*
+ */
+Particle_t *particle_system_get_particle(ParticleSystem_t *system, size_t index);
+
+/**
+ * @brief Overwrite one of the particles of the system with the values of a Particle_t (compatibility with the Particle_t api).
+ * @return void
+ */
+void particle_system_set_particle(ParticleSystem_t *system, size_t index, Particle_t *particle);
+
+/**
+ * @brief Free the arrays and the ParticleSystem_t.
+ * @return void
+ */
+void particle_system_destroy(ParticleSystem_t *system);
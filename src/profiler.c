@@ -0,0 +1,242 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Named phase timers with rolling statistics (min, average, 99th percentile) over the last frames, optionally written to a csv file
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "timer.h"
+#include "profiler.h"
+#include "tests.h"
+
+Profiler_t *profiler_initializer(void)
+{
+	return (Profiler_t *)calloc(1, sizeof(Profiler_t));
+}
+
+bool profiler_open_csv(Profiler_t *profiler, const char *path)
+{
+	if (profiler->csv != NULL)
+	{
+		fclose(profiler->csv);
+	}
+	profiler->csv = fopen(path, "w");
+	if (profiler->csv == NULL)
+	{
+		fprintf(stderr, "error: could not open %s\n", path);
+		return false;
+	}
+	fprintf(profiler->csv, "frame,timer,milliseconds\n");
+	return true;
+}
+
+/*
+ * Find the timer of a phase (same pointer first, the names are usually the same literal), create it if needed.
+ */
+static ProfilerTimer_t *profiler_find(Profiler_t *profiler, const char *name, bool create)
+{
+	ProfilerTimer_t *timer;
+
+	for (int i = 0; i < profiler->timerCount; i++)
+	{
+		if (profiler->timers[i].name == name)
+		{
+			return &profiler->timers[i];
+		}
+	}
+	for (int i = 0; i < profiler->timerCount; i++)
+	{
+		if (strcmp(profiler->timers[i].name, name) == 0)
+		{
+			return &profiler->timers[i];
+		}
+	}
+	if (!create || profiler->timerCount == PROFILER_MAX_TIMERS)
+	{
+		return NULL;
+	}
+
+	timer = &profiler->timers[profiler->timerCount++];
+	memset(timer, 0, sizeof(ProfilerTimer_t));
+	timer->name = name;
+	return timer;
+}
+
+void profiler_begin(Profiler_t *profiler, const char *name)
+{
+	ProfilerTimer_t *timer;
+
+	if (profiler == NULL || (timer = profiler_find(profiler, name, true)) == NULL)
+	{
+		return;
+	}
+	timer->start = timer_now();
+}
+
+void profiler_end(Profiler_t *profiler, const char *name)
+{
+	double now = timer_now();
+	ProfilerTimer_t *timer;
+
+	if (profiler == NULL || (timer = profiler_find(profiler, name, false)) == NULL)
+	{
+		return;
+	}
+	timer->frame += now - timer->start;
+	timer->ran = true;
+}
+
+void profiler_end_frame(Profiler_t *profiler)
+{
+	if (profiler == NULL)
+	{
+		return;
+	}
+
+	for (int i = 0; i < profiler->timerCount; i++)
+	{
+		ProfilerTimer_t *timer = &profiler->timers[i];
+
+		if (!timer->ran)
+		{
+			continue;
+		}
+		timer->samples[timer->next] = timer->frame;
+		timer->next = (timer->next + 1) % PROFILER_WINDOW;
+		timer->sampleCount += timer->sampleCount < PROFILER_WINDOW;
+		if (profiler->csv != NULL)
+		{
+			fprintf(profiler->csv, "%llu,%s,%.6f\n", profiler->frame, timer->name, timer->frame * 1000);
+		}
+		timer->frame = 0;
+		timer->ran = false;
+	}
+	profiler->frame++;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+bool profiler_statistics(Profiler_t *profiler, const char *name, double *min, double *average, double *p99)
+{
+	ProfilerTimer_t *timer = profiler_find(profiler, name, false);
+	double sorted[PROFILER_WINDOW];
+	double sum = 0;
+
+	if (timer == NULL || timer->sampleCount == 0)
+	{
+		return false;
+	}
+
+	memcpy(sorted, timer->samples, timer->sampleCount * sizeof(double));
+	qsort(sorted, timer->sampleCount, sizeof(double), compare_doubles);
+	for (int i = 0; i < timer->sampleCount; i++)
+	{
+		sum += sorted[i];
+	}
+	*min = sorted[0];
+	*average = sum / timer->sampleCount;
+	//nearest rank
+	*p99 = sorted[(int)ceil(0.99 * timer->sampleCount) - 1];
+	return true;
+}
+
+void profiler_format(Profiler_t *profiler, char *buffer, size_t size)
+{
+	size_t length = 0;
+
+	buffer[0] = '\0';
+	for (int i = 0; i < profiler->timerCount && length < size; i++)
+	{
+		double min, average, p99;
+		int written;
+
+		if (!profiler_statistics(profiler, profiler->timers[i].name, &min, &average, &p99))
+		{
+			continue;
+		}
+		written = snprintf(&buffer[length], size - length, "%s%s %.2f / %.2f ms", length > 0 ? "\n" : "", profiler->timers[i].name, average * 1000, p99 * 1000);
+		if (written < 0)
+		{
+			break;
+		}
+		length += (size_t)written;
+	}
+}
+
+void profiler_destroy(Profiler_t *profiler)
+{
+	if (profiler->csv != NULL)
+	{
+		fclose(profiler->csv);
+	}
+	free(profiler);
+}
+
+//Build test : (mingw32-)gcc -o test.exe profiler.c timer.c -DUNIT_TESTS_PR
+#ifdef UNIT_TESTS_PR
+/* Start the overall test suite */
+START_TESTS()
+START_TEST("Rolling statistics")
+Profiler_t *profiler = profiler_initializer();
+double min, average, p99;
+char text[256];
+
+//measures are replaced by known values : 1 ms for 99 frames and 100 ms for one of them
+for (int frame = 0; frame < 100; frame++)
+{
+	PROFILER_SCOPE(profiler, "physics")
+	{
+		frame += 0;
+	}
+	profiler->timers[0].frame = frame == 50 ? 0.1 : 0.001;
+	profiler_end_frame(profiler);
+}
+ASSERT(profiler->frame == 100 && profiler->timerCount == 1);
+ASSERT(profiler_statistics(profiler, "physics", &min, &average, &p99));
+ASSERT_LESSTHAN(fabs(min - 0.001), 1e-12);
+ASSERT_LESSTHAN(fabs(average - (99 * 0.001 + 0.1) / 100), 1e-12);
+ASSERT_LESSTHAN(fabs(p99 - 0.001), 1e-12);
+ASSERT(!profiler_statistics(profiler, "render", &min, &average, &p99));
+
+//the window only keeps the last frames
+for (int frame = 0; frame < PROFILER_WINDOW; frame++)
+{
+	profiler_begin(profiler, "physics");
+	profiler_end(profiler, "physics");
+	profiler->timers[0].frame = 0.002;
+	profiler_end_frame(profiler);
+}
+ASSERT(profiler_statistics(profiler, "physics", &min, &average, &p99));
+ASSERT_LESSTHAN(fabs(average - 0.002), 1e-12);
+
+//a phase measured several times in a frame adds up, one that did not run keeps its statistics
+profiler_begin(profiler, "render");
+profiler_end(profiler, "render");
+profiler_begin(profiler, "render");
+profiler_end(profiler, "render");
+ASSERT(profiler->timers[1].ran);
+profiler->timers[1].frame = 0.003;
+profiler_end_frame(profiler);
+ASSERT(profiler_statistics(profiler, "render", &min, &average, &p99) && p99 == 0.003);
+ASSERT(profiler_statistics(profiler, "physics", &min, &average, &p99) && min == 0.002 && p99 == 0.002);
+
+profiler_format(profiler, text, sizeof(text));
+ASSERT(strcmp(text, "physics 2.00 / 2.00 ms\nrender 3.00 / 3.00 ms") == 0);
+
+//nothing measured without a profiler
+profiler_begin(NULL, "physics");
+profiler_end(NULL, "physics");
+profiler_end_frame(NULL);
+
+profiler_destroy(profiler);
+END_TEST()
+/* End the overall test suite */
+END_TESTS()
+#endif
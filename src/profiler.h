@@ -0,0 +1,89 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Named phase timers with rolling statistics (min, average, 99th percentile) over the last frames, optionally written to a csv file
+*/
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#pragma once
+
+//timers a profiler can hold
+#define PROFILER_MAX_TIMERS 32
+//frames kept by every timer for its statistics
+#define PROFILER_WINDOW 256
+
+//Time a phase took in each of the last frames
+typedef struct ProfilerTimer_s {
+	const char *name; //not copied, string literals are expected
+	double samples[PROFILER_WINDOW]; //seconds, ring buffer of the frames in which the timer ran
+	int sampleCount;
+	int next;		 //index of the next sample in the ring buffer
+	double start;	 //timer_now() of the running measure
+	double frame;	 //seconds measured during the current frame (a phase can run several times per frame)
+	bool ran;		 //measured at least once during the current frame
+} ProfilerTimer_t;
+
+//Profiler
+//A frame is whatever the owner calls profiler_end_frame for (a rendered frame, a physics step).
+//Every timer is meant to be used by a single thread, the one calling profiler_end_frame (one profiler per thread).
+typedef struct Profiler_s {
+	ProfilerTimer_t timers[PROFILER_MAX_TIMERS];
+	int timerCount;
+	unsigned long long frame; //frames ended so far
+	FILE *csv;				  //frame,timer,milliseconds row for every timer of every frame, NULL : no csv
+} Profiler_t;
+
+//Time the statement or block that follows as the phase name (NULL profiler : not measured). Leaving the block with break,
+//return or goto skips the end of the measure.
+#define PROFILER_SCOPE(profiler, name) \
+	for (int profilerOnce = (profiler_begin(profiler, name), 1); profilerOnce; profilerOnce = (profiler_end(profiler, name), 0))
+
+/**
+ * @brief Initializes a new Profiler_t without any timer (they are created by their first profiler_begin).
+ * @return Profiler_t*
+ */
+Profiler_t *profiler_initializer(void);
+
+/**
+ * @brief Write the time of every timer at every profiler_end_frame to a csv file.
+ * @return bool false if the file could not be opened (a message is printed on stderr)
+ */
+bool profiler_open_csv(Profiler_t *profiler, const char *path);
+
+/**
+ * @brief Start measuring the phase name, creating its timer if it is the first time (nothing is done when profiler is NULL).
+ * @return void
+ */
+void profiler_begin(Profiler_t *profiler, const char *name);
+
+/**
+ * @brief Stop measuring the phase name and add the time since its profiler_begin to the current frame.
+ * @return void
+ */
+void profiler_end(Profiler_t *profiler, const char *name);
+
+/**
+ * @brief End the current frame : the time of every timer that ran is added to its statistics (and written to the csv file).
+ * @return void
+ */
+void profiler_end_frame(Profiler_t *profiler);
+
+/**
+ * @brief Get the statistics of a timer over the last PROFILER_WINDOW frames in which it ran, in seconds.
+ * @return bool false if there is no timer with this name or it never ran
+ */
+bool profiler_statistics(Profiler_t *profiler, const char *name, double *min, double *average, double *p99);
+
+/**
+ * @brief Write one line "name avg / p99 ms" per timer (in the order of creation) to buffer.
+ * @return void
+ */
+void profiler_format(Profiler_t *profiler, char *buffer, size_t size);
+
+/**
+ * @brief Close the csv file and free the Profiler_t.
+ * @return void
+ */
+void profiler_destroy(Profiler_t *profiler);
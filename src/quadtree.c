@@ -0,0 +1,376 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Barnes-Hut quadtree, used to approximate the gravitational force of far groups of particles by their center of mass
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "particle.h"
+#include "particle_system.h"
+#include "quadtree.h"
+#include "tests.h"
+
+#define QUADTREE_INITIAL_CAPACITY 64
+//every opened node pushes its 4 children, so the stack never holds more than 3 nodes per level (+ the 4 last ones)
+#define QUADTREE_STACK_SIZE (3 * QUADTREE_MAX_DEPTH + 4)
+
+Quadtree_t *quadtree_initializer(void)
+{
+	Quadtree_t *tree = (Quadtree_t *)malloc(sizeof(Quadtree_t));
+
+	tree->count = 0;
+	tree->capacity = QUADTREE_INITIAL_CAPACITY;
+	tree->interactions = 0;
+	tree->nodes = (QuadtreeNode_t *)malloc(tree->capacity * sizeof(QuadtreeNode_t));
+
+	return tree;
+}
+
+/*
+ * Append an empty leaf to the node array and return its index.
+ */
+static int quadtree_new_node(Quadtree_t *tree, double centerX, double centerY, double halfSize)
+{
+	QuadtreeNode_t *node;
+
+	if (tree->count == tree->capacity)
+	{
+		tree->capacity *= 2;
+		tree->nodes = (QuadtreeNode_t *)realloc(tree->nodes, tree->capacity * sizeof(QuadtreeNode_t));
+	}
+
+	node = &tree->nodes[tree->count];
+	node->centerX = centerX;
+	node->centerY = centerY;
+	node->halfSize = halfSize;
+	node->mass = 0;
+	node->comX = 0;
+	node->comY = 0;
+	node->firstChild = -1;
+	node->particle = -1;
+
+	return tree->count++;
+}
+
+/*
+ * Get the index (0 to 3) of the child of a node containing the given point.
+ * bit 0 : right half, bit 1 : upper half
+ */
+static int quadtree_quadrant(QuadtreeNode_t *node, double x, double y)
+{
+	return (x >= node->centerX) | ((y >= node->centerY) << 1);
+}
+
+/*
+ * Split a leaf in 4 children (the children are always created after their parent, which build relies on).
+ */
+static void quadtree_subdivide(Quadtree_t *tree, int index)
+{
+	double centerX = tree->nodes[index].centerX;
+	double centerY = tree->nodes[index].centerY;
+	double quarter = tree->nodes[index].halfSize / 2;
+	int first;
+
+	first = quadtree_new_node(tree, centerX - quarter, centerY - quarter, quarter);
+	quadtree_new_node(tree, centerX + quarter, centerY - quarter, quarter);
+	quadtree_new_node(tree, centerX - quarter, centerY + quarter, quarter);
+	quadtree_new_node(tree, centerX + quarter, centerY + quarter, quarter);
+
+	//the nodes array may have moved, do not keep pointers across new_node calls
+	tree->nodes[index].firstChild = first;
+}
+
+/*
+ * Insert a particle in the tree. Leaves accumulate the mass weighted positions in comX/comY,
+ * they are divided by the mass once every particle is inserted.
+ */
+static void quadtree_insert(Quadtree_t *tree, int particle, double x, double y, double mass)
+{
+	int index = 0;
+	int depth = 0;
+
+	while (true)
+	{
+		QuadtreeNode_t *node = &tree->nodes[index];
+
+		if (node->firstChild >= 0)
+		{
+			index = node->firstChild + quadtree_quadrant(node, x, y);
+			depth++;
+		}
+		else if (node->particle < 0 || depth >= QUADTREE_MAX_DEPTH)
+		{
+			//empty leaf, or leaf too small to be split again (particles at the same position share it)
+			if (node->particle < 0)
+			{
+				node->particle = particle;
+			}
+			node->mass += mass;
+			node->comX += x * mass;
+			node->comY += y * mass;
+			return;
+		}
+		else
+		{
+			//occupied leaf : split it and push its particle one level down
+			int moved = node->particle;
+			double movedMass = node->mass;
+			double movedX = node->comX / movedMass;
+			double movedY = node->comY / movedMass;
+			int child;
+
+			quadtree_subdivide(tree, index);
+			node = &tree->nodes[index];
+			node->particle = -1;
+			node->mass = 0;
+			node->comX = 0;
+			node->comY = 0;
+
+			child = node->firstChild + quadtree_quadrant(node, movedX, movedY);
+			tree->nodes[child].particle = moved;
+			tree->nodes[child].mass = movedMass;
+			tree->nodes[child].comX = movedX * movedMass;
+			tree->nodes[child].comY = movedY * movedMass;
+		}
+	}
+}
+
+void quadtree_build(Quadtree_t *tree, ParticleSystem_t *system)
+{
+	double minX, maxX, minY, maxY;
+	double halfSize;
+
+	tree->count = 0;
+
+	//find the bounding square of the particles (free slots of the system are skipped)
+	particle_system_bounds(system, 0, system->count, &minX, &minY, &maxX, &maxY);
+	halfSize = fmax(maxX - minX, maxY - minY) / 2;
+	//slightly enlarge the root so that the particles on the max bounds are inside it
+	halfSize = halfSize * (1 + 1e-9) + 1e-9;
+
+	quadtree_new_node(tree, (minX + maxX) / 2, (minY + maxY) / 2, halfSize);
+
+	for (size_t i = 0; i < system->count; i++)
+	{
+		if (system->mass[i] == 0)
+		{
+			continue;
+		}
+		quadtree_insert(tree, (int)i, system->x[i], system->y[i], system->mass[i]);
+	}
+
+	//compute the mass and center of mass of every node, going backward so that children are done before their parent
+	for (int i = tree->count - 1; i >= 0; i--)
+	{
+		QuadtreeNode_t *node = &tree->nodes[i];
+
+		if (node->firstChild >= 0)
+		{
+			node->mass = 0;
+			node->comX = 0;
+			node->comY = 0;
+			for (int c = node->firstChild; c < node->firstChild + 4; c++)
+			{
+				node->mass += tree->nodes[c].mass;
+				node->comX += tree->nodes[c].comX * tree->nodes[c].mass;
+				node->comY += tree->nodes[c].comY * tree->nodes[c].mass;
+			}
+		}
+		if (node->firstChild < 0 && node->particle >= 0 && node->mass == system->mass[node->particle])
+		{
+			//leaf of a single particle : its exact position (x * mass / mass can be 1 ulp away, and the particle would attract itself)
+			node->comX = system->x[node->particle];
+			node->comY = system->y[node->particle];
+		}
+		else if (node->mass > 0)
+		{
+			node->comX /= node->mass;
+			node->comY /= node->mass;
+		}
+	}
+}
+
+unsigned int quadtree_acceleration(Quadtree_t *tree, double x, double y, double theta, double *ax, double *ay)
+{
+	int stack[QUADTREE_STACK_SIZE];
+	int top = 0;
+	unsigned int interactions = 0;
+	double sumX = 0, sumY = 0;
+	double thetaSquared = theta * theta;
+
+	if (tree->count > 0)
+	{
+		stack[top++] = 0;
+	}
+
+	while (top > 0)
+	{
+		QuadtreeNode_t *node = &tree->nodes[stack[--top]];
+		double dx = node->comX - x;
+		double dy = node->comY - y;
+		double distanceSquared = dx * dx + dy * dy;
+		double size = 2 * node->halfSize;
+		bool inside = fabs(x - node->centerX) <= node->halfSize && fabs(y - node->centerY) <= node->halfSize;
+
+		if (node->mass == 0)
+		{
+			continue;
+		}
+
+		if (node->firstChild < 0 || (!inside && size * size < thetaSquared * distanceSquared))
+		{
+			//leaf or far enough node : use its center of mass (skip the particle itself)
+			if (distanceSquared > 0)
+			{
+				double inv = node->mass / (distanceSquared * sqrt(distanceSquared));
+				sumX += dx * inv;
+				sumY += dy * inv;
+				interactions++;
+			}
+		}
+		else
+		{
+			for (int c = node->firstChild; c < node->firstChild + 4; c++)
+			{
+				stack[top++] = c;
+			}
+		}
+	}
+
+	*ax = G * sumX;
+	*ay = G * sumY;
+
+	return interactions;
+}
+
+//arguments of the accelerations task
+typedef struct QuadtreeContext_s {
+	Quadtree_t *tree;
+	ParticleSystem_t *system;
+	double theta;
+} QuadtreeContext_t;
+
+static void quadtree_accelerations_task(void *context, int thread, size_t begin, size_t end)
+{
+	QuadtreeContext_t *arguments = (QuadtreeContext_t *)context;
+	ParticleSystem_t *system = arguments->system;
+	unsigned long long interactions = 0;
+
+	(void)thread;
+	for (size_t i = begin; i < end; i++)
+	{
+		interactions += quadtree_acceleration(arguments->tree, system->x[i], system->y[i], arguments->theta, &system->ax[i], &system->ay[i]);
+	}
+
+	//once per chunk, the order of the additions does not change the total
+	__atomic_fetch_add(&arguments->tree->interactions, interactions, __ATOMIC_RELAXED);
+}
+
+void quadtree_accelerations(Quadtree_t *tree, ParticleSystem_t *system, double theta, ThreadPool_t *pool)
+{
+	QuadtreeContext_t context = {tree, system, theta};
+
+	tree->interactions = 0;
+	thread_pool_parallel_for(pool, system->count, quadtree_accelerations_task, &context);
+}
+
+void quadtree_destroy(Quadtree_t *tree)
+{
+	free(tree->nodes);
+	free(tree);
+}
+
+//Build test : (mingw32-)gcc -o test.exe quadtree.c particle_system.c particle.c thread_pool.c gravity.c timer.c -lpthread -DUNIT_TESTS_Q
+#ifdef UNIT_TESTS_Q
+/* Start the overall test suite */
+START_TESTS()
+START_TEST("Mass and center of mass")
+Quadtree_t *tree = quadtree_initializer();
+ParticleSystem_t *system = particle_system_initializer(3);
+
+particle_system_add(system, 0, 0, 0, 0, 1);
+particle_system_add(system, 10, 0, 10, 0, 1);
+particle_system_add(system, 10, 10, 10, 10, 2);
+
+quadtree_build(tree, system);
+
+ASSERT_EQUALS_FLOAT(tree->nodes[0].mass, 4);
+ASSERT_EQUALS_FLOAT(tree->nodes[0].comX, 7.5);
+ASSERT_EQUALS_FLOAT(tree->nodes[0].comY, 5);
+
+particle_system_destroy(system);
+quadtree_destroy(tree);
+END_TEST()
+
+START_TEST("Same accelerations as the direct sum")
+Quadtree_t *tree = quadtree_initializer();
+ParticleSystem_t *system = particle_system_initializer(200);
+double *directX = (double *)malloc(200 * sizeof(double));
+double *directY = (double *)malloc(200 * sizeof(double));
+
+srand(42);
+for (size_t i = 0; i < 200; i++)
+{
+	double x = rand() % 1000 - 500, y = rand() % 1000 - 500;
+	particle_system_add(system, x, y, x, y, rand() % 10 + 1);
+}
+//two particles at the same position must not break the tree
+system->x[1] = system->x[0];
+system->y[1] = system->y[0];
+
+particle_system_accelerations_direct(system, NULL);
+for (size_t i = 0; i < 200; i++)
+{
+	directX[i] = system->ax[i];
+	directY[i] = system->ay[i];
+}
+
+quadtree_build(tree, system);
+
+for (size_t i = 2; i < 200; i += 17)
+{
+	double exactX, exactY, approximateX, approximateY;
+	double magnitude = sqrt(directX[i] * directX[i] + directY[i] * directY[i]);
+
+	quadtree_acceleration(tree, system->x[i], system->y[i], 0, &exactX, &exactY);
+	quadtree_acceleration(tree, system->x[i], system->y[i], QUADTREE_DEFAULT_THETA, &approximateX, &approximateY);
+
+	ASSERT_LESSTHAN(hypot(exactX - directX[i], exactY - directY[i]) / magnitude * 1e9, 1);
+	ASSERT_LESSTHAN(hypot(approximateX - directX[i], approximateY - directY[i]) / magnitude, 0.05);
+}
+
+free(directX);
+free(directY);
+particle_system_destroy(system);
+quadtree_destroy(tree);
+END_TEST()
+START_TEST("No self attraction with non integer positions")
+Quadtree_t *tree = quadtree_initializer();
+ParticleSystem_t *system = particle_system_initializer(3);
+double directX[3], directY[3];
+
+//0.1 * 3 / 3 != 0.1 in floating point
+particle_system_add(system, 0.1, 0.7, 0.1, 0.7, 3);
+particle_system_add(system, 100.3, 0.2, 100.3, 0.2, 7);
+particle_system_add(system, -50.9, 80.1, -50.9, 80.1, 9);
+particle_system_accelerations_direct(system, NULL);
+for (size_t i = 0; i < 3; i++)
+{
+	directX[i] = system->ax[i];
+	directY[i] = system->ay[i];
+}
+
+quadtree_build(tree, system);
+quadtree_accelerations(tree, system, 0, NULL);
+for (size_t i = 0; i < 3; i++)
+{
+	ASSERT_LESSTHAN(hypot(system->ax[i] - directX[i], system->ay[i] - directY[i]) / hypot(directX[i], directY[i]) * 1e9, 1);
+}
+
+particle_system_destroy(system);
+quadtree_destroy(tree);
+END_TEST()
+/* End the overall test suite */
+END_TESTS()
+#endif
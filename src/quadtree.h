@@ -0,0 +1,70 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Barnes-Hut quadtree (nodes are stored in a single growable array, children of a node are contiguous)
+*/
+#include <stddef.h>
+#include "particle.h"
+#include "particle_system.h"
+#include "thread_pool.h"
+
+#pragma once
+
+//maximum subdivision depth, particles closer than root size / 2^depth end up sharing a leaf
+#define QUADTREE_MAX_DEPTH 48
+//default opening angle (ratio node size / distance under which a node is approximated by its center of mass)
+#define QUADTREE_DEFAULT_THETA 0.5
+
+//Quadtree node
+typedef struct QuadtreeNode_s {
+	double centerX;
+	double centerY;
+	double halfSize;
+	double mass;
+	double comX; //center of mass
+	double comY;
+	int firstChild; //index of the first of the 4 children, -1 if the node is a leaf
+	int particle;	//index of the particle stored in the leaf, -1 if none
+} QuadtreeNode_t;
+
+//Quadtree
+typedef struct Quadtree_s {
+	QuadtreeNode_t *nodes;
+	int count;
+	int capacity;
+	unsigned long long interactions; //number of particle-node interactions computed by the last quadtree_accelerations
+} Quadtree_t;
+
+/**
+ * @brief Initializes a new empty Quadtree_t.
+ * @return Quadtree_t*
+ */
+Quadtree_t *quadtree_initializer(void);
+
+/**
+ * @brief Rebuild the quadtree over the positions of the particles of the system, then compute the mass and center of mass of every node.
+ * The node array is reused between calls and only grows.
+ * @return void
+ */
+void quadtree_build(Quadtree_t *tree, ParticleSystem_t *system);
+
+/**
+ * @brief Get the gravitational acceleration at a point caused by every particle in the tree.
+ * Nodes seen under an angle smaller than theta (size / distance < theta) are approximated by their center of mass,
+ * a theta of 0 gives the same result as the direct sum. Particles exactly at the point are skipped.
+ * @return unsigned int the number of nodes and particles used (interactions)
+ */
+unsigned int quadtree_acceleration(Quadtree_t *tree, double x, double y, double theta, double *ax, double *ay);
+
+/**
+ * @brief Compute the acceleration of every particle of the system with the tree (built over the same system), stores it in ax/ay.
+ * The particles are split between the threads of the pool (NULL to run on the calling thread only).
+ * @return void
+ */
+void quadtree_accelerations(Quadtree_t *tree, ParticleSystem_t *system, double theta, ThreadPool_t *pool);
+
+/**
+ * @brief Free the nodes and the Quadtree_t.
+ * @return void
+ */
+void quadtree_destroy(Quadtree_t *tree);
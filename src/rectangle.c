@@ -77,24 +77,11 @@ Rectangle_t *rect_initializer_primitive(double x, double y, double width, double
 
 void rect_transform(Rectangle_t *rect, Matrix_t *t)
 {
-	Matrix_t *tmp;
-
-	//modify corners and free older values
-	tmp = rect->ul;
-	rect->ul = matrix_multiply(t, rect->ul);
-	matrix_destroy(tmp);
-
-	tmp = rect->ur;
-	rect->ur = matrix_multiply(t, rect->ur);
-	matrix_destroy(tmp);
-
-	tmp = rect->lr;
-	rect->lr = matrix_multiply(t, rect->lr);
-	matrix_destroy(tmp);
-
-	tmp = rect->ll;
-	rect->ll = matrix_multiply(t, rect->ll);
-	matrix_destroy(tmp);
+	//modify corners in place
+	matrix_multiply_into(rect->ul, t, rect->ul);
+	matrix_multiply_into(rect->ur, t, rect->ur);
+	matrix_multiply_into(rect->lr, t, rect->lr);
+	matrix_multiply_into(rect->ll, t, rect->ll);
 
 	//recalculate x, y, width and height
 	// newRect.x = matrix_valueOf(&rect->ul, 0, 0);
@@ -106,27 +93,29 @@ void rect_transform(Rectangle_t *rect, Matrix_t *t)
 
 bool rect_axis_projection_overlap(Matrix_t *axis, Rectangle_t *a, Rectangle_t *b)
 {
-	Matrix_t *aulP, *aurP, *alrP, *allP, *bulP, *burP, *blrP, *bllP;
+	//projection of each corner computed on the stack (the axis is a 2d vector)
+	double values[3];
+	Matrix_t projection = matrix_wrap(values, 1, 3);
 	double tmp[4];
 	double maxA, minA, maxB, minB;
 
 	double den = pow(matrix_valueOf(axis, 0, 0), 2) + pow(matrix_valueOf(axis, 0, 1), 2);
 	double delta = (matrix_valueOf(a->ul, 0, 0) * matrix_valueOf(axis, 0, 0) + matrix_valueOf(a->ul, 0, 1) * matrix_valueOf(axis, 0, 1)) / den;
-	aulP = matrix_multiply_double(axis, delta);
+	matrix_multiply_double_into(&projection, axis, delta);
+	tmp[0] = matrix_vector2_dot_product(&projection, axis);
 
 	delta = (matrix_valueOf(a->ur, 0, 0) * matrix_valueOf(axis, 0, 0) + matrix_valueOf(a->ur, 0, 1) * matrix_valueOf(axis, 0, 1)) / den;
-	aurP = matrix_multiply_double(axis, delta);
+	matrix_multiply_double_into(&projection, axis, delta);
+	tmp[1] = matrix_vector2_dot_product(&projection, axis);
 
 	delta = (matrix_valueOf(a->lr, 0, 0) * matrix_valueOf(axis, 0, 0) + matrix_valueOf(a->lr, 0, 1) * matrix_valueOf(axis, 0, 1)) / den;
-	alrP = matrix_multiply_double(axis, delta);
+	matrix_multiply_double_into(&projection, axis, delta);
+	tmp[2] = matrix_vector2_dot_product(&projection, axis);
 
 	delta = (matrix_valueOf(a->ll, 0, 0) * matrix_valueOf(axis, 0, 0) + matrix_valueOf(a->ll, 0, 1) * matrix_valueOf(axis, 0, 1)) / den;
-	allP = matrix_multiply_double(axis, delta);
+	matrix_multiply_double_into(&projection, axis, delta);
+	tmp[3] = matrix_vector2_dot_product(&projection, axis);
 
-	tmp[0] = matrix_vector2_dot_product(aulP, axis);
-	tmp[1] = matrix_vector2_dot_product(aurP, axis);
-	tmp[2] = matrix_vector2_dot_product(alrP, axis);
-	tmp[3] = matrix_vector2_dot_product(allP, axis);
 	//init min and max
 	maxA = tmp[0];
 	minA = tmp[0];
@@ -145,21 +134,20 @@ bool rect_axis_projection_overlap(Matrix_t *axis, Rectangle_t *a, Rectangle_t *b
 	}
 
 	delta = (matrix_valueOf(b->ul, 0, 0) * matrix_valueOf(axis, 0, 0) + matrix_valueOf(b->ul, 0, 1) * matrix_valueOf(axis, 0, 1)) / den;
-	bulP = matrix_multiply_double(axis, delta);
+	matrix_multiply_double_into(&projection, axis, delta);
+	tmp[0] = matrix_vector2_dot_product(&projection, axis);
 
 	delta = (matrix_valueOf(b->ur, 0, 0) * matrix_valueOf(axis, 0, 0) + matrix_valueOf(b->ur, 0, 1) * matrix_valueOf(axis, 0, 1)) / den;
-	burP = matrix_multiply_double(axis, delta);
+	matrix_multiply_double_into(&projection, axis, delta);
+	tmp[1] = matrix_vector2_dot_product(&projection, axis);
 
 	delta = (matrix_valueOf(b->lr, 0, 0) * matrix_valueOf(axis, 0, 0) + matrix_valueOf(b->lr, 0, 1) * matrix_valueOf(axis, 0, 1)) / den;
-	blrP = matrix_multiply_double(axis, delta);
+	matrix_multiply_double_into(&projection, axis, delta);
+	tmp[2] = matrix_vector2_dot_product(&projection, axis);
 
 	delta = (matrix_valueOf(b->ll, 0, 0) * matrix_valueOf(axis, 0, 0) + matrix_valueOf(b->ll, 0, 1) * matrix_valueOf(axis, 0, 1)) / den;
-	bllP = matrix_multiply_double(axis, delta);
-
-	tmp[0] = matrix_vector2_dot_product(bulP, axis);
-	tmp[1] = matrix_vector2_dot_product(burP, axis);
-	tmp[2] = matrix_vector2_dot_product(blrP, axis);
-	tmp[3] = matrix_vector2_dot_product(bllP, axis);
+	matrix_multiply_double_into(&projection, axis, delta);
+	tmp[3] = matrix_vector2_dot_product(&projection, axis);
 
 	//init min and max
 	maxB = tmp[0];
@@ -178,16 +166,6 @@ bool rect_axis_projection_overlap(Matrix_t *axis, Rectangle_t *a, Rectangle_t *b
 		}
 	}
 
-	matrix_destroy(aulP);
-	matrix_destroy(aurP);
-	matrix_destroy(alrP);
-	matrix_destroy(allP);
-
-	matrix_destroy(bulP);
-	matrix_destroy(burP);
-	matrix_destroy(blrP);
-	matrix_destroy(bllP);
-
 	//printf("B : %f < %f   |   A: %f < %f\n", minB,maxB, minA,maxA);
 	//return if the projection overlaps
 	return !(minB <= maxA && maxB >= minA);
@@ -195,43 +173,37 @@ bool rect_axis_projection_overlap(Matrix_t *axis, Rectangle_t *a, Rectangle_t *b
 
 bool rect_intersect(Rectangle_t *a, Rectangle_t *b)
 {
-	Matrix_t *a1, *a2, *a3, *a4;
+	//axis computed on the stack and reused for the 4 projections
+	double values[3];
+	Matrix_t axis = matrix_wrap(values, 1, 3);
 
 	//check if the first axis projection overlaps
-	a1 = matrix_sub(a->ur, a->ul);
-	if (rect_axis_projection_overlap(a1, a, b))
+	matrix_sub_into(&axis, a->ur, a->ul);
+	if (rect_axis_projection_overlap(&axis, a, b))
 	{
-		matrix_destroy(a1);
 		return false;
 	}
-	matrix_destroy(a1);
 
 	//check if the 2nd axis projection overlaps
-	a2 = matrix_sub(a->ur, a->lr);
-	if (rect_axis_projection_overlap(a2, a, b))
+	matrix_sub_into(&axis, a->ur, a->lr);
+	if (rect_axis_projection_overlap(&axis, a, b))
 	{
-		matrix_destroy(a2);
 		return false;
 	}
-	matrix_destroy(a2);
 
 	//check if the 3rd axis projection overlaps
-	a3 = matrix_sub(b->ur, b->ul);
-	if (rect_axis_projection_overlap(a3, a, b))
+	matrix_sub_into(&axis, b->ur, b->ul);
+	if (rect_axis_projection_overlap(&axis, a, b))
 	{
-		matrix_destroy(a3);
 		return false;
 	}
-	matrix_destroy(a3);
 
 	//check if the 4th axis projection overlaps
-	a4 = matrix_sub(b->ur, b->lr);
-	if (rect_axis_projection_overlap(a4, a, b))
+	matrix_sub_into(&axis, b->ur, b->lr);
+	if (rect_axis_projection_overlap(&axis, a, b))
 	{
-		matrix_destroy(a4);
 		return false;
 	}
-	matrix_destroy(a4);
 
 	return true;
 }
@@ -355,6 +327,41 @@ matrix_destroy(eur);
 matrix_destroy(elr);
 matrix_destroy(ell);
 
+END_TEST()
+
+START_TEST("Intersection and transformation without temporary matrices")
+MatrixArena_t *arena = matrix_arena_initializer(MATRIX_ARENA_DEFAULT_SIZE);
+Matrix_t *scale;
+Rectangle_t *a, *b, *c;
+size_t used;
+
+matrix_arena_use(arena);
+a = rect_initializer_primitive(0, 0, 10, 10);
+b = rect_initializer_primitive(5, -5, 10, 10);
+c = rect_initializer_primitive(20, 0, 1, 1);
+scale = matrix_initializer(3, 3);
+*matrix_addressOf(scale, 0, 0) = 0.5;
+*matrix_addressOf(scale, 1, 1) = 0.5;
+*matrix_addressOf(scale, 2, 2) = 1;
+ASSERT(a->ul->arena == arena);
+used = matrix_arena_used(arena);
+
+ASSERT(rect_intersect(a, b));
+ASSERT(!rect_intersect(a, c));
+//the axes and projections are on the stack and the corners are transformed in place
+rect_transform(c, scale);
+ASSERT(matrix_valueOf(c->ul, 0, 0) == 10 && matrix_valueOf(c->lr, 0, 1) == -0.5);
+ASSERT(rect_intersect(a, c));
+ASSERT(matrix_arena_used(arena) == used);
+
+//the rectangles themselves are on the heap, their corners are left to the arena
+rect_destroy(a);
+rect_destroy(b);
+rect_destroy(c);
+matrix_arena_reset(arena);
+ASSERT(matrix_arena_used(arena) == 0);
+matrix_arena_use(NULL);
+matrix_arena_destroy(arena);
 END_TEST()
 /* End the overall test suite */
 END_TESTS()
@@ -0,0 +1,678 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Simulation state (particles, black hole, solver settings) and the physics step, independent from SDL
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "matrix.h"
+#include "particle.h"
+#include "particle_system.h"
+#include "quadtree.h"
+#include "particle_mesh.h"
+#include "block_steps.h"
+#include "thread_pool.h"
+#include "profiler.h"
+#include "trace.h"
+#include "simulation.h"
+#include "tests.h"
+
+#define E_PI 3.1415926535897932384626433832795028841971693993751058209749445923078164062
+
+static const char *s_solverNames[SOLVER_COUNT] = {"direct", "barnes-hut", "particle-mesh"};
+static const char *s_integratorNames[INTEGRATOR_COUNT] = {"verlet", "leapfrog", "yoshida"};
+
+Simulation_t *simulation_initializer(int threadCount)
+{
+	Simulation_t *simulation = (Simulation_t *)malloc(sizeof(Simulation_t));
+
+	simulation->particles = particle_system_initializer(0);
+	simulation->blackHole = particle_initializer(vector2(0, 0), vector2(0, 0), SIMULATION_BLACK_HOLE_MASS);
+	simulation->solver = SOLVER_DIRECT;
+	simulation->integrator = INTEGRATOR_VERLET;
+	simulation->velocitiesReady = false;
+	simulation->accelerationsReady = false;
+	simulation->theta = QUADTREE_DEFAULT_THETA;
+	simulation->meshSize = PARTICLE_MESH_DEFAULT_SIZE;
+	simulation->blockLevels = 0;
+	simulation->blockEta = BLOCK_STEPS_DEFAULT_ETA;
+	simulation->reorderInterval = SIMULATION_DEFAULT_REORDER_INTERVAL;
+	simulation->timeStep = SIMULATION_DEFAULT_TIME_STEP;
+	simulation->step = 0;
+	simulation->quadtree = quadtree_initializer();
+	simulation->mesh = NULL;
+	simulation->blocks = NULL;
+	simulation->pool = thread_pool_initializer(threadCount);
+	simulation->profiler = NULL;
+
+	return simulation;
+}
+
+void simulation_populate(Simulation_t *simulation, size_t count, int halfWidth, int halfHeight, unsigned int seed)
+{
+	srand(seed);
+	particle_system_reserve(simulation->particles, simulation->particles->count + count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		//continuous positions, integer ones put several particles at the same place once count gets close to the area
+		double x = (rand() / (RAND_MAX + 1.0) * 2 - 1) * halfWidth;
+		double y = (rand() / (RAND_MAX + 1.0) * 2 - 1) * halfHeight;
+
+		simulation_spawn(simulation, x, y, rand() % (SIMULATION_MAX_MASS - SIMULATION_MIN_MASS) + SIMULATION_MIN_MASS);
+	}
+}
+
+size_t simulation_spawn(Simulation_t *simulation, double x, double y, double mass)
+{
+	Vector2_t tmpInitial = vector2(x, y);
+	Particle_t *particle;
+	size_t index;
+
+	//initialise particle with no speed
+	particle = particle_initializer(vector2(0, 0), tmpInitial, mass);
+
+	//compute the orbital velocity and angle needed for a circular orbit
+	Vector2_t force = gravitational_force(particle, simulation->blackHole);
+	Vector2_t acceleration = vector2_multiply_double(force, 1 / particle->mass);
+
+	double orbitalVelocity = sqrt(vector2_magnitude(acceleration) * vector2_distance(tmpInitial, simulation->blackHole->pos));
+	double angle = atan2(tmpInitial.y, tmpInitial.x) + E_PI / 2;
+
+	particle_updatePosition(particle, vector2(tmpInitial.x + orbitalVelocity * simulation->timeStep * cos(angle), tmpInitial.y + orbitalVelocity * simulation->timeStep * sin(angle)));
+	index = particle_system_add_particle(simulation->particles, particle);
+	//the velocity of the leapfrog integrators is the orbital one, the velocities of the others are kept but not their accelerations
+	simulation->particles->vx[index] = orbitalVelocity * cos(angle);
+	simulation->particles->vy[index] = orbitalVelocity * sin(angle);
+	simulation->accelerationsReady = false;
+	if (simulation->blocks != NULL)
+	{
+		//the slot may have been used by a removed particle
+		block_steps_forget(simulation->blocks, index);
+	}
+
+	particle_destroy(particle);
+
+	return index;
+}
+
+bool simulation_despawn_nearest(Simulation_t *simulation, double x, double y, double radius)
+{
+	ParticleSystem_t *particles = simulation->particles;
+	double bestDistanceSquared = radius * radius;
+	size_t best = particles->count;
+
+	for (size_t i = 0; i < particles->count; i++)
+	{
+		double dx = particles->x[i] - x;
+		double dy = particles->y[i] - y;
+		double distanceSquared = dx * dx + dy * dy;
+
+		if (particle_system_alive(particles, i) && distanceSquared <= bestDistanceSquared)
+		{
+			bestDistanceSquared = distanceSquared;
+			best = i;
+		}
+	}
+
+	if (best == particles->count)
+	{
+		return false;
+	}
+
+	particle_system_remove(particles, best);
+	//the accelerations of the others are not the same anymore, their velocities are
+	simulation->accelerationsReady = false;
+	return true;
+}
+
+/*
+ * Acceleration of every particle (gravity of the other particles with the solver, and of the black hole), stored in ax/ay.
+ */
+static void simulation_accelerations(Simulation_t *simulation)
+{
+	ParticleSystem_t *particles = simulation->particles;
+
+	profiler_begin(simulation->profiler, "forces");
+	TRACE_BEGIN("forces");
+	if (simulation->solver == SOLVER_BARNES_HUT)
+	{
+		//approximate the gravity forces of far groups of particles with the quadtree
+		quadtree_build(simulation->quadtree, particles);
+		quadtree_accelerations(simulation->quadtree, particles, simulation->theta, simulation->pool);
+	}
+	else if (simulation->solver == SOLVER_PARTICLE_MESH)
+	{
+		//interpolate the gradient of the potential of the masses assigned to a grid
+		particle_mesh_accelerations(simulation_mesh(simulation), particles, simulation->pool);
+	}
+	else
+	{
+		particle_system_accelerations_direct(particles, simulation->pool);
+	}
+
+	//add the gravity force of the black hole
+	particle_system_add_attraction(particles, simulation->blackHole, simulation->pool);
+	TRACE_END("forces");
+	profiler_end(simulation->profiler, "forces");
+}
+
+/*
+ * Kick-drift-kick leapfrog sub-step of timeStep, the accelerations in ax/ay have to be the ones of the current positions.
+ */
+static void simulation_leapfrog(Simulation_t *simulation, double timeStep)
+{
+	PROFILER_SCOPE(simulation->profiler, "integration") TRACE_SCOPE("integration")
+	{
+		particle_system_kick(simulation->particles, timeStep / 2, simulation->pool);
+		particle_system_drift(simulation->particles, timeStep, simulation->pool);
+	}
+	simulation_accelerations(simulation);
+	PROFILER_SCOPE(simulation->profiler, "integration") TRACE_SCOPE("integration")
+	{
+		particle_system_kick(simulation->particles, timeStep / 2, simulation->pool);
+	}
+}
+
+void simulation_step(Simulation_t *simulation)
+{
+	ParticleSystem_t *particles = simulation->particles;
+
+	//close the holes left by the removed particles once there are too many of them (they still cost a slot in every loop)
+	if (particle_system_needs_compaction(particles))
+	{
+		particle_system_compact(particles);
+		if (simulation->blocks != NULL)
+		{
+			block_steps_forget_all(simulation->blocks);
+		}
+	}
+
+	//the particles drift away from their neighbours in memory as they move : sorted again from time to time so that the solvers
+	//walking the space (quadtree, grid) find the particles of a region next to each other
+	if (simulation->reorderInterval > 0 && simulation->step % simulation->reorderInterval == 0)
+	{
+		PROFILER_SCOPE(simulation->profiler, "reorder") TRACE_SCOPE("reorder")
+		{
+			particle_system_sort_morton(particles, simulation->pool);
+			if (simulation->blocks != NULL)
+			{
+				block_steps_permute(simulation->blocks, particles->order, particles->count);
+			}
+		}
+	}
+
+	//individual time steps : the block steps compute the forces of the particles moving at each of their ticks
+	if (simulation->blockLevels > 0)
+	{
+		if (simulation->blocks == NULL)
+		{
+			simulation->blocks = block_steps_initializer();
+		}
+		PROFILER_SCOPE(simulation->profiler, "block steps") TRACE_SCOPE("block steps")
+		{
+			block_steps_advance(simulation->blocks, simulation);
+		}
+		simulation->velocitiesReady = false;
+		simulation->accelerationsReady = false;
+		simulation->step++;
+		return;
+	}
+
+	if (simulation->integrator == INTEGRATOR_VERLET)
+	{
+		simulation_accelerations(simulation);
+
+		//compute the next position of every particle (2x(tj) - x(tj-1) + a(tj)*deltaT^2)
+		PROFILER_SCOPE(simulation->profiler, "integration") TRACE_SCOPE("integration")
+		{
+			particle_system_step(particles, simulation->timeStep, simulation->pool);
+		}
+		simulation->velocitiesReady = false;
+		simulation->accelerationsReady = false;
+		simulation->step++;
+		return;
+	}
+
+	if (!simulation->velocitiesReady)
+	{
+		//first leapfrog step (or the particles changed) : velocities from the last two positions
+		simulation_accelerations(simulation);
+		particle_system_velocities_from_positions(particles, simulation->timeStep, simulation->pool);
+		simulation->velocitiesReady = true;
+		simulation->accelerationsReady = true;
+	}
+	else if (!simulation->accelerationsReady)
+	{
+		//particles added or removed since the last step : the forces changed, not the velocities
+		simulation_accelerations(simulation);
+		simulation->accelerationsReady = true;
+	}
+
+	//the positions one step before, for the interpolation of the renderer and the checkpoints
+	memcpy(particles->lastX, particles->x, particles->count * sizeof(double));
+	memcpy(particles->lastY, particles->y, particles->count * sizeof(double));
+
+	if (simulation->integrator == INTEGRATOR_YOSHIDA)
+	{
+		//symmetric composition of 3 leapfrog sub-steps cancelling their 3rd order errors, the middle one goes backward in time
+		const double cubeRoot = cbrt(2.0);
+		const double outer = 1 / (2 - cubeRoot);
+		const double inner = -cubeRoot / (2 - cubeRoot);
+
+		simulation_leapfrog(simulation, outer * simulation->timeStep);
+		simulation_leapfrog(simulation, inner * simulation->timeStep);
+		simulation_leapfrog(simulation, outer * simulation->timeStep);
+	}
+	else
+	{
+		simulation_leapfrog(simulation, simulation->timeStep);
+	}
+
+	simulation->step++;
+}
+
+ParticleMesh_t *simulation_mesh(Simulation_t *simulation)
+{
+	if (simulation->mesh == NULL || simulation->mesh->size != simulation->meshSize)
+	{
+		if (simulation->mesh != NULL)
+		{
+			particle_mesh_destroy(simulation->mesh);
+		}
+		simulation->mesh = particle_mesh_initializer(simulation->meshSize);
+	}
+
+	return simulation->mesh;
+}
+
+//arguments of the energy task
+typedef struct EnergyContext_s {
+	Simulation_t *simulation;
+	double *partial; //one sum per thread
+} EnergyContext_t;
+
+/*
+ * Energy of the particles [begin, end) : kinetic energy, potential energy with the black hole, and half of the potential energy
+ * with every other particle (each pair is seen from both sides).
+ */
+static void simulation_energy_task(void *context, int thread, size_t begin, size_t end)
+{
+	Simulation_t *simulation = ((EnergyContext_t *)context)->simulation;
+	ParticleSystem_t *particles = simulation->particles;
+	Particle_t *blackHole = simulation->blackHole;
+	double sum = 0;
+
+	for (size_t i = begin; i < end; i++)
+	{
+		//velocity of the leapfrog integrators, or estimated from the two last positions of the Verlet scheme
+		double vx = simulation->velocitiesReady ? particles->vx[i] : (particles->x[i] - particles->lastX[i]) / simulation->timeStep;
+		double vy = simulation->velocitiesReady ? particles->vy[i] : (particles->y[i] - particles->lastY[i]) / simulation->timeStep;
+		double pairs = 0;
+
+		if (particles->mass[i] == 0)
+		{
+			continue;
+		}
+
+		for (size_t j = 0; j < particles->count; j++)
+		{
+			double dx = particles->x[j] - particles->x[i];
+			double dy = particles->y[j] - particles->y[i];
+			double distanceSquared = dx * dx + dy * dy;
+
+			if (distanceSquared > 0)
+			{
+				pairs += particles->mass[j] / sqrt(distanceSquared);
+			}
+		}
+
+		sum += 0.5 * particles->mass[i] * (vx * vx + vy * vy);
+		sum -= G * particles->mass[i] * (0.5 * pairs + blackHole->mass / hypot(particles->x[i] - blackHole->pos.x, particles->y[i] - blackHole->pos.y));
+	}
+
+	((EnergyContext_t *)context)->partial[thread] = sum;
+}
+
+double simulation_energy(Simulation_t *simulation)
+{
+	int threadCount = thread_pool_thread_count(simulation->pool);
+	double *partial = (double *)calloc(threadCount, sizeof(double));
+	EnergyContext_t context = {simulation, partial};
+	double energy = 0;
+
+	thread_pool_parallel_for(simulation->pool, simulation->particles->count, simulation_energy_task, &context);
+	//always summed in the same order, the result does not depend on the scheduling
+	for (int i = 0; i < threadCount; i++)
+	{
+		energy += partial[i];
+	}
+
+	free(partial);
+	return energy;
+}
+
+const char *simulation_solver_name(Solver_t solver)
+{
+	return solver >= 0 && solver < SOLVER_COUNT ? s_solverNames[solver] : "unknown";
+}
+
+bool simulation_solver_from_name(const char *name, Solver_t *solver)
+{
+	for (int i = 0; i < SOLVER_COUNT; i++)
+	{
+		if (strcmp(name, s_solverNames[i]) == 0)
+		{
+			*solver = (Solver_t)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char *simulation_integrator_name(Integrator_t integrator)
+{
+	return integrator >= 0 && integrator < INTEGRATOR_COUNT ? s_integratorNames[integrator] : "unknown";
+}
+
+bool simulation_integrator_from_name(const char *name, Integrator_t *integrator)
+{
+	for (int i = 0; i < INTEGRATOR_COUNT; i++)
+	{
+		if (strcmp(name, s_integratorNames[i]) == 0)
+		{
+			*integrator = (Integrator_t)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+void simulation_destroy(Simulation_t *simulation)
+{
+	particle_system_destroy(simulation->particles);
+	particle_destroy(simulation->blackHole);
+	quadtree_destroy(simulation->quadtree);
+	if (simulation->mesh != NULL)
+	{
+		particle_mesh_destroy(simulation->mesh);
+	}
+	if (simulation->blocks != NULL)
+	{
+		block_steps_destroy(simulation->blocks);
+	}
+	thread_pool_destroy(simulation->pool);
+	free(simulation);
+}
+
+//Build test : (mingw32-)gcc -o test.exe simulation.c block_steps.c particle_system.c particle.c quadtree.c particle_mesh.c thread_pool.c gravity.c profiler.c timer.c -lpthread -DUNIT_TESTS_S
+#ifdef UNIT_TESTS_S
+/* Start the overall test suite */
+START_TESTS()
+START_TEST("Circular orbits stay around their radius")
+Simulation_t *simulation = simulation_initializer(2);
+double *radius = (double *)malloc(100 * sizeof(double));
+double maxDrift = 0;
+
+simulation_populate(simulation, 100, 640, 360, 1);
+ASSERT(simulation->particles->count == 100);
+
+for (size_t i = 0; i < 100; i++)
+{
+	radius[i] = hypot(simulation->particles->x[i], simulation->particles->y[i]);
+}
+for (int step = 0; step < 10; step++)
+{
+	simulation_step(simulation);
+}
+ASSERT(simulation->step == 10);
+
+//the black hole dominates, the particles have to stay close to their initial orbit (the particles were sorted, their ids did not change)
+for (size_t i = 0; i < 100; i++)
+{
+	size_t slot = simulation->particles->slots[i];
+
+	maxDrift = fmax(maxDrift, fabs(hypot(simulation->particles->x[slot], simulation->particles->y[slot]) - radius[i]) / radius[i]);
+}
+ASSERT_LESSTHAN(maxDrift, 0.05);
+
+free(radius);
+simulation_destroy(simulation);
+END_TEST()
+
+START_TEST("Particle-mesh solver")
+Simulation_t *simulation = simulation_initializer(2);
+Simulation_t *direct = simulation_initializer(2);
+double maxDifference = 0;
+
+//same steps as the direct sum (the black hole dominates the forces of the other particles anyway)
+simulation->solver = SOLVER_PARTICLE_MESH;
+simulation->meshSize = 64;
+simulation_populate(simulation, 1000, 640, 360, 1);
+simulation_populate(direct, 1000, 640, 360, 1);
+for (int step = 0; step < 10; step++)
+{
+	simulation_step(simulation);
+	simulation_step(direct);
+}
+ASSERT(simulation->mesh != NULL && simulation->mesh->size == 64);
+for (size_t i = 0; i < 1000; i++)
+{
+	size_t slot = simulation->particles->slots[i], directSlot = direct->particles->slots[i];
+
+	maxDifference = fmax(maxDifference, hypot(simulation->particles->x[slot] - direct->particles->x[directSlot], simulation->particles->y[slot] - direct->particles->y[directSlot]));
+}
+ASSERT_LESSTHAN(maxDifference, 1e-3);
+
+//the grid is rebuilt when its size changes
+simulation->meshSize = 32;
+simulation_step(simulation);
+ASSERT(simulation->mesh->size == 32);
+
+simulation_destroy(direct);
+simulation_destroy(simulation);
+END_TEST()
+
+START_TEST("Block time steps")
+Simulation_t *runs[3];
+double radii[3] = {24, 100, 500};
+double gm = G * SIMULATION_BLACK_HOLE_MASS;
+double errors[3][3];
+unsigned long long evaluations = 0;
+
+//three circular orbits : the close one needs steps 16 times shorter, the far one is fine with the time step of the simulation.
+//Plain steps of 10, plain steps of 10 / 16 and block steps of 10 down to 10 / 16
+for (int run = 0; run < 3; run++)
+{
+	double timeStep = run == 1 ? 10.0 / 16 : 10;
+
+	runs[run] = simulation_initializer(2);
+	runs[run]->timeStep = timeStep;
+	runs[run]->blockLevels = run == 2 ? 4 : 0;
+	for (int k = 0; k < 3; k++)
+	{
+		double velocity = sqrt(gm / radii[k]);
+		double acceleration = gm / (radii[k] * radii[k]);
+
+		particle_system_add(runs[run]->particles, radii[k] - acceleration * timeStep * timeStep / 2, -velocity * timeStep, radii[k], 0, 1e-9);
+	}
+	for (int step = 0; step < (run == 1 ? 3200 : 200); step++)
+	{
+		simulation_step(runs[run]);
+		evaluations += run == 2 ? runs[run]->blocks->evaluations : 0;
+	}
+	for (int k = 0; k < 3; k++)
+	{
+		double angle = sqrt(gm / (radii[k] * radii[k] * radii[k])) * 2000;
+		size_t slot = runs[run]->particles->slots[k];
+
+		errors[run][k] = hypot(runs[run]->particles->x[slot] - radii[k] * cos(angle), runs[run]->particles->y[slot] - radii[k] * sin(angle));
+	}
+}
+
+//as accurate as the short steps for the close orbit, as the plain steps for the far one, with fewer accelerations computed
+ASSERT_LESSTHAN(errors[2][0], errors[1][0] * 1.5);
+ASSERT_LESSTHAN(errors[2][0] * 10, errors[0][0]);
+ASSERT_LESSTHAN(errors[2][2], errors[0][2] * 1.01);
+ASSERT_LESSTHAN(evaluations, 3200 * 3 / 2);
+ASSERT(runs[2]->blocks->levelCounts[4] == 1 && runs[2]->blocks->levelCounts[0] == 1);
+ASSERT(runs[2]->step == 200);
+
+//everything at level 0 : one acceleration per particle and per step like the plain steps
+runs[2]->blockEta = 1e9;
+simulation_step(runs[2]);
+simulation_step(runs[2]);
+ASSERT(runs[2]->blocks->levelCounts[0] == 3 && runs[2]->blocks->evaluations == 3);
+
+for (int run = 0; run < 3; run++)
+{
+	simulation_destroy(runs[run]);
+}
+END_TEST()
+
+START_TEST("Leapfrog and Yoshida integrators")
+double gm = G * SIMULATION_BLACK_HOLE_MASS;
+double velocity = sqrt(gm / 100), acceleration = gm / (100 * 100);
+double angle = sqrt(gm / (100 * 100 * 100)) * 4000;
+double errors[INTEGRATOR_COUNT];
+Integrator_t integrator;
+
+//circular orbit of radius 100 during 4000 : Verlet and leapfrog with steps of 10, Yoshida with steps of 40
+for (int i = 0; i < INTEGRATOR_COUNT; i++)
+{
+	Simulation_t *simulation = simulation_initializer(1);
+	double timeStep = i == INTEGRATOR_YOSHIDA ? 40 : 10;
+	double energy;
+
+	simulation->integrator = (Integrator_t)i;
+	simulation->timeStep = timeStep;
+	particle_system_add(simulation->particles, 100 - acceleration * timeStep * timeStep / 2, -velocity * timeStep, 100, 0, 1);
+	simulation_step(simulation);
+	ASSERT(simulation->velocitiesReady == (i != INTEGRATOR_VERLET));
+	energy = simulation_energy(simulation);
+	while (simulation->step * timeStep < 4000)
+	{
+		simulation_step(simulation);
+	}
+	ASSERT_LESSTHAN(fabs(simulation_energy(simulation) - energy) / fabs(energy), 1e-4);
+	//lastX/lastY are the positions one step before with every integrator
+	ASSERT_LESSTHAN(fabs(hypot(simulation->particles->lastX[0], simulation->particles->lastY[0]) - 100), 0.5);
+	errors[i] = hypot(simulation->particles->x[0] - 100 * cos(angle), simulation->particles->y[0] - 100 * sin(angle));
+
+	//a spawn gives its orbital velocity to the new particle and makes the next step compute the accelerations again,
+	//the velocities of the others are kept
+	double vx = simulation->particles->vx[0], vy = simulation->particles->vy[0];
+	size_t spawned = simulation_spawn(simulation, 200, 0, 1);
+	ASSERT(simulation->velocitiesReady == (i != INTEGRATOR_VERLET));
+	ASSERT(!simulation->accelerationsReady);
+	ASSERT(simulation->particles->vx[0] == vx && simulation->particles->vy[0] == vy);
+	ASSERT_LESSTHAN(fabs(simulation->particles->vy[spawned] - sqrt(gm / 200)), 1e-9);
+	simulation_step(simulation);
+	ASSERT(simulation->accelerationsReady == (i != INTEGRATOR_VERLET));
+	simulation_destroy(simulation);
+}
+
+//same trajectory for the two second order integrators, the 4th order one is more accurate with 3 evaluations per 40 instead of 4
+ASSERT_LESSTHAN(fabs(errors[INTEGRATOR_LEAPFROG] - errors[INTEGRATOR_VERLET]), errors[INTEGRATOR_VERLET] * 0.01);
+ASSERT_LESSTHAN(errors[INTEGRATOR_YOSHIDA] * 2, errors[INTEGRATOR_LEAPFROG]);
+
+ASSERT(simulation_integrator_from_name("yoshida", &integrator) && integrator == INTEGRATOR_YOSHIDA);
+ASSERT(!simulation_integrator_from_name("euler", &integrator));
+ASSERT(strcmp(simulation_integrator_name(INTEGRATOR_LEAPFROG), "leapfrog") == 0);
+END_TEST()
+
+START_TEST("Morton reorder")
+double maxDifference = 0;
+bool identity = true;
+
+//sorted at every step or never, with the velocities of the leapfrog and the levels of the block time steps moved along :
+//the same trajectories for the same ids (up to the rounding of the sums of the forces done in another order)
+for (int run = 0; run < 2; run++)
+{
+	Simulation_t *sorted = simulation_initializer(2);
+	Simulation_t *unsorted = simulation_initializer(2);
+
+	sorted->reorderInterval = 1;
+	unsorted->reorderInterval = 0;
+	sorted->integrator = unsorted->integrator = INTEGRATOR_LEAPFROG;
+	sorted->blockLevels = unsorted->blockLevels = run == 1 ? 3 : 0;
+	simulation_populate(sorted, 500, 640, 360, 2);
+	simulation_populate(unsorted, 500, 640, 360, 2);
+	for (int step = 0; step < 20; step++)
+	{
+		simulation_step(sorted);
+		simulation_step(unsorted);
+	}
+	for (size_t i = 0; i < 500; i++)
+	{
+		size_t slot = sorted->particles->slots[i];
+
+		identity = identity && unsorted->particles->slots[i] == i;
+		maxDifference = fmax(maxDifference, hypot(sorted->particles->x[slot] - unsorted->particles->x[i], sorted->particles->y[slot] - unsorted->particles->y[i]));
+	}
+	simulation_destroy(sorted);
+	simulation_destroy(unsorted);
+}
+ASSERT(identity);
+ASSERT_LESSTHAN(maxDifference, 1e-6);
+END_TEST()
+
+START_TEST("Spawn and despawn")
+Simulation_t *simulation = simulation_initializer(1);
+size_t index;
+
+simulation_populate(simulation, 10, 640, 360, 1);
+index = simulation_spawn(simulation, 100, 0, 5);
+ASSERT(index == 10);
+//circular orbit : moving along y only
+ASSERT(simulation->particles->lastX[index] == 100);
+ASSERT(simulation->particles->lastY[index] == 0 && simulation->particles->y[index] > 0);
+
+ASSERT(!simulation_despawn_nearest(simulation, 2000, 2000, 10));
+ASSERT(simulation_despawn_nearest(simulation, 101, 0, 10));
+ASSERT(!particle_system_alive(simulation->particles, index));
+
+//compaction during the step once a quarter of the slots are free
+for (size_t i = 0; i < 5; i++)
+{
+	particle_system_remove(simulation->particles, i);
+}
+ASSERT(simulation->particles->freeCount == 5);
+simulation_step(simulation);
+ASSERT(simulation->particles->count == 5);
+ASSERT(simulation->particles->freeCount == 0);
+
+simulation_destroy(simulation);
+END_TEST()
+
+START_TEST("Energy")
+Simulation_t *simulation = simulation_initializer(3);
+double expected;
+
+//two particles at rest 10 apart on the x axis, at 100 and 110 from the black hole
+particle_system_add(simulation->particles, 100, 0, 100, 0, 2);
+particle_system_add(simulation->particles, 110, 0, 110, 0, 3);
+expected = -G * (2 * 3 / 10.0 + SIMULATION_BLACK_HOLE_MASS * (2 / 100.0 + 3 / 110.0));
+ASSERT_LESSTHAN(fabs(simulation_energy(simulation) - expected) / fabs(expected) * 1e12, 1);
+
+//moving by 1 per step of 10 : kinetic energy 0.5 * 2 * 0.1^2
+simulation->particles->lastX[0] = 99;
+expected += 0.5 * 2 * 0.01;
+ASSERT_LESSTHAN(fabs(simulation_energy(simulation) - expected) / fabs(expected) * 1e12, 1);
+
+simulation_destroy(simulation);
+END_TEST()
+
+START_TEST("Solver names")
+Solver_t solver;
+
+ASSERT(simulation_solver_from_name("barnes-hut", &solver) && solver == SOLVER_BARNES_HUT);
+ASSERT(simulation_solver_from_name("particle-mesh", &solver) && solver == SOLVER_PARTICLE_MESH);
+ASSERT(!simulation_solver_from_name("fmm", &solver));
+ASSERT(strcmp(simulation_solver_name(SOLVER_DIRECT), "direct") == 0);
+END_TEST()
+/* End the overall test suite */
+END_TESTS()
+#endif
@@ -0,0 +1,140 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Simulation state (particles, black hole, solver settings) and the physics step, independent from SDL
+*/
+#include <stddef.h>
+#include <stdbool.h>
+#include "particle.h"
+#include "particle_system.h"
+#include "quadtree.h"
+#include "particle_mesh.h"
+#include "block_steps.h"
+#include "thread_pool.h"
+#include "profiler.h"
+
+#pragma once
+
+#define SIMULATION_MIN_MASS 1
+#define SIMULATION_MAX_MASS 10
+#define SIMULATION_BLACK_HOLE_MASS 1e11
+#define SIMULATION_DEFAULT_TIME_STEP 10
+//steps between two Morton sorts of the particles
+#define SIMULATION_DEFAULT_REORDER_INTERVAL 32
+
+//gravity solvers available for the physics step
+typedef enum Solver_e {
+	SOLVER_DIRECT,	   //O(N^2) sum over every pair
+	SOLVER_BARNES_HUT, //O(N log N) quadtree approximation
+	SOLVER_PARTICLE_MESH, //O(N + M log M) grid of M cells, smooths the forces under a few cells
+	SOLVER_COUNT
+} Solver_t;
+
+//integrators available for the physics step
+typedef enum Integrator_e {
+	INTEGRATOR_VERLET,	 //position Verlet from the last two positions, 1 force evaluation per step
+	INTEGRATOR_LEAPFROG, //kick-drift-kick leapfrog on the velocities, 1 force evaluation per step
+	INTEGRATOR_YOSHIDA,	 //4th order Yoshida : 3 leapfrog sub-steps, 3 force evaluations per step
+	INTEGRATOR_COUNT
+} Integrator_t;
+
+//Simulation
+typedef struct Simulation_s {
+	ParticleSystem_t *particles;
+	Particle_t *blackHole;
+	Solver_t solver;
+	Integrator_t integrator; //not used by the block time steps (always Verlet)
+	bool velocitiesReady;	 //the velocities of the particles match their positions (set by the leapfrog steps only)
+	bool accelerationsReady; //ax/ay are the accelerations of the current positions (cleared when particles are added or removed)
+	double theta; //opening angle of the Barnes-Hut solver
+	int meshSize; //cells per side of the grid of the particle-mesh solver
+	int blockLevels;  //0 : every particle moves by timeStep, otherwise block time steps down to timeStep / 2^blockLevels
+	double blockEta;  //accuracy of the block time steps (see block_steps.h)
+	int reorderInterval; //the particles are sorted along a Morton curve every reorderInterval steps (0 : never), see particle_system_sort_morton
+	double timeStep;
+	unsigned long long step; //number of steps done
+	Quadtree_t *quadtree;
+	ParticleMesh_t *mesh; //created by the first particle-mesh step (and again when meshSize changes)
+	BlockSteps_t *blocks; //created by the first step with block time steps
+	ThreadPool_t *pool;
+	Profiler_t *profiler; //the phases of the step ("forces", "integration") are measured when not NULL, owned by the caller
+} Simulation_t;
+
+/**
+ * @brief Initializes a new Simulation_t with no particle, a black hole at the origin and a pool of threadCount threads (0 : one per processor).
+ * @return Simulation_t*
+ */
+Simulation_t *simulation_initializer(int threadCount);
+
+/**
+ * @brief Add count particles at random positions in [-halfWidth, halfWidth] x [-halfHeight, halfHeight],
+ * each on a circular orbit around the black hole.
+ * @return void
+ */
+void simulation_populate(Simulation_t *simulation, size_t count, int halfWidth, int halfHeight, unsigned int seed);
+
+/**
+ * @brief Add a particle at (x, y) on a circular orbit around the black hole, reusing a free slot of the particle system if any.
+ * @return size_t the index of the new particle
+ */
+size_t simulation_spawn(Simulation_t *simulation, double x, double y, double mass);
+
+/**
+ * @brief Remove the particle closest to (x, y) if it is within radius.
+ * @return bool false if there is no particle within radius
+ */
+bool simulation_despawn_nearest(Simulation_t *simulation, double x, double y, double radius);
+
+/**
+ * @brief Updates the physics values of every particles currently in the simulation (one time step with the integrator, divided in
+ * block time steps when blockLevels is not 0). Compacts the particle system first when too many of its slots are free, and sorts it
+ * every reorderInterval steps (the slots of the particles change, not their ids).
+ * With every integrator lastX/lastY are the positions one time step before. The leapfrog integrators start by computing the
+ * velocities from them when velocitiesReady is false, or only compute the accelerations again when accelerationsReady is false
+ * (one more force evaluation).
+ * @return void
+ */
+void simulation_step(Simulation_t *simulation);
+
+/**
+ * @brief Get the grid of the particle-mesh solver, created (or created again) with meshSize cells per side if needed.
+ * @return ParticleMesh_t*
+ */
+ParticleMesh_t *simulation_mesh(Simulation_t *simulation);
+
+/**
+ * @brief Get the total energy of the simulation (kinetic energy of the particles, potential energy of every pair and with the black hole).
+ * Direct sum over every pair (O(N^2), split between the threads of the pool), meant to be called from time to time to check the conservation.
+ * @return double
+ */
+double simulation_energy(Simulation_t *simulation);
+
+/**
+ * @brief Get the name of a solver ("direct", "barnes-hut", "particle-mesh").
+ * @return const char*
+ */
+const char *simulation_solver_name(Solver_t solver);
+
+/**
+ * @brief Get a solver from its name.
+ * @return bool false if the name is unknown
+ */
+bool simulation_solver_from_name(const char *name, Solver_t *solver);
+
+/**
+ * @brief Get the name of an integrator ("verlet", "leapfrog", "yoshida").
+ * @return const char*
+ */
+const char *simulation_integrator_name(Integrator_t integrator);
+
+/**
+ * @brief Get an integrator from its name.
+ * @return bool false if the name is unknown
+ */
+bool simulation_integrator_from_name(const char *name, Integrator_t *integrator);
+
+/**
+ * @brief Free the particles, the black hole, the solver data, stop the threads and free the Simulation_t.
+ * @return void
+ */
+void simulation_destroy(Simulation_t *simulation);
@@ -0,0 +1,222 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Snapshots of the particles published by the physics thread to the render thread through a lock-free triple buffer
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "particle_system.h"
+#include "snapshot.h"
+#include "tests.h"
+
+//flag of the middle index, set by the writer when it publishes and cleared by the reader when it takes the snapshot
+#define SNAPSHOT_FRESH 4
+#define SNAPSHOT_INDEX_MASK 3
+
+SnapshotBuffer_t *snapshot_buffer_initializer(void)
+{
+	SnapshotBuffer_t *buffer = (SnapshotBuffer_t *)calloc(1, sizeof(SnapshotBuffer_t));
+
+	buffer->back = 0;
+	atomic_init(&buffer->middle, 1);
+	buffer->front = 2;
+	buffer->received = false;
+
+	return buffer;
+}
+
+/*
+ * Grow the arrays of a snapshot so that it can hold at least count particles (the content is overwritten anyway).
+ */
+static void snapshot_reserve(Snapshot_t *snapshot, size_t count)
+{
+	if (count <= snapshot->capacity)
+	{
+		return;
+	}
+
+	free(snapshot->x);
+	free(snapshot->y);
+	free(snapshot->lastX);
+	free(snapshot->lastY);
+	free(snapshot->mass);
+	snapshot->capacity = count + count / 2;
+	snapshot->x = (double *)malloc(snapshot->capacity * sizeof(double));
+	snapshot->y = (double *)malloc(snapshot->capacity * sizeof(double));
+	snapshot->lastX = (double *)malloc(snapshot->capacity * sizeof(double));
+	snapshot->lastY = (double *)malloc(snapshot->capacity * sizeof(double));
+	snapshot->mass = (double *)malloc(snapshot->capacity * sizeof(double));
+}
+
+Snapshot_t *snapshot_buffer_capture(SnapshotBuffer_t *buffer, ParticleSystem_t *system, unsigned long long step, double time)
+{
+	Snapshot_t *snapshot = &buffer->snapshots[buffer->back];
+	size_t count = 0;
+
+	snapshot_reserve(snapshot, system->count);
+
+	if (system->freeCount == 0)
+	{
+		memcpy(snapshot->x, system->x, system->count * sizeof(double));
+		memcpy(snapshot->y, system->y, system->count * sizeof(double));
+		memcpy(snapshot->lastX, system->lastX, system->count * sizeof(double));
+		memcpy(snapshot->lastY, system->lastY, system->count * sizeof(double));
+		memcpy(snapshot->mass, system->mass, system->count * sizeof(double));
+		count = system->count;
+	}
+	else
+	{
+		//skip the free slots so that the reader does not have to
+		for (size_t i = 0; i < system->count; i++)
+		{
+			if (system->mass[i] == 0)
+			{
+				continue;
+			}
+			snapshot->x[count] = system->x[i];
+			snapshot->y[count] = system->y[i];
+			snapshot->lastX[count] = system->lastX[i];
+			snapshot->lastY[count] = system->lastY[i];
+			snapshot->mass[count] = system->mass[i];
+			count++;
+		}
+	}
+
+	snapshot->count = count;
+	snapshot->step = step;
+	snapshot->time = time;
+
+	return snapshot;
+}
+
+void snapshot_buffer_publish(SnapshotBuffer_t *buffer)
+{
+	//release : the content of the snapshot is visible to the reader before the index
+	int previous = atomic_exchange_explicit(&buffer->middle, buffer->back | SNAPSHOT_FRESH, memory_order_acq_rel);
+
+	buffer->back = previous & SNAPSHOT_INDEX_MASK;
+}
+
+Snapshot_t *snapshot_buffer_acquire(SnapshotBuffer_t *buffer)
+{
+	if (atomic_load_explicit(&buffer->middle, memory_order_relaxed) & SNAPSHOT_FRESH)
+	{
+		//acquire : the content written before the publish is visible once the index is read
+		int previous = atomic_exchange_explicit(&buffer->middle, buffer->front, memory_order_acq_rel);
+
+		buffer->front = previous & SNAPSHOT_INDEX_MASK;
+		buffer->received = true;
+	}
+
+	return buffer->received ? &buffer->snapshots[buffer->front] : NULL;
+}
+
+void snapshot_buffer_destroy(SnapshotBuffer_t *buffer)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		free(buffer->snapshots[i].x);
+		free(buffer->snapshots[i].y);
+		free(buffer->snapshots[i].lastX);
+		free(buffer->snapshots[i].lastY);
+		free(buffer->snapshots[i].mass);
+	}
+	free(buffer);
+}
+
+//Build test : (mingw32-)gcc -o test.exe snapshot.c particle_system.c particle.c thread_pool.c gravity.c timer.c -lpthread -DUNIT_TESTS_SN
+#ifdef UNIT_TESTS_SN
+#include <pthread.h>
+
+#define TEST_STEPS 20000
+
+//writer of the concurrent test : publishes snapshots where every particle is at x = step
+static void *test_writer(void *argument)
+{
+	SnapshotBuffer_t *buffer = (SnapshotBuffer_t *)argument;
+	ParticleSystem_t *system = particle_system_initializer(64);
+
+	for (size_t i = 0; i < 64; i++)
+	{
+		particle_system_add(system, 0, 0, 0, 0, 1);
+	}
+	for (unsigned long long step = 1; step <= TEST_STEPS; step++)
+	{
+		for (size_t i = 0; i < system->count; i++)
+		{
+			system->x[i] = (double)step;
+		}
+		snapshot_buffer_capture(buffer, system, step, 0);
+		snapshot_buffer_publish(buffer);
+	}
+
+	particle_system_destroy(system);
+	return NULL;
+}
+
+/* Start the overall test suite */
+START_TESTS()
+START_TEST("Last published snapshot without the free slots")
+SnapshotBuffer_t *buffer = snapshot_buffer_initializer();
+ParticleSystem_t *system = particle_system_initializer(4);
+Snapshot_t *snapshot;
+
+ASSERT(snapshot_buffer_acquire(buffer) == NULL);
+
+particle_system_add(system, 0, 0, 1, 1, 1);
+particle_system_add(system, 0, 0, 2, 2, 2);
+particle_system_add(system, 0, 0, 3, 3, 3);
+snapshot_buffer_capture(buffer, system, 1, 0);
+snapshot_buffer_publish(buffer);
+
+particle_system_remove(system, 1);
+snapshot_buffer_capture(buffer, system, 2, 0);
+snapshot_buffer_publish(buffer);
+
+snapshot = snapshot_buffer_acquire(buffer);
+ASSERT(snapshot != NULL);
+ASSERT(snapshot->step == 2);
+ASSERT(snapshot->count == 2);
+ASSERT(snapshot->x[1] == 3 && snapshot->mass[1] == 3);
+
+//nothing new : same snapshot
+ASSERT(snapshot_buffer_acquire(buffer) == snapshot);
+
+particle_system_destroy(system);
+snapshot_buffer_destroy(buffer);
+END_TEST()
+
+START_TEST("Consistent snapshots while the writer runs")
+SnapshotBuffer_t *buffer = snapshot_buffer_initializer();
+pthread_t writer;
+unsigned long long lastStep = 0;
+bool consistent = true, ordered = true;
+
+pthread_create(&writer, NULL, test_writer, buffer);
+while (lastStep < TEST_STEPS)
+{
+	Snapshot_t *snapshot = snapshot_buffer_acquire(buffer);
+
+	if (snapshot == NULL)
+	{
+		continue;
+	}
+	//every particle of a snapshot comes from the same step, and the steps never go back
+	for (size_t i = 0; i < snapshot->count; i++)
+	{
+		consistent = consistent && snapshot->x[i] == (double)snapshot->step;
+	}
+	ordered = ordered && snapshot->step >= lastStep;
+	lastStep = snapshot->step;
+}
+pthread_join(writer, NULL);
+
+ASSERT(consistent);
+ASSERT(ordered);
+
+snapshot_buffer_destroy(buffer);
+END_TEST()
+/* End the overall test suite */
+END_TESTS()
+#endif
@@ -0,0 +1,71 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Snapshots of the particles published by the physics thread to the render thread through a lock-free triple buffer
+*/
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "particle_system.h"
+
+#pragma once
+
+//characters of the timings text of a snapshot
+#define SNAPSHOT_TIMINGS_SIZE 512
+
+//Copy of the particles alive at the end of a physics step
+typedef struct Snapshot_s {
+	size_t count;
+	size_t capacity;
+	double *x;
+	double *y;
+	double *lastX; //position one step before, used to interpolate between the two last states
+	double *lastY;
+	double *mass;
+	unsigned long long step; //number of steps done when the snapshot was taken
+	double time;			 //timer_now() when the snapshot was taken
+	double stepTime;		 //statistics filled by the writer (seconds taken by the last step, total energy)
+	double energy;
+	char timings[SNAPSHOT_TIMINGS_SIZE]; //profiler_format() of the physics phases, empty when they are not measured
+} Snapshot_t;
+
+//Triple buffer : the writer fills the back snapshot, the reader uses the front one and the third one is exchanged between them.
+//Neither side ever waits for the other, the reader always gets the last published snapshot.
+typedef struct SnapshotBuffer_s {
+	Snapshot_t snapshots[3];
+	int back;			//owned by the writer
+	int front;			//owned by the reader
+	atomic_int middle;	//index of the shared snapshot, plus a flag set while it holds a snapshot the reader did not take yet
+	bool received;		//the reader got at least one snapshot (reader side only)
+} SnapshotBuffer_t;
+
+/**
+ * @brief Initializes a new SnapshotBuffer_t with three empty snapshots.
+ * @return SnapshotBuffer_t*
+ */
+SnapshotBuffer_t *snapshot_buffer_initializer(void);
+
+/**
+ * @brief Copy the particles alive in the system into the back snapshot of the buffer (writer side only).
+ * The statistics are left to the caller, they can be filled in the returned snapshot until it is published.
+ * @return Snapshot_t* the back snapshot
+ */
+Snapshot_t *snapshot_buffer_capture(SnapshotBuffer_t *buffer, ParticleSystem_t *system, unsigned long long step, double time);
+
+/**
+ * @brief Publish the back snapshot to the reader and take the shared one as the new back snapshot (writer side only).
+ * @return void
+ */
+void snapshot_buffer_publish(SnapshotBuffer_t *buffer);
+
+/**
+ * @brief Get the last published snapshot (reader side only), it stays valid and unchanged until the next call.
+ * @return Snapshot_t* NULL if nothing was published yet
+ */
+Snapshot_t *snapshot_buffer_acquire(SnapshotBuffer_t *buffer);
+
+/**
+ * @brief Free the snapshots and the SnapshotBuffer_t.
+ * @return void
+ */
+void snapshot_buffer_destroy(SnapshotBuffer_t *buffer);
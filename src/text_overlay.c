@@ -0,0 +1,115 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Text overlay drawing strings from a glyph atlas (every printable ascii character of a font rasterized once in a single texture)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "text_overlay.h"
+
+TextOverlay_t *text_overlay_initializer(SDL_Renderer *renderer, TTF_Font *font, SDL_Color color)
+{
+	TextOverlay_t *overlay = (TextOverlay_t *)calloc(1, sizeof(TextOverlay_t));
+	SDL_Surface *glyphs[TEXT_OVERLAY_CHAR_COUNT];
+	SDL_Surface *atlas;
+	int width = 0, height = TTF_FontHeight(font);
+	bool ok = true;
+
+	overlay->lineSkip = TTF_FontLineSkip(font);
+
+	//rasterize every glyph, they are put side by side in the atlas
+	for (int i = 0; i < TEXT_OVERLAY_CHAR_COUNT; i++)
+	{
+		int advance = 0;
+
+		glyphs[i] = TTF_RenderGlyph_Blended(font, (Uint16)(TEXT_OVERLAY_FIRST_CHAR + i), color);
+		TTF_GlyphMetrics(font, (Uint16)(TEXT_OVERLAY_FIRST_CHAR + i), NULL, NULL, NULL, NULL, &advance);
+		overlay->glyphs[i].advance = advance;
+		overlay->glyphs[i].source.x = width;
+		overlay->glyphs[i].source.y = 0;
+		overlay->glyphs[i].source.w = glyphs[i] != NULL ? glyphs[i]->w : 0;
+		overlay->glyphs[i].source.h = glyphs[i] != NULL ? glyphs[i]->h : 0;
+		width += overlay->glyphs[i].source.w;
+		if (overlay->glyphs[i].source.h > height)
+		{
+			height = overlay->glyphs[i].source.h;
+		}
+	}
+
+	atlas = SDL_CreateRGBSurfaceWithFormat(0, width > 0 ? width : 1, height > 0 ? height : 1, 32, SDL_PIXELFORMAT_RGBA32);
+	if (atlas == NULL)
+	{
+		ok = false;
+	}
+	for (int i = 0; i < TEXT_OVERLAY_CHAR_COUNT; i++)
+	{
+		if (glyphs[i] == NULL)
+		{
+			continue;
+		}
+		if (ok)
+		{
+			//copy the alpha of the glyph instead of blending it over the (transparent) atlas
+			SDL_SetSurfaceBlendMode(glyphs[i], SDL_BLENDMODE_NONE);
+			SDL_BlitSurface(glyphs[i], NULL, atlas, &overlay->glyphs[i].source);
+		}
+		SDL_FreeSurface(glyphs[i]);
+	}
+
+	if (ok)
+	{
+		overlay->atlas = SDL_CreateTextureFromSurface(renderer, atlas);
+		ok = overlay->atlas != NULL;
+	}
+	if (atlas != NULL)
+	{
+		SDL_FreeSurface(atlas);
+	}
+	if (!ok)
+	{
+		text_overlay_destroy(overlay);
+		return NULL;
+	}
+	SDL_SetTextureBlendMode(overlay->atlas, SDL_BLENDMODE_BLEND);
+
+	return overlay;
+}
+
+void text_overlay_draw(TextOverlay_t *overlay, SDL_Renderer *renderer, int x, int y, const char *text)
+{
+	int penX = x, penY = y;
+
+	for (const char *c = text; *c != '\0'; c++)
+	{
+		TextGlyph_t *glyph;
+		SDL_Rect destination;
+
+		if (*c == '\n')
+		{
+			penX = x;
+			penY += overlay->lineSkip;
+			continue;
+		}
+
+		glyph = &overlay->glyphs[(*c >= TEXT_OVERLAY_FIRST_CHAR && *c <= TEXT_OVERLAY_LAST_CHAR ? *c : TEXT_OVERLAY_LAST_CHAR) - TEXT_OVERLAY_FIRST_CHAR];
+		if (glyph->source.w > 0)
+		{
+			//the copies are batched by SDL (one draw for the whole text as long as the texture stays the same)
+			destination.x = penX;
+			destination.y = penY;
+			destination.w = glyph->source.w;
+			destination.h = glyph->source.h;
+			SDL_RenderCopy(renderer, overlay->atlas, &glyph->source, &destination);
+		}
+		penX += glyph->advance;
+	}
+}
+
+void text_overlay_destroy(TextOverlay_t *overlay)
+{
+	if (overlay->atlas != NULL)
+	{
+		SDL_DestroyTexture(overlay->atlas);
+	}
+	free(overlay);
+}
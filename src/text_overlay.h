@@ -0,0 +1,47 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Text overlay drawing strings from a glyph atlas (every printable ascii character of a font rasterized once in a single texture)
+*/
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+#pragma once
+
+//characters of the atlas, the other ones are drawn as TEXT_OVERLAY_LAST_CHAR
+#define TEXT_OVERLAY_FIRST_CHAR ' '
+#define TEXT_OVERLAY_LAST_CHAR '~'
+#define TEXT_OVERLAY_CHAR_COUNT (TEXT_OVERLAY_LAST_CHAR - TEXT_OVERLAY_FIRST_CHAR + 1)
+
+//Glyph of the atlas
+typedef struct TextGlyph_s {
+	SDL_Rect source; //position in the atlas
+	int advance;	 //horizontal distance to the next glyph
+} TextGlyph_t;
+
+//Text overlay
+typedef struct TextOverlay_s {
+	SDL_Texture *atlas;
+	TextGlyph_t glyphs[TEXT_OVERLAY_CHAR_COUNT];
+	int lineSkip; //vertical distance between two lines
+} TextOverlay_t;
+
+/**
+ * @brief Initializes a new TextOverlay_t by rasterizing the glyphs of the font in the given color into one texture of the renderer.
+ * Nothing is allocated after this call.
+ * @return TextOverlay_t* NULL on error (see SDL_GetError / TTF_GetError)
+ */
+TextOverlay_t *text_overlay_initializer(SDL_Renderer *renderer, TTF_Font *font, SDL_Color color);
+
+/**
+ * @brief Draw a string (can be several lines separated by '\n') with its upper left corner at (x, y).
+ * @return void
+ */
+void text_overlay_draw(TextOverlay_t *overlay, SDL_Renderer *renderer, int x, int y, const char *text);
+
+/**
+ * @brief Free the atlas and the TextOverlay_t.
+ * @return void
+ */
+void text_overlay_destroy(TextOverlay_t *overlay);
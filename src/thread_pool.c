@@ -0,0 +1,218 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Persistent pool of worker threads splitting loops over particles in contiguous chunks
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "thread_pool.h"
+#include "trace.h"
+#include "tests.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+//argument given to every worker, the index is fixed for the life of the pool
+typedef struct ThreadPoolWorker_s {
+	ThreadPool_t *pool;
+	int thread;
+} ThreadPoolWorker_t;
+
+int thread_pool_cpu_count(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+#endif
+}
+
+/*
+ * Run the chunk of a thread, the bounds only depend on the count and the number of threads.
+ */
+static void thread_pool_run_chunk(ThreadPool_t *pool, int thread)
+{
+	size_t begin = pool->count * thread / pool->threadCount;
+	size_t end = pool->count * (thread + 1) / pool->threadCount;
+
+	if (begin < end)
+	{
+		TRACE_SCOPE("parallel for")
+		{
+			pool->task(pool->context, thread, begin, end);
+		}
+	}
+}
+
+static void *thread_pool_worker(void *argument)
+{
+	ThreadPoolWorker_t *worker = (ThreadPoolWorker_t *)argument;
+	ThreadPool_t *pool = worker->pool;
+	unsigned long seen = 0;
+
+	TRACE_THREAD_NAME("pool worker");
+	while (true)
+	{
+		//wait for a new loop (or the stop signal)
+		pthread_mutex_lock(&pool->mutex);
+		while (pool->generation == seen && !pool->stop)
+		{
+			pthread_cond_wait(&pool->start, &pool->mutex);
+		}
+		if (pool->stop)
+		{
+			pthread_mutex_unlock(&pool->mutex);
+			break;
+		}
+		seen = pool->generation;
+		pthread_mutex_unlock(&pool->mutex);
+
+		thread_pool_run_chunk(pool, worker->thread);
+
+		//tell the calling thread this chunk is done
+		pthread_mutex_lock(&pool->mutex);
+		if (--pool->pending == 0)
+		{
+			pthread_cond_signal(&pool->done);
+		}
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	free(worker);
+	return NULL;
+}
+
+ThreadPool_t *thread_pool_initializer(int threadCount)
+{
+	ThreadPool_t *pool = (ThreadPool_t *)calloc(1, sizeof(ThreadPool_t));
+
+	if (threadCount <= 0)
+	{
+		threadCount = thread_pool_cpu_count();
+	}
+
+	pool->threadCount = threadCount;
+	pool->workers = (pthread_t *)calloc(threadCount, sizeof(pthread_t));
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	//thread 0 is the calling thread, only start the others
+	for (int i = 1; i < threadCount; i++)
+	{
+		ThreadPoolWorker_t *worker = (ThreadPoolWorker_t *)malloc(sizeof(ThreadPoolWorker_t));
+		worker->pool = pool;
+		worker->thread = i;
+
+		if (pthread_create(&pool->workers[i], NULL, thread_pool_worker, worker) != 0)
+		{
+			fprintf(stderr, "error: could not start worker thread %d, using %d threads\n", i, i);
+			free(worker);
+			pool->threadCount = i;
+			break;
+		}
+	}
+
+	return pool;
+}
+
+void thread_pool_parallel_for(ThreadPool_t *pool, size_t count, ThreadPoolTask_t task, void *context)
+{
+	if (pool == NULL || pool->threadCount == 1)
+	{
+		if (count > 0)
+		{
+			task(context, 0, 0, count);
+		}
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->task = task;
+	pool->context = context;
+	pool->count = count;
+	pool->pending = pool->threadCount - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->mutex);
+
+	thread_pool_run_chunk(pool, 0);
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->pending > 0)
+	{
+		pthread_cond_wait(&pool->done, &pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+int thread_pool_thread_count(ThreadPool_t *pool)
+{
+	return pool == NULL ? 1 : pool->threadCount;
+}
+
+void thread_pool_destroy(ThreadPool_t *pool)
+{
+	pthread_mutex_lock(&pool->mutex);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (int i = 1; i < pool->threadCount; i++)
+	{
+		pthread_join(pool->workers[i], NULL);
+	}
+
+	pthread_cond_destroy(&pool->start);
+	pthread_cond_destroy(&pool->done);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool->workers);
+	free(pool);
+}
+
+//Build test : (mingw32-)gcc -o test.exe thread_pool.c -lpthread -DUNIT_TESTS_TP
+#ifdef UNIT_TESTS_TP
+static void test_fill(void *context, int thread, size_t begin, size_t end)
+{
+	int *values = (int *)context;
+
+	(void)thread;
+	for (size_t i = begin; i < end; i++)
+	{
+		values[i]++;
+	}
+}
+
+/* Start the overall test suite */
+START_TESTS()
+START_TEST("Every index is done exactly once")
+ThreadPool_t *pool = thread_pool_initializer(4);
+int *values = (int *)calloc(1000, sizeof(int));
+bool once = true;
+
+for (int run = 0; run < 50; run++)
+{
+	thread_pool_parallel_for(pool, 1000, test_fill, values);
+}
+//fewer indices than threads
+thread_pool_parallel_for(pool, 2, test_fill, values);
+
+for (size_t i = 0; i < 1000; i++)
+{
+	once = once && values[i] == 50 + (i < 2);
+}
+ASSERT(once);
+ASSERT(thread_pool_thread_count(pool) == 4);
+ASSERT(thread_pool_thread_count(NULL) == 1);
+
+free(values);
+thread_pool_destroy(pool);
+END_TEST()
+/* End the overall test suite */
+END_TESTS()
+#endif
@@ -0,0 +1,64 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Persistent pool of worker threads splitting loops over particles in contiguous chunks
+*/
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#pragma once
+
+/**
+ * Function run by every thread of the pool on its chunk [begin, end) of the loop.
+ * thread is the index of the thread running the chunk (0 is the calling thread).
+ */
+typedef void (*ThreadPoolTask_t)(void *context, int thread, size_t begin, size_t end);
+
+//Thread pool
+typedef struct ThreadPool_s {
+	int threadCount; //number of threads sharing a loop, including the calling thread
+	pthread_t *workers;
+	pthread_mutex_t mutex;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	unsigned long generation; //incremented for every new loop, wakes the workers up
+	int pending;			  //number of workers still running the current loop
+	bool stop;
+	ThreadPoolTask_t task;
+	void *context;
+	size_t count;
+} ThreadPool_t;
+
+/**
+ * @brief Get the number of processors available.
+ * @return int
+ */
+int thread_pool_cpu_count(void);
+
+/**
+ * @brief Initializes a new ThreadPool_t and starts its workers (threadCount - 1 of them, the calling thread does its share).
+ * A threadCount of 0 or less uses one thread per processor.
+ * @return ThreadPool_t*
+ */
+ThreadPool_t *thread_pool_initializer(int threadCount);
+
+/**
+ * @brief Run task over [0, count), split in one contiguous chunk per thread, and wait for every chunk to be done.
+ * The chunks only depend on count and the number of threads, so a task writing only to its own indices gives the same result
+ * whatever the number of threads. A NULL pool runs the whole loop on the calling thread.
+ * @return void
+ */
+void thread_pool_parallel_for(ThreadPool_t *pool, size_t count, ThreadPoolTask_t task, void *context);
+
+/**
+ * @brief Get the number of threads sharing a loop (1 for a NULL pool).
+ * @return int
+ */
+int thread_pool_thread_count(ThreadPool_t *pool);
+
+/**
+ * @brief Stop and join the workers, then free the ThreadPool_t.
+ * @return void
+ */
+void thread_pool_destroy(ThreadPool_t *pool);
@@ -0,0 +1,13 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Monotonic wall clock (does not depend on SDL, so it can be used by the headless tools)
+*/
+
+#pragma once
+
+/**
+ * @brief Get the time elapsed since an arbitrary fixed point, in seconds (monotonic, wall clock time).
+ * @return double
+ */
+double timer_now(void);
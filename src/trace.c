@@ -0,0 +1,421 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Begin/end events of every thread recorded in per-thread lock-free buffers and written as a Chrome/Perfetto trace.json
+(only compiled in with -DTRACING, the TRACE_ macros expand to nothing otherwise)
+*/
+#ifdef UNIT_TESTS_TR
+#define TRACING //the tests need the events to be recorded
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "timer.h"
+#include "trace.h"
+#include "tests.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define TRACE_X86
+#include <x86intrin.h>
+#endif
+
+#ifdef TRACING
+//flag of the ticks of an end event (16 bytes per event instead of 24 with a separate field)
+#define TRACE_END_FLAG (1ULL << 63)
+
+//Begin or end of a phase
+typedef struct TraceEvent_s {
+	const char *name;
+	unsigned long long ticks; //trace_ticks(), with TRACE_END_FLAG for an end
+} TraceEvent_t;
+
+typedef struct TraceChunk_s {
+	TraceEvent_t events[TRACE_CHUNK_EVENTS];
+	struct TraceChunk_s *next;
+} TraceChunk_t;
+
+//Events of a thread, only written by the thread itself (no lock, no atomic operation when recording)
+typedef struct TraceThread_s {
+	int id;			  //tid of the events, in the order the threads recorded their first event
+	const char *name; //NULL : not named
+	TraceChunk_t *first;
+	TraceChunk_t *last;
+	int chunkCount;
+	size_t count; //events in the last chunk
+	unsigned long long dropped;
+	struct TraceThread_s *next; //list of every thread that recorded an event
+} TraceThread_t;
+
+static _Atomic(TraceThread_t *) s_threads;
+static atomic_int s_threadCount;
+static atomic_int s_generation; //incremented by trace_free, the buffers of the threads registered before are freed
+static atomic_bool s_enabled;
+static double s_origin; //timer_now() of trace_start, the time 0 of the trace
+static unsigned long long s_originTicks;
+static double s_end; //timer_now() of trace_stop, the ticks are converted to seconds with the time between the start and the stop
+static unsigned long long s_endTicks;
+static _Thread_local TraceThread_t *t_thread;
+static _Thread_local int t_generation; //s_generation when t_thread was registered
+static _Thread_local const char *t_name; //given to the buffer of the thread when it is created
+
+/*
+ * Timestamp of an event : the time stamp counter on x86 (a few nanoseconds, timer_now() can take more than the whole budget of an
+ * event on virtual machines), nanoseconds of timer_now() otherwise.
+ */
+static inline unsigned long long trace_ticks(void)
+{
+#ifdef TRACE_X86
+	return __rdtsc();
+#else
+	return (unsigned long long)(timer_now() * 1e9);
+#endif
+}
+
+/*
+ * Create the buffer of the calling thread and add it to the list (the only synchronized step, done once per thread).
+ */
+static TraceThread_t *trace_register(void)
+{
+	TraceThread_t *thread = (TraceThread_t *)calloc(1, sizeof(TraceThread_t));
+
+	if (thread == NULL || (thread->first = (TraceChunk_t *)malloc(sizeof(TraceChunk_t))) == NULL)
+	{
+		free(thread);
+		return NULL;
+	}
+	thread->first->next = NULL;
+	thread->last = thread->first;
+	thread->chunkCount = 1;
+	thread->name = t_name;
+	thread->id = atomic_fetch_add(&s_threadCount, 1) + 1;
+	thread->next = atomic_load(&s_threads);
+	while (!atomic_compare_exchange_weak(&s_threads, &thread->next, thread))
+	{
+	}
+	t_thread = thread;
+	t_generation = atomic_load(&s_generation);
+
+	return thread;
+}
+
+static void trace_record(const char *name, unsigned long long phase)
+{
+	TraceThread_t *thread = t_thread;
+	TraceEvent_t *event;
+	unsigned long long now;
+
+	if (!atomic_load_explicit(&s_enabled, memory_order_relaxed))
+	{
+		return;
+	}
+	now = trace_ticks();
+	//not registered yet, or its buffer was freed by trace_free
+	if ((thread == NULL || t_generation != atomic_load_explicit(&s_generation, memory_order_relaxed)) && (thread = trace_register()) == NULL)
+	{
+		return;
+	}
+
+	if (thread->count == TRACE_CHUNK_EVENTS)
+	{
+		TraceChunk_t *chunk = thread->chunkCount < TRACE_MAX_CHUNKS ? (TraceChunk_t *)malloc(sizeof(TraceChunk_t)) : NULL;
+
+		if (chunk == NULL)
+		{
+			thread->dropped++;
+			return;
+		}
+		chunk->next = NULL;
+		thread->last->next = chunk;
+		thread->last = chunk;
+		thread->chunkCount++;
+		thread->count = 0;
+	}
+
+	event = &thread->last->events[thread->count++];
+	event->name = name;
+	event->ticks = now | phase;
+}
+
+bool trace_start(void)
+{
+	trace_free();
+	s_origin = timer_now();
+	s_originTicks = trace_ticks();
+	s_endTicks = 0;
+	atomic_store(&s_enabled, true);
+	return true;
+}
+
+void trace_stop(void)
+{
+	atomic_store(&s_enabled, false);
+	s_end = timer_now();
+	s_endTicks = trace_ticks();
+}
+
+void trace_begin(const char *name)
+{
+	trace_record(name, 0);
+}
+
+void trace_end(const char *name)
+{
+	trace_record(name, TRACE_END_FLAG);
+}
+
+void trace_thread_name(const char *name)
+{
+	//the buffer is only created by the first event, threads that never record one do not appear in the trace
+	t_name = name;
+	if (t_thread != NULL && t_generation == atomic_load(&s_generation))
+	{
+		t_thread->name = name;
+	}
+}
+
+bool trace_write(const char *path)
+{
+	FILE *file = fopen(path, "w");
+	unsigned long long dropped = 0;
+	double secondsPerTick;
+	bool first = true;
+
+	if (file == NULL)
+	{
+		fprintf(stderr, "error: could not open %s\n", path);
+		return false;
+	}
+
+	//still recording : calibrate the ticks up to now
+	if (s_endTicks == 0)
+	{
+		s_end = timer_now();
+		s_endTicks = trace_ticks();
+	}
+	secondsPerTick = s_endTicks > s_originTicks ? (s_end - s_origin) / (double)(s_endTicks - s_originTicks) : 1e-9;
+
+	//timestamps in microseconds since trace_start
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	for (TraceThread_t *thread = atomic_load(&s_threads); thread != NULL; thread = thread->next)
+	{
+		if (thread->name != NULL)
+		{
+			fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", first ? "" : ",", thread->id, thread->name);
+			first = false;
+		}
+		for (TraceChunk_t *chunk = thread->first; chunk != NULL; chunk = chunk->next)
+		{
+			size_t count = chunk == thread->last ? thread->count : TRACE_CHUNK_EVENTS;
+
+			for (size_t i = 0; i < count; i++)
+			{
+				unsigned long long ticks = chunk->events[i].ticks & ~TRACE_END_FLAG;
+
+				fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}", first ? "" : ",",
+						chunk->events[i].name, chunk->events[i].ticks & TRACE_END_FLAG ? 'E' : 'B', thread->id,
+						((double)ticks - (double)s_originTicks) * secondsPerTick * 1e6);
+				first = false;
+			}
+		}
+		dropped += thread->dropped;
+	}
+	fprintf(file, "\n]}\n");
+
+	if (dropped > 0)
+	{
+		fprintf(stderr, "warning: %llu trace events dropped (more than %d per thread)\n", dropped, TRACE_CHUNK_EVENTS * TRACE_MAX_CHUNKS);
+	}
+	if (fclose(file) != 0)
+	{
+		fprintf(stderr, "error: could not write %s\n", path);
+		return false;
+	}
+	return true;
+}
+
+void trace_free(void)
+{
+	TraceThread_t *thread = atomic_exchange(&s_threads, NULL);
+
+	while (thread != NULL)
+	{
+		TraceThread_t *next = thread->next;
+
+		while (thread->first != NULL)
+		{
+			TraceChunk_t *chunk = thread->first;
+
+			thread->first = chunk->next;
+			free(chunk);
+		}
+		free(thread);
+		thread = next;
+	}
+	atomic_store(&s_threadCount, 0);
+	//every thread registers a new buffer with its next event
+	atomic_fetch_add(&s_generation, 1);
+}
+#else
+bool trace_start(void)
+{
+	fprintf(stderr, "error: built without -DTRACING, no trace can be recorded\n");
+	return false;
+}
+
+void trace_stop(void)
+{
+}
+
+void trace_begin(const char *name)
+{
+	(void)name;
+}
+
+void trace_end(const char *name)
+{
+	(void)name;
+}
+
+void trace_thread_name(const char *name)
+{
+	(void)name;
+}
+
+bool trace_write(const char *path)
+{
+	fprintf(stderr, "error: built without -DTRACING, nothing to write to %s\n", path);
+	return false;
+}
+
+void trace_free(void)
+{
+}
+#endif
+
+//Build test : (mingw32-)gcc -o test.exe trace.c timer.c -lpthread -DUNIT_TESTS_TR
+#ifdef UNIT_TESTS_TR
+#include <string.h>
+#include <pthread.h>
+
+#define TEST_THREADS 4
+#define TEST_SCOPES 1000
+#define TEST_TIMED_SCOPES 200000
+
+static void *test_thread(void *argument)
+{
+	(void)argument;
+	TRACE_THREAD_NAME("test worker");
+	for (int i = 0; i < TEST_SCOPES; i++)
+	{
+		TRACE_SCOPE("outer")
+		{
+			TRACE_BEGIN("inner");
+			TRACE_END("inner");
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Count the occurrences of pattern in a file.
+ */
+static int test_count(const char *path, const char *pattern)
+{
+	FILE *file = fopen(path, "r");
+	char line[512];
+	int count = 0;
+
+	while (file != NULL && fgets(line, sizeof(line), file) != NULL)
+	{
+		count += strstr(line, pattern) != NULL;
+	}
+	if (file != NULL)
+	{
+		fclose(file);
+	}
+	return count;
+}
+
+/* Start the overall test suite */
+START_TESTS()
+START_TEST("Events of every thread")
+pthread_t threads[TEST_THREADS];
+const char *path = "test_trace.json";
+
+//nothing is recorded before trace_start
+TRACE_BEGIN("ignored");
+ASSERT(t_thread == NULL);
+
+ASSERT(trace_start());
+TRACE_THREAD_NAME("test main");
+for (int i = 0; i < TEST_THREADS; i++)
+{
+	pthread_create(&threads[i], NULL, test_thread, NULL);
+}
+for (int i = 0; i < TEST_THREADS; i++)
+{
+	pthread_join(threads[i], NULL);
+}
+TRACE_SCOPE("main")
+{
+	//a phase spanning more than one chunk
+	for (int i = 0; i < TRACE_CHUNK_EVENTS; i++)
+	{
+		TRACE_BEGIN("short");
+		TRACE_END("short");
+	}
+}
+trace_stop();
+TRACE_BEGIN("ignored");
+
+ASSERT(atomic_load(&s_threadCount) == TEST_THREADS + 1);
+ASSERT(t_thread->chunkCount == 3);
+ASSERT(trace_write(path));
+ASSERT(test_count(path, "\"ph\":\"B\"") == TEST_THREADS * TEST_SCOPES * 2 + TRACE_CHUNK_EVENTS + 1);
+ASSERT(test_count(path, "\"ph\":\"E\"") == TEST_THREADS * TEST_SCOPES * 2 + TRACE_CHUNK_EVENTS + 1);
+ASSERT(test_count(path, "\"name\":\"test worker\"") == TEST_THREADS);
+ASSERT(test_count(path, "ignored") == 0);
+remove(path);
+END_TEST()
+
+START_TEST("A new trace only has its own events")
+const char *path = "test_trace.json";
+
+//the buffers of the previous test are freed, the main thread registers a new one and keeps its name
+ASSERT(trace_start());
+TRACE_SCOPE("again")
+{
+}
+trace_stop();
+ASSERT(atomic_load(&s_threadCount) == 1);
+ASSERT(t_thread->chunkCount == 1 && t_thread->count == 2);
+ASSERT(trace_write(path));
+ASSERT(test_count(path, "\"ph\":\"B\"") == 1);
+ASSERT(test_count(path, "\"name\":\"test main\"") == 1);
+ASSERT(test_count(path, "outer") == 0);
+remove(path);
+
+trace_free();
+ASSERT(atomic_load(&s_threads) == NULL);
+ASSERT(atomic_load(&s_threadCount) == 0);
+END_TEST()
+
+START_TEST("Cost of an event")
+double start, cost;
+
+trace_start();
+start = timer_now();
+for (int i = 0; i < TEST_TIMED_SCOPES; i++)
+{
+	TRACE_BEGIN("timed");
+	TRACE_END("timed");
+}
+cost = (timer_now() - start) / (2.0 * TEST_TIMED_SCOPES);
+trace_stop();
+//only printed : a wall clock bound fails on loaded or virtual machines
+fprintf(stderr, "%.1f ns per event\n", cost * 1e9);
+trace_free();
+END_TEST()
+/* End the overall test suite */
+END_TESTS()
+#endif
@@ -0,0 +1,74 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Begin/end events of every thread recorded in per-thread lock-free buffers and written as a Chrome/Perfetto trace.json
+(only compiled in with -DTRACING, the TRACE_ macros expand to nothing otherwise)
+*/
+#include <stdbool.h>
+
+#pragma once
+
+//events of a chunk of a thread buffer (a new chunk is allocated by the thread when its last one is full)
+#define TRACE_CHUNK_EVENTS 16384
+//chunks a thread can fill, the events after them are dropped (64 MB per thread)
+#define TRACE_MAX_CHUNKS 256
+
+#ifdef TRACING
+//Record the begin or the end of the phase name on the calling thread (name must be a string literal without quotes nor backslashes)
+#define TRACE_BEGIN(name) trace_begin(name)
+#define TRACE_END(name) trace_end(name)
+//Record the statement or block that follows as the phase name (leaving it with break, return or goto loses the end event)
+#define TRACE_SCOPE(name) \
+	for (int traceOnce = (trace_begin(name), 1); traceOnce; traceOnce = (trace_end(name), 0))
+//Name the calling thread in the trace
+#define TRACE_THREAD_NAME(name) trace_thread_name(name)
+#else
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name) ((void)0)
+#define TRACE_SCOPE(name)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+/**
+ * @brief Start recording the events of every thread (nothing is recorded before, or when built without TRACING).
+ * The events of a previous trace are freed first, so it must not be called while recording.
+ * @return bool false when built without TRACING (a message is printed on stderr)
+ */
+bool trace_start(void);
+
+/**
+ * @brief Stop recording, the events recorded so far are kept for trace_write.
+ * @return void
+ */
+void trace_stop(void);
+
+/**
+ * @brief Record the begin of the phase name on the calling thread, use TRACE_BEGIN instead.
+ * @return void
+ */
+void trace_begin(const char *name);
+
+/**
+ * @brief Record the end of the phase name on the calling thread, use TRACE_END instead.
+ * @return void
+ */
+void trace_end(const char *name);
+
+/**
+ * @brief Name the calling thread in the trace, use TRACE_THREAD_NAME instead.
+ * @return void
+ */
+void trace_thread_name(const char *name);
+
+/**
+ * @brief Write the events of every thread to a Chrome/Perfetto trace file (chrome://tracing, ui.perfetto.dev).
+ * The threads must not record events meanwhile (stop them or call trace_stop first).
+ * @return bool false if the file could not be written (a message is printed on stderr)
+ */
+bool trace_write(const char *path);
+
+/**
+ * @brief Free the events of every thread, the threads must not record events meanwhile (stop them or call trace_stop first).
+ * @return void
+ */
+void trace_free(void);
@@ -0,0 +1,627 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Streaming trajectory files, frames are handed to a background writer thread which quantizes, delta-encodes and packs them
+              in chunks, so that writing never stalls the physics
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "particle_system.h"
+#include "trajectory.h"
+#include "tests.h"
+
+#define TRAJECTORY_MAGIC "GLXTRAJ"
+#define TRAJECTORY_HEADER_SIZE 24
+#define TRAJECTORY_FRAME_KEY 0
+#define TRAJECTORY_FRAME_DELTA 1
+//largest varint (64 bits in groups of 7)
+#define TRAJECTORY_MAX_VARINT 10
+
+/*
+ * Little-endian encoding whatever the byte order of the processor.
+ */
+static void write_u32(unsigned char *bytes, uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		bytes[i] = (unsigned char)(value >> (8 * i));
+	}
+}
+
+static uint32_t read_u32(const unsigned char *bytes)
+{
+	return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static void write_double(unsigned char *bytes, double value)
+{
+	uint64_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	for (int i = 0; i < 8; i++)
+	{
+		bytes[i] = (unsigned char)(bits >> (8 * i));
+	}
+}
+
+static double read_double(const unsigned char *bytes)
+{
+	uint64_t bits = 0;
+	double value;
+
+	for (int i = 0; i < 8; i++)
+	{
+		bits |= (uint64_t)bytes[i] << (8 * i);
+	}
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+/*
+ * Varints : 7 bits per byte, the high bit tells that another byte follows. Signed values are zigzag encoded first
+ * (0, -1, 1, -2, ... become 0, 1, 2, 3, ...) so that small negative differences stay short.
+ */
+static size_t write_varint(unsigned char *bytes, uint64_t value)
+{
+	size_t size = 0;
+
+	while (value >= 0x80)
+	{
+		bytes[size++] = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	bytes[size++] = (unsigned char)value;
+
+	return size;
+}
+
+static bool read_varint(const unsigned char *bytes, size_t size, size_t *position, uint64_t *value)
+{
+	*value = 0;
+	for (int shift = 0; shift < 64 && *position < size; shift += 7)
+	{
+		unsigned char byte = bytes[(*position)++];
+
+		*value |= (uint64_t)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static uint64_t zigzag(int64_t value)
+{
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/*
+ * Make room for size more bytes in the chunk.
+ */
+static void trajectory_chunk_reserve(TrajectoryWriter_t *writer, size_t size)
+{
+	if (writer->chunkSize + size > writer->chunkCapacity)
+	{
+		while (writer->chunkSize + size > writer->chunkCapacity)
+		{
+			writer->chunkCapacity = writer->chunkCapacity == 0 ? TRAJECTORY_CHUNK_SIZE : writer->chunkCapacity * 2;
+		}
+		writer->chunk = (unsigned char *)realloc(writer->chunk, writer->chunkCapacity);
+	}
+}
+
+static void trajectory_flush_chunk(TrajectoryWriter_t *writer)
+{
+	unsigned char header[8];
+
+	if (writer->chunkFrames == 0)
+	{
+		return;
+	}
+
+	write_u32(&header[0], writer->chunkFrames);
+	write_u32(&header[4], (uint32_t)writer->chunkSize);
+	if (fwrite(header, 1, sizeof(header), writer->file) != sizeof(header) || fwrite(writer->chunk, 1, writer->chunkSize, writer->file) != writer->chunkSize)
+	{
+		pthread_mutex_lock(&writer->mutex);
+		writer->error = true;
+		pthread_mutex_unlock(&writer->mutex);
+	}
+	writer->bytesWritten += sizeof(header) + writer->chunkSize;
+	writer->chunkSize = 0;
+	writer->chunkFrames = 0;
+}
+
+/*
+ * Append one frame to the chunk (writer thread).
+ */
+static void trajectory_encode(TrajectoryWriter_t *writer, TrajectoryFrame_t *frame)
+{
+	bool key = frame->count != writer->previousCount || writer->framesSinceKey % TRAJECTORY_KEY_INTERVAL == 0;
+	unsigned char *bytes;
+
+	if (frame->count > writer->previousCapacity)
+	{
+		writer->previousCapacity = frame->count;
+		writer->previousX = (int64_t *)realloc(writer->previousX, writer->previousCapacity * sizeof(int64_t));
+		writer->previousY = (int64_t *)realloc(writer->previousY, writer->previousCapacity * sizeof(int64_t));
+		writer->previousMass = (double *)realloc(writer->previousMass, writer->previousCapacity * sizeof(double));
+	}
+	//the delta frames have no mass : another particle in a place (a free slot reused) needs a key frame
+	for (size_t i = 0; i < frame->count && !key; i++)
+	{
+		key = frame->mass[i] != writer->previousMass[i];
+	}
+
+	//worst case : every value takes its largest size
+	trajectory_chunk_reserve(writer, 3 * TRAJECTORY_MAX_VARINT + frame->count * (2 * TRAJECTORY_MAX_VARINT + 8));
+	bytes = writer->chunk;
+	writer->chunkSize += write_varint(&bytes[writer->chunkSize], frame->step);
+	writer->chunkSize += write_varint(&bytes[writer->chunkSize], frame->count);
+	writer->chunkSize += write_varint(&bytes[writer->chunkSize], key ? TRAJECTORY_FRAME_KEY : TRAJECTORY_FRAME_DELTA);
+
+	for (size_t i = 0; i < frame->count; i++)
+	{
+		int64_t qx = (int64_t)llround(frame->x[i] / writer->quantum);
+		int64_t qy = (int64_t)llround(frame->y[i] / writer->quantum);
+
+		if (key)
+		{
+			writer->chunkSize += write_varint(&bytes[writer->chunkSize], zigzag(qx));
+			writer->chunkSize += write_varint(&bytes[writer->chunkSize], zigzag(qy));
+			write_double(&bytes[writer->chunkSize], frame->mass[i]);
+			writer->chunkSize += 8;
+		}
+		else
+		{
+			writer->chunkSize += write_varint(&bytes[writer->chunkSize], zigzag(qx - writer->previousX[i]));
+			writer->chunkSize += write_varint(&bytes[writer->chunkSize], zigzag(qy - writer->previousY[i]));
+		}
+		writer->previousX[i] = qx;
+		writer->previousY[i] = qy;
+		writer->previousMass[i] = frame->mass[i];
+	}
+
+	writer->previousCount = frame->count;
+	writer->framesSinceKey = key ? 1 : writer->framesSinceKey + 1;
+	writer->chunkFrames++;
+	writer->framesWritten++;
+
+	if (writer->chunkSize >= TRAJECTORY_CHUNK_SIZE)
+	{
+		trajectory_flush_chunk(writer);
+	}
+}
+
+/*
+ * Writer thread : encodes the frames of the ring buffer in order until it is stopped and empty.
+ */
+static void *trajectory_writer_thread(void *argument)
+{
+	TrajectoryWriter_t *writer = (TrajectoryWriter_t *)argument;
+
+	pthread_mutex_lock(&writer->mutex);
+	while (true)
+	{
+		TrajectoryFrame_t *frame;
+
+		while (writer->used == 0 && !writer->stop)
+		{
+			pthread_cond_wait(&writer->notEmpty, &writer->mutex);
+		}
+		if (writer->used == 0)
+		{
+			break;
+		}
+
+		//the oldest slot belongs to this thread until used is decremented
+		frame = &writer->slots[(writer->head - writer->used + writer->slotCount) % writer->slotCount];
+		pthread_mutex_unlock(&writer->mutex);
+
+		trajectory_encode(writer, frame);
+
+		pthread_mutex_lock(&writer->mutex);
+		writer->used--;
+		pthread_cond_signal(&writer->notFull);
+	}
+	pthread_mutex_unlock(&writer->mutex);
+
+	trajectory_flush_chunk(writer);
+	return NULL;
+}
+
+TrajectoryWriter_t *trajectory_writer_initializer(const char *path, double quantum, int slotCount, bool dropWhenFull)
+{
+	TrajectoryWriter_t *writer;
+	unsigned char header[TRAJECTORY_HEADER_SIZE] = {0};
+	FILE *file = fopen(path, "wb");
+
+	if (file == NULL)
+	{
+		fprintf(stderr, "error: could not open %s\n", path);
+		return NULL;
+	}
+
+	memcpy(header, TRAJECTORY_MAGIC, sizeof(TRAJECTORY_MAGIC));
+	write_u32(&header[8], TRAJECTORY_VERSION);
+	write_double(&header[16], quantum);
+	if (fwrite(header, 1, sizeof(header), file) != sizeof(header))
+	{
+		fprintf(stderr, "error: could not write %s\n", path);
+		fclose(file);
+		return NULL;
+	}
+
+	writer = (TrajectoryWriter_t *)calloc(1, sizeof(TrajectoryWriter_t));
+	writer->file = file;
+	writer->quantum = quantum;
+	writer->dropWhenFull = dropWhenFull;
+	writer->slotCount = slotCount > 0 ? slotCount : TRAJECTORY_DEFAULT_SLOTS;
+	writer->slots = (TrajectoryFrame_t *)calloc(writer->slotCount, sizeof(TrajectoryFrame_t));
+	writer->bytesWritten = sizeof(header);
+	pthread_mutex_init(&writer->mutex, NULL);
+	pthread_cond_init(&writer->notEmpty, NULL);
+	pthread_cond_init(&writer->notFull, NULL);
+	pthread_create(&writer->thread, NULL, trajectory_writer_thread, writer);
+
+	return writer;
+}
+
+bool trajectory_writer_push(TrajectoryWriter_t *writer, ParticleSystem_t *system, unsigned long long step)
+{
+	TrajectoryFrame_t *frame;
+	size_t count = 0;
+
+	pthread_mutex_lock(&writer->mutex);
+	while (writer->used == writer->slotCount && !writer->dropWhenFull)
+	{
+		pthread_cond_wait(&writer->notFull, &writer->mutex);
+	}
+	if (writer->used == writer->slotCount || writer->error)
+	{
+		writer->framesDropped++;
+		pthread_mutex_unlock(&writer->mutex);
+		return false;
+	}
+	//the slot at head is not seen by the writer thread until used is incremented
+	frame = &writer->slots[writer->head];
+	pthread_mutex_unlock(&writer->mutex);
+
+	if (frame->capacity < system->count)
+	{
+		frame->capacity = system->count;
+		frame->x = (double *)realloc(frame->x, frame->capacity * sizeof(double));
+		frame->y = (double *)realloc(frame->y, frame->capacity * sizeof(double));
+		frame->mass = (double *)realloc(frame->mass, frame->capacity * sizeof(double));
+	}
+	//in the order of the ids, a particle keeps its place in the frames when the system is sorted
+	for (size_t id = 0; id < system->count; id++)
+	{
+		size_t i = system->slots[id];
+
+		if (system->mass[i] == 0)
+		{
+			continue;
+		}
+		frame->x[count] = system->x[i];
+		frame->y[count] = system->y[i];
+		frame->mass[count] = system->mass[i];
+		count++;
+	}
+	frame->count = count;
+	frame->step = step;
+
+	pthread_mutex_lock(&writer->mutex);
+	writer->head = (writer->head + 1) % writer->slotCount;
+	writer->used++;
+	pthread_cond_signal(&writer->notEmpty);
+	pthread_mutex_unlock(&writer->mutex);
+
+	return true;
+}
+
+bool trajectory_writer_close(TrajectoryWriter_t *writer)
+{
+	if (writer->closed)
+	{
+		return !writer->error;
+	}
+
+	pthread_mutex_lock(&writer->mutex);
+	writer->stop = true;
+	pthread_cond_signal(&writer->notEmpty);
+	pthread_mutex_unlock(&writer->mutex);
+	pthread_join(writer->thread, NULL);
+
+	if (fclose(writer->file) != 0)
+	{
+		writer->error = true;
+	}
+	writer->closed = true;
+
+	return !writer->error;
+}
+
+void trajectory_writer_destroy(TrajectoryWriter_t *writer)
+{
+	trajectory_writer_close(writer);
+
+	for (int i = 0; i < writer->slotCount; i++)
+	{
+		free(writer->slots[i].x);
+		free(writer->slots[i].y);
+		free(writer->slots[i].mass);
+	}
+	free(writer->slots);
+	free(writer->previousX);
+	free(writer->previousY);
+	free(writer->previousMass);
+	free(writer->chunk);
+	pthread_mutex_destroy(&writer->mutex);
+	pthread_cond_destroy(&writer->notEmpty);
+	pthread_cond_destroy(&writer->notFull);
+	free(writer);
+}
+
+TrajectoryReader_t *trajectory_reader_initializer(const char *path)
+{
+	TrajectoryReader_t *reader;
+	unsigned char header[TRAJECTORY_HEADER_SIZE];
+	FILE *file = fopen(path, "rb");
+
+	if (file == NULL)
+	{
+		return NULL;
+	}
+	if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, TRAJECTORY_MAGIC, sizeof(TRAJECTORY_MAGIC)) != 0 ||
+		read_u32(&header[8]) != TRAJECTORY_VERSION)
+	{
+		fclose(file);
+		return NULL;
+	}
+
+	reader = (TrajectoryReader_t *)calloc(1, sizeof(TrajectoryReader_t));
+	reader->file = file;
+	reader->quantum = read_double(&header[16]);
+
+	return reader;
+}
+
+bool trajectory_reader_next(TrajectoryReader_t *reader, unsigned long long *step, size_t *count, double **x, double **y, double **mass)
+{
+	uint64_t frameStep, frameCount, type;
+
+	if (reader->chunkFrames == 0)
+	{
+		unsigned char header[8];
+
+		if (fread(header, 1, sizeof(header), reader->file) != sizeof(header))
+		{
+			return false;
+		}
+		reader->chunkFrames = read_u32(&header[0]);
+		reader->chunkSize = read_u32(&header[4]);
+		reader->position = 0;
+		if (reader->chunkSize > reader->chunkCapacity)
+		{
+			reader->chunkCapacity = reader->chunkSize;
+			reader->chunk = (unsigned char *)realloc(reader->chunk, reader->chunkCapacity);
+		}
+		if (fread(reader->chunk, 1, reader->chunkSize, reader->file) != reader->chunkSize)
+		{
+			return false;
+		}
+	}
+
+	if (!read_varint(reader->chunk, reader->chunkSize, &reader->position, &frameStep) ||
+		!read_varint(reader->chunk, reader->chunkSize, &reader->position, &frameCount) ||
+		!read_varint(reader->chunk, reader->chunkSize, &reader->position, &type) ||
+		(type == TRAJECTORY_FRAME_DELTA && frameCount != reader->previousCount) || frameCount > reader->chunkSize)
+	{
+		return false;
+	}
+
+	if (frameCount > reader->previousCapacity)
+	{
+		reader->previousCapacity = frameCount;
+		reader->previousX = (int64_t *)realloc(reader->previousX, frameCount * sizeof(int64_t));
+		reader->previousY = (int64_t *)realloc(reader->previousY, frameCount * sizeof(int64_t));
+		reader->x = (double *)realloc(reader->x, frameCount * sizeof(double));
+		reader->y = (double *)realloc(reader->y, frameCount * sizeof(double));
+		reader->mass = (double *)realloc(reader->mass, frameCount * sizeof(double));
+	}
+
+	for (size_t i = 0; i < frameCount; i++)
+	{
+		uint64_t encodedX, encodedY;
+
+		if (!read_varint(reader->chunk, reader->chunkSize, &reader->position, &encodedX) ||
+			!read_varint(reader->chunk, reader->chunkSize, &reader->position, &encodedY))
+		{
+			return false;
+		}
+		if (type == TRAJECTORY_FRAME_KEY)
+		{
+			if (reader->position + 8 > reader->chunkSize)
+			{
+				return false;
+			}
+			reader->previousX[i] = unzigzag(encodedX);
+			reader->previousY[i] = unzigzag(encodedY);
+			reader->mass[i] = read_double(&reader->chunk[reader->position]);
+			reader->position += 8;
+		}
+		else
+		{
+			reader->previousX[i] += unzigzag(encodedX);
+			reader->previousY[i] += unzigzag(encodedY);
+		}
+		reader->x[i] = reader->previousX[i] * reader->quantum;
+		reader->y[i] = reader->previousY[i] * reader->quantum;
+	}
+
+	reader->previousCount = frameCount;
+	reader->chunkFrames--;
+	*step = frameStep;
+	*count = frameCount;
+	*x = reader->x;
+	*y = reader->y;
+	*mass = reader->mass;
+
+	return true;
+}
+
+void trajectory_reader_destroy(TrajectoryReader_t *reader)
+{
+	fclose(reader->file);
+	free(reader->chunk);
+	free(reader->previousX);
+	free(reader->previousY);
+	free(reader->x);
+	free(reader->y);
+	free(reader->mass);
+	free(reader);
+}
+
+//Build test : (mingw32-)gcc -o test.exe trajectory.c particle_system.c particle.c thread_pool.c gravity.c timer.c -lpthread -DUNIT_TESTS_TJ
+#ifdef UNIT_TESTS_TJ
+#define TEST_PATH "test_trajectory.bin"
+
+/* Start the overall test suite */
+START_TESTS()
+START_TEST("Frames read back within the quantum")
+ParticleSystem_t *system = particle_system_initializer(0);
+TrajectoryWriter_t *writer = trajectory_writer_initializer(TEST_PATH, TRAJECTORY_DEFAULT_QUANTUM, 4, false);
+TrajectoryReader_t *reader;
+unsigned long long step;
+size_t count, frames = 0;
+double *x, *y, *mass;
+double maxError = 0;
+bool steps = true, counts = true;
+
+srand(5);
+for (size_t i = 0; i < 1000; i++)
+{
+	particle_system_add(system, 0, 0, rand() % 2000 - 1000 + 0.123, rand() % 2000 - 1000, i % 10 + 1);
+}
+//200 frames (more than one key interval), with a particle removed in the middle (key frame)
+for (int frame = 0; frame < 200; frame++)
+{
+	if (frame == 100)
+	{
+		particle_system_remove(system, 3);
+	}
+	for (size_t i = 0; i < system->count; i++)
+	{
+		system->x[i] += 0.37 * (i % 7) - 1;
+		system->y[i] -= 0.011 * frame;
+	}
+	ASSERT(trajectory_writer_push(writer, system, frame));
+}
+ASSERT(trajectory_writer_close(writer));
+ASSERT(writer->framesWritten == 200);
+ASSERT(writer->framesDropped == 0);
+trajectory_writer_destroy(writer);
+
+reader = trajectory_reader_initializer(TEST_PATH);
+ASSERT(reader != NULL);
+while (trajectory_reader_next(reader, &step, &count, &x, &y, &mass))
+{
+	steps = steps && step == frames;
+	counts = counts && count == (frames < 100 ? 1000u : 999u);
+	frames++;
+}
+ASSERT(frames == 200);
+ASSERT(steps);
+ASSERT(counts);
+
+//last frame : same particles as the system, less than half a quantum away
+for (size_t i = 0, j = 0; i < system->count; i++)
+{
+	if (!particle_system_alive(system, i))
+	{
+		continue;
+	}
+	maxError = fmax(maxError, fmax(fabs(x[j] - system->x[i]), fabs(y[j] - system->y[i])));
+	ASSERT(mass[j] == system->mass[i]);
+	j++;
+}
+ASSERT_LESSTHAN(maxError, TRAJECTORY_DEFAULT_QUANTUM / 2 + 1e-9);
+
+trajectory_reader_destroy(reader);
+particle_system_destroy(system);
+remove(TEST_PATH);
+END_TEST()
+
+START_TEST("Key frame when a free slot is reused")
+ParticleSystem_t *system = particle_system_initializer(0);
+TrajectoryWriter_t *writer = trajectory_writer_initializer(TEST_PATH, TRAJECTORY_DEFAULT_QUANTUM, 4, false);
+TrajectoryReader_t *reader;
+unsigned long long step;
+size_t count;
+double *x, *y, *mass;
+
+for (size_t i = 0; i < 10; i++)
+{
+	particle_system_add(system, 0, 0, (double)i, 0, 1);
+}
+ASSERT(trajectory_writer_push(writer, system, 0));
+//same number of particles, the removed one is replaced by a heavier one in its slot
+particle_system_remove(system, 4);
+particle_system_add(system, 0, 0, 40, 0, 7);
+ASSERT(trajectory_writer_push(writer, system, 1));
+trajectory_writer_destroy(writer);
+
+reader = trajectory_reader_initializer(TEST_PATH);
+ASSERT(trajectory_reader_next(reader, &step, &count, &x, &y, &mass));
+ASSERT(count == 10 && mass[4] == 1);
+ASSERT(trajectory_reader_next(reader, &step, &count, &x, &y, &mass));
+ASSERT(count == 10 && mass[4] == 7 && x[4] == 40);
+trajectory_reader_destroy(reader);
+particle_system_destroy(system);
+remove(TEST_PATH);
+END_TEST()
+
+START_TEST("Delta frames are small")
+ParticleSystem_t *system = particle_system_initializer(0);
+TrajectoryWriter_t *writer = trajectory_writer_initializer(TEST_PATH, TRAJECTORY_DEFAULT_QUANTUM, 4, false);
+unsigned long long bytes;
+
+for (size_t i = 0; i < 1000; i++)
+{
+	particle_system_add(system, 0, 0, i * 3.5, -(double)i, 1);
+}
+for (int frame = 0; frame < TRAJECTORY_KEY_INTERVAL; frame++)
+{
+	for (size_t i = 0; i < system->count; i++)
+	{
+		system->x[i] += 0.01;
+	}
+	trajectory_writer_push(writer, system, frame);
+}
+trajectory_writer_destroy(writer);
+
+//1 key frame (about 2 * 4 + 8 bytes per particle) and 63 delta frames moving by about 10 quanta (2 bytes per particle) instead of 16 raw bytes
+bytes = 0;
+{
+	FILE *file = fopen(TEST_PATH, "rb");
+	fseek(file, 0, SEEK_END);
+	bytes = ftell(file);
+	fclose(file);
+}
+ASSERT_LESSTHAN(bytes, 1000 * (20 + (TRAJECTORY_KEY_INTERVAL - 1) * 2.5));
+
+particle_system_destroy(system);
+remove(TEST_PATH);
+END_TEST()
+/* End the overall test suite */
+END_TESTS()
+#endif
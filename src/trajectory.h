@@ -0,0 +1,139 @@
+/*
+Author : Yannis Perrin
+Date : 17.10.2026
+Description : Streaming trajectory files, frames are handed to a background writer thread which quantizes, delta-encodes and packs them
+              in chunks, so that writing never stalls the physics
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "particle_system.h"
+
+#pragma once
+
+/*
+ * File layout (little-endian) :
+ *   header : magic "GLXTRAJ\0", version (4 bytes), reserved (4 bytes), quantum (double)
+ *   chunks : number of frames (4 bytes), size of the payload (4 bytes), payload
+ * Every frame of a payload is : step, particle count, type (key or delta) as varints, then for every particle
+ *   key frame   : x / quantum, y / quantum (zigzag varints), mass (double)
+ *   delta frame : difference with the quantized x and y of the previous frame (zigzag varints, 1 byte for a slow particle)
+ * A key frame is written every TRAJECTORY_KEY_INTERVAL frames and whenever the number of particles or one of their masses changes
+ * (a free slot reused by a new particle), the delta frames keep the masses of the last key frame.
+ */
+#define TRAJECTORY_VERSION 1
+#define TRAJECTORY_KEY_INTERVAL 64
+//number of frames the ring buffer between the simulation and the writer thread can hold
+#define TRAJECTORY_DEFAULT_SLOTS 8
+//payload size over which a chunk is written to the file
+#define TRAJECTORY_CHUNK_SIZE (256 * 1024)
+//default resolution of the positions (the error on a position is at most half of it)
+#define TRAJECTORY_DEFAULT_QUANTUM (1.0 / 1024)
+
+//Frame waiting in the ring buffer
+typedef struct TrajectoryFrame_s {
+	unsigned long long step;
+	size_t count;
+	size_t capacity;
+	double *x;
+	double *y;
+	double *mass;
+} TrajectoryFrame_t;
+
+//Trajectory writer
+typedef struct TrajectoryWriter_s {
+	FILE *file;
+	double quantum;
+	bool dropWhenFull; //false : trajectory_writer_push waits for a free slot
+	//ring buffer (shared, protected by mutex)
+	TrajectoryFrame_t *slots;
+	int slotCount;
+	int head; //next slot to fill
+	int used; //slots filled and not written yet
+	bool stop;
+	bool closed;
+	pthread_mutex_t mutex;
+	pthread_cond_t notEmpty;
+	pthread_cond_t notFull;
+	pthread_t thread;
+	//encoder (writer thread only)
+	int64_t *previousX;
+	int64_t *previousY;
+	double *previousMass;
+	size_t previousCount;
+	size_t previousCapacity;
+	unsigned long long framesSinceKey;
+	unsigned char *chunk;
+	size_t chunkSize;
+	size_t chunkCapacity;
+	uint32_t chunkFrames;
+	bool error; //set by the writer thread, read by trajectory_writer_push (protected by mutex)
+	//statistics
+	unsigned long long framesWritten;
+	unsigned long long framesDropped;
+	unsigned long long bytesWritten;
+} TrajectoryWriter_t;
+
+//Trajectory reader (decodes the frames of a file one by one)
+typedef struct TrajectoryReader_s {
+	FILE *file;
+	double quantum;
+	unsigned char *chunk;
+	size_t chunkSize;
+	size_t chunkCapacity;
+	size_t position;	   //in the chunk
+	uint32_t chunkFrames; //frames left in the chunk
+	int64_t *previousX;
+	int64_t *previousY;
+	size_t previousCount;
+	size_t previousCapacity;
+	double *x; //decoded frame
+	double *y;
+	double *mass;
+} TrajectoryReader_t;
+
+/**
+ * @brief Create a trajectory file and start its writer thread with a ring buffer of slotCount frames.
+ * Positions are rounded to a multiple of quantum. When the ring buffer is full, a frame is dropped (dropWhenFull) or the push waits.
+ * @return TrajectoryWriter_t* NULL if the file could not be created
+ */
+TrajectoryWriter_t *trajectory_writer_initializer(const char *path, double quantum, int slotCount, bool dropWhenFull);
+
+/**
+ * @brief Copy the positions of the particles alive in the system into the ring buffer (in the order of their ids),
+ * the encoding and the writing are done by the writer thread.
+ * @return bool false if the frame was dropped (ring buffer full) or the writer failed
+ */
+bool trajectory_writer_push(TrajectoryWriter_t *writer, ParticleSystem_t *system, unsigned long long step);
+
+/**
+ * @brief Write the frames left in the ring buffer, stop the writer thread and close the file, the statistics are final afterwards.
+ * @return bool false if an error happened while writing the file
+ */
+bool trajectory_writer_close(TrajectoryWriter_t *writer);
+
+/**
+ * @brief Close the writer if it is still open (see trajectory_writer_close) and free the TrajectoryWriter_t.
+ * @return void
+ */
+void trajectory_writer_destroy(TrajectoryWriter_t *writer);
+
+/**
+ * @brief Open a trajectory file to read its frames.
+ * @return TrajectoryReader_t* NULL if the file could not be opened or is not a trajectory
+ */
+TrajectoryReader_t *trajectory_reader_initializer(const char *path);
+
+/**
+ * @brief Decode the next frame : its step, its number of particles and their (quantized) positions and masses,
+ * valid until the next call.
+ * @return bool false at the end of the file (or if it is corrupted)
+ */
+bool trajectory_reader_next(TrajectoryReader_t *reader, unsigned long long *step, size_t *count, double **x, double **y, double **mass);
+
+/**
+ * @brief Close the file and free the TrajectoryReader_t.
+ * @return void
+ */
+void trajectory_reader_destroy(TrajectoryReader_t *reader);